@@ -0,0 +1,487 @@
+#include <tokenizer.h>
+
+#include <log.h>
+#include <klib/kenum.h>
+#include <klib/kflags.h>
+#include <klib/kthreadpool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#define JR_POSIX_BENCH 1
+#endif
+
+#define STR(X) #X
+#define XSTR(X) STR(X)
+#ifndef SAMPLES_ROOT_DIR
+#define SAMPLES_ROOT_DIR samples
+#endif
+
+/*
+*   Tokenizer benchmark suite. Generates synthetic corpora from 1 KB up to 100 MB for a
+*   handful of token mixes and tokenizes each with every lexer mode, reporting MB/s,
+*   tokens/s, heap allocations per token and peak RSS as CSV or JSON so results can be
+*   diffed across commits.
+*
+*   Every measurement runs in a forked child so the peak RSS of one run is not hidden
+*   behind the high water mark of a bigger one.
+*/
+
+// Every heap allocation in the process goes through here, the lexer included
+static std::atomic<size_t> s_Allocations { 0 };
+
+void* operator new(size_t size) {
+    s_Allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace JR::Bench {
+    K_ENUM(
+        BenchFlags,
+        FORMAT,
+        OUTPUT_FILE,
+        MAX_SIZE,
+        REGEX_MAX_SIZE,
+        MIX,
+        JOBS,
+        LABEL
+    )
+
+    K_ENUM(LexerMode, DFA, REGEX, DFA_PARALLEL);
+
+    inline K::Flags::FlagDefinitionList s_BenchFlagDefinitions = {
+        { BenchFlags::FORMAT, { "-f", "--format" }, true, "Output format, csv (default) or json" },
+        { BenchFlags::OUTPUT_FILE, { "-o", "--output" }, true, "Write the results to a file instead of stdout" },
+        { BenchFlags::MAX_SIZE, { "--max-size" }, true, "The largest corpus size in bytes, defaults to 100000000" },
+        { BenchFlags::REGEX_MAX_SIZE, { "--regex-max-size" }, true, "The largest corpus size the regex engine runs on, defaults to 1000000" },
+        { BenchFlags::MIX, { "--mix" }, true, "Only run one corpus mix: sample, comments, identifiers, operators or literals" },
+        { BenchFlags::JOBS, { "-j", "--jobs" }, true, "Worker count for the parallel lexer mode, defaults to the number of hardware threads" },
+        { BenchFlags::LABEL, { "--label" }, true, "A label added to every row, e.g. the commit being measured" },
+    };
+
+    struct Mix {
+        std::string name;
+        std::string seed;
+    };
+
+    // Plain data so a forked child can hand it back through a pipe
+    struct Measurement {
+        bool ok;
+        size_t tokens;
+        double seconds;         // Best of the repetitions
+        size_t allocations;     // Heap allocations made by a single run
+        size_t peakRss;         // Bytes, 0 when unknown
+    };
+
+    std::string readFile(std::string filepath) {
+        std::ifstream file(filepath, std::ios::binary);
+        std::stringstream ss;
+        ss << file.rdbuf();
+        return ss.str();
+    }
+
+    std::vector<std::string> readLines(std::string filepath) {
+        std::vector<std::string> lines;
+        std::ifstream file(filepath);
+        std::string line;
+        while (std::getline(file, line)) {
+            lines.push_back(line);
+        }
+        return lines;
+    }
+
+    // Words from an artifact file, skipping the `//` description lines
+    std::vector<std::string> readWords(std::string filepath) {
+        std::vector<std::string> words;
+        for (std::string& line : readLines(filepath)) {
+            if (line.rfind("//", 0) == 0) {
+                continue;
+            }
+            std::stringstream ss(line);
+            std::string word;
+            while (ss >> word) {
+                words.push_back(word);
+            }
+        }
+        return words;
+    }
+
+    // Comment heavy: of every 16 sample lines 4 land in a block comment, 8 become line comments and 4 stay code
+    std::string commentSeed(const std::string& sample) {
+        std::stringstream in(sample), out;
+        std::string line;
+        for (size_t i = 0; std::getline(in, line); i++) {
+            if (i % 16 == 0) {
+                out << "/*\n";
+            }
+            out << (i % 16 < 4 ? "    " : i % 16 < 12 ? "// " : "") << line << "\n";
+            if (i % 16 == 3) {
+                out << "*/\n";
+            }
+        }
+        return out.str();
+    }
+
+    std::string identifierSeed(const std::string& artifactsDir) {
+        std::vector<std::string> words = readWords(artifactsDir + "/identifiers.jr");
+        for (std::string& word : readWords(artifactsDir + "/keywords.jr")) {
+            words.push_back(word);
+        }
+        for (std::string& word : readWords(artifactsDir + "/types.jr")) {
+            words.push_back(word);
+        }
+
+        std::mt19937 rng(42);
+        std::stringstream out;
+        for (size_t line = 0; line < 512; line++) {
+            for (size_t i = 0; i < 8; i++) {
+                out << (i ? " " : "") << words[rng() % words.size()];
+            }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+    std::string operatorSeed(const std::string& artifactsDir) {
+        std::vector<std::string> operators = readWords(artifactsDir + "/operators.jr");
+
+        std::mt19937 rng(42);
+        std::stringstream out;
+        for (size_t line = 0; line < 512; line++) {
+            out << "a";
+            for (size_t i = 0; i < 8; i++) {
+                out << " " << operators[rng() % operators.size()] << " b";
+            }
+            out << "(c[d]);\n";
+        }
+        return out.str();
+    }
+
+    std::string literalSeed() {
+        std::mt19937 rng(42);
+        std::stringstream out;
+        for (size_t line = 0; line < 512; line++) {
+            for (size_t i = 0; i < 8; i++) {
+                out << (i ? ", " : "");
+                switch (rng() % 7) {
+                    case 0: out << rng() % 1000000; break;
+                    case 1: out << "0x" << std::hex << rng() % 0xFFFFFF << std::dec; break;
+                    case 2: out << "0b" << ((rng() & 1) ? "1011" : "110"); break;
+                    case 3: out << rng() % 1000 << "." << rng() % 1000; break;
+                    case 4: out << "\"literal " << rng() % 100 << "\""; break;
+                    case 5: out << "'" << static_cast<char>('a' + rng() % 26) << "'"; break;
+                    default: out << ((rng() & 1) ? "true" : "false"); break;
+                }
+            }
+            out << "\n";
+        }
+        return out.str();
+    }
+
+    // Repeat the seed source until the corpus reaches `size` bytes, cutting at a line boundary
+    int writeCorpus(const std::string& seed, size_t size, std::string output) {
+        std::ofstream file(output, std::ios::binary);
+        if (!file.is_open()) {
+            LOG_ERROR("Could not open corpus file " + output);
+            return 1;
+        }
+
+        size_t written = 0;
+        while (written < size) {
+            size_t chunk = std::min(seed.size(), size - written);
+            size_t lineEnd = seed.rfind('\n', chunk - 1);
+            chunk = (chunk < seed.size() && lineEnd != std::string::npos) ? lineEnd + 1 : chunk;
+            file.write(seed.data(), chunk);
+            written += chunk;
+            if (chunk < seed.size()) {
+                break;
+            }
+            file.put('\n');
+            written++;
+        }
+
+        return 0;
+    }
+
+    size_t peakRss() {
+#ifdef JR_POSIX_BENCH
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+        return usage.ru_maxrss;
+#else
+        return usage.ru_maxrss * 1024;
+#endif
+#else
+        return 0;
+#endif
+    }
+
+    // Tokenizes the corpus once, returns the token count
+    size_t tokenize(std::string corpus, LexerMode::Enum mode, K::ThreadPool& pool) {
+        Tokenizer::Lexer lexer;
+        if (mode == LexerMode::DFA_PARALLEL) {
+            lexer.InitParallel(corpus, pool);
+            return lexer.GetTokenStream().Size();
+        }
+
+        lexer.Init(corpus, mode == LexerMode::REGEX ? Tokenizer::LexerEngine::REGEX : Tokenizer::LexerEngine::DFA);
+        size_t tokens = 0;
+        while (lexer.PeekToken()) {
+            lexer.NextToken();
+            tokens++;
+        }
+        return tokens;
+    }
+
+    // Small corpora are repeated until the timings are long enough to be stable
+    Measurement measure(std::string corpus, LexerMode::Enum mode, size_t jobs) {
+        Measurement result = {};
+        try {
+            K::ThreadPool pool(jobs);
+
+            size_t allocationsBefore = s_Allocations.load();
+            auto start = std::chrono::steady_clock::now();
+            result.tokens = tokenize(corpus, mode, pool);
+            double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            result.allocations = s_Allocations.load() - allocationsBefore;
+            result.seconds = total;
+
+            for (size_t run = 1; run < 1000 && total < 0.25; run++) {
+                start = std::chrono::steady_clock::now();
+                tokenize(corpus, mode, pool);
+                double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                result.seconds = std::min(result.seconds, seconds);
+                total += seconds;
+            }
+            result.ok = true;
+        } catch (Tokenizer::TokenizerException& e) {
+            LOG_ERROR(e.what());
+        } catch (std::exception& e) {
+            LOG_ERROR(e.what());
+        }
+        result.peakRss = peakRss();
+        return result;
+    }
+
+    Measurement measureIsolated(std::string corpus, LexerMode::Enum mode, size_t jobs) {
+#ifdef JR_POSIX_BENCH
+        int fds[2];
+        if (pipe(fds) == 0) {
+            std::fflush(nullptr);
+            pid_t pid = fork();
+            if (pid == 0) {
+                close(fds[0]);
+                Measurement result = measure(corpus, mode, jobs);
+                ssize_t written = write(fds[1], &result, sizeof(result));
+                // _exit skips the atexit flush of the log
+                K::Log::Flush();
+                _exit(written == sizeof(result) ? 0 : 1);
+            }
+
+            close(fds[1]);
+            Measurement result = {};
+            if (pid > 0) {
+                if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+                    result.ok = false;
+                }
+                waitpid(pid, nullptr, 0);
+            }
+            close(fds[0]);
+            if (pid > 0) {
+                return result;
+            }
+        }
+        LOG_WARN("Could not fork, measuring in process");
+#endif
+        return measure(corpus, mode, jobs);
+    }
+
+    std::string modeName(LexerMode::Enum mode) {
+        switch (mode) {
+            case LexerMode::REGEX: return "regex";
+            case LexerMode::DFA_PARALLEL: return "dfa-parallel";
+            default: return "dfa";
+        }
+    }
+
+    std::string jsonString(const std::string& value) {
+        std::string out = "\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+            }
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    std::string csvString(const std::string& value) {
+        std::string out = "\"";
+        for (char c : value) {
+            if (c == '"') {
+                out += '"';
+            }
+            out += c;
+        }
+        return out + "\"";
+    }
+}
+
+using namespace JR::Bench;
+
+int main(int argc, char* argv[]) {
+    if (!K::Flags::init(argc, argv, "<flags>", s_BenchFlagDefinitions)) {
+        return 1;
+    }
+
+    size_t maxSize = 100 * 1000 * 1000;
+    size_t maxRegexSize = 1000 * 1000;
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    try {
+        if (K::Flags::FlagData flag = K::Flags::getFlag(BenchFlags::MAX_SIZE); flag.present) {
+            maxSize = std::stoul(flag.value);
+        }
+        if (K::Flags::FlagData flag = K::Flags::getFlag(BenchFlags::REGEX_MAX_SIZE); flag.present) {
+            maxRegexSize = std::stoul(flag.value);
+        }
+        if (K::Flags::FlagData flag = K::Flags::getFlag(BenchFlags::JOBS); flag.present) {
+            jobs = std::max<size_t>(1, std::stoul(flag.value));
+        }
+    } catch (std::exception& e) {
+        LOG_ERROR("Invalid numeric flag value");
+        return 1;
+    }
+
+    std::string format = K::Flags::getFlag(BenchFlags::FORMAT).present ? K::Flags::getFlag(BenchFlags::FORMAT).value : "csv";
+    if (format != "csv" && format != "json") {
+        LOG_ERROR("Unknown output format: " + format);
+        return 1;
+    }
+    std::string label = K::Flags::getFlag(BenchFlags::LABEL).value;
+
+    std::string samplesDir = XSTR(SAMPLES_ROOT_DIR);
+    std::string artifactsDir = samplesDir + "/../tests/artifacts";
+    std::string sample = readFile(samplesDir + "/full_sample.jr");
+    if (sample.empty()) {
+        LOG_ERROR("Could not read the seed sample");
+        return 1;
+    }
+
+    std::vector<Mix> mixes = {
+        { "sample", sample },
+        { "comments", commentSeed(sample) },
+        { "identifiers", identifierSeed(artifactsDir) },
+        { "operators", operatorSeed(artifactsDir) },
+        { "literals", literalSeed() },
+    };
+    if (K::Flags::FlagData flag = K::Flags::getFlag(BenchFlags::MIX); flag.present) {
+        mixes.erase(std::remove_if(mixes.begin(), mixes.end(), [&](const Mix& mix) { return mix.name != flag.value; }), mixes.end());
+        if (mixes.empty()) {
+            LOG_ERROR("Unknown corpus mix: " + flag.value);
+            return 1;
+        }
+    }
+
+    std::ofstream outputFile;
+    if (K::Flags::FlagData flag = K::Flags::getFlag(BenchFlags::OUTPUT_FILE); flag.present) {
+        outputFile.open(flag.value);
+        if (!outputFile.is_open()) {
+            LOG_ERROR("Could not open output file: " + flag.value);
+            return 1;
+        }
+    }
+    std::ostream& out = outputFile.is_open() ? outputFile : std::cout;
+
+    if (format == "csv") {
+        out << "label,mix,mode,bytes,tokens,seconds,mb_per_s,tokens_per_s,allocs_per_token,peak_rss_bytes" << std::endl;
+    } else {
+        out << "[";
+    }
+
+    std::string corpus = "justrightc-bench-corpus.jr";
+    bool failed = false;
+    bool firstRow = true;
+    for (Mix& mix : mixes) {
+        for (size_t size = 1000; size <= maxSize; size *= 10) {
+            if (writeCorpus(mix.seed, size, corpus)) {
+                return 1;
+            }
+
+            for (LexerMode::Enum mode : LexerMode::Values) {
+                if (mode == LexerMode::REGEX && size > maxRegexSize) {
+                    continue;
+                }
+
+                Measurement result = measureIsolated(corpus, mode, jobs);
+                if (!result.ok) {
+                    LOG_ERROR("Benchmark failed for " + mix.name + "/" + modeName(mode) + " at " + std::to_string(size) + " bytes");
+                    failed = true;
+                    continue;
+                }
+
+                double seconds = std::max(result.seconds, 1e-9);
+                double mbPerSecond = size / seconds / 1e6;
+                double tokensPerSecond = result.tokens / seconds;
+                double allocsPerToken = static_cast<double>(result.allocations) / std::max<size_t>(result.tokens, 1);
+
+                char numbers[256];
+                if (format == "csv") {
+                    std::snprintf(numbers, sizeof(numbers), "%zu,%zu,%.6f,%.2f,%.0f,%.4f,%zu",
+                        size, result.tokens, seconds, mbPerSecond, tokensPerSecond, allocsPerToken, result.peakRss);
+                    out << csvString(label) << "," << mix.name << "," << modeName(mode) << "," << numbers << std::endl;
+                } else {
+                    std::snprintf(numbers, sizeof(numbers),
+                        "\"bytes\": %zu, \"tokens\": %zu, \"seconds\": %.6f, \"mb_per_s\": %.2f, \"tokens_per_s\": %.0f, \"allocs_per_token\": %.4f, \"peak_rss_bytes\": %zu",
+                        size, result.tokens, seconds, mbPerSecond, tokensPerSecond, allocsPerToken, result.peakRss);
+                    out << (firstRow ? "\n" : ",\n") << "  { \"label\": " << jsonString(label) << ", \"mix\": " << jsonString(mix.name)
+                        << ", \"mode\": " << jsonString(modeName(mode)) << ", " << numbers << " }" << std::flush;
+                }
+                firstRow = false;
+            }
+        }
+    }
+
+    if (format == "json") {
+        out << "\n]" << std::endl;
+    }
+
+    remove(corpus.c_str());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,246 @@
+#ifndef __AST_H__
+#define __AST_H__
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "klib/kenum.h"
+#include "klib/karena.h"
+#include "tokenizer.h"
+
+namespace K {
+    class Writer;
+}
+
+namespace JR::Parser {
+    /**
+     * @brief The kind of a syntax tree node. The comment after each group lists the
+     *      children of its kinds in order, absent optional children are EMPTY nodes.
+     */
+    K_ENUM(
+        NodeKind,
+        EMPTY,
+        // Declarations
+        MODULE,         // items
+        USE,            // PATH, alias NAME, EXPOSING
+        PATH,           // NAME per segment
+        EXPOSING,       // NAME per exposed member
+        CLASS,          // PARAMETERS, base type, members
+        PARAMETERS,     // PARAMETER...
+        PARAMETER,      // type
+        FIELD,          // type, value
+        INIT,           // BLOCK
+        CONSTRUCTOR,    // PARAMETERS, BLOCK
+        FUNCTION,       // PARAMETERS, return type, BLOCK
+        // Types
+        TYPE_NAME,      // generic arguments
+        POINTER_TYPE,   // pointee type
+        // Statements
+        BLOCK,          // statements
+        LET,            // type, value or the ARGUMENTS of `let x: T(args)`
+        VARIABLE,       // type, value, for C style `T name = value` declarations
+        IF,             // condition, BLOCK, else BLOCK or IF
+        WHILE,          // condition, BLOCK
+        FOR,            // type, iterable, BLOCK
+        RETURN,         // value
+        // Expressions
+        NAME,
+        LITERAL,
+        UNARY,          // operand
+        POSTFIX,        // operand
+        BINARY,         // left, right
+        IS,             // value, type
+        CAST,           // type, value
+        CALL,           // callee, ARGUMENTS
+        ARGUMENTS,      // arguments
+        MEMBER,         // object, for `object.token`
+        SCOPE,          // owner, for `owner::token`
+        INDEX,          // object, index
+        NEW,            // type, ARGUMENTS
+        SIZEOF,         // type or value
+        CLOSURE,        // PARAMETERS, BLOCK
+    );
+
+    /**
+     * @brief The name of a node kind, e.g. "CALL". NodeKind::Strings leaves out NONE,
+     *      so it is indexed by the value minus one.
+     */
+    inline std::string_view NodeKindName(u32 kind) {
+        if (kind == NodeKind::NONE || kind > NodeKind::Strings.size()) {
+            return "NONE";
+        }
+        return NodeKind::Strings[kind - 1];
+    }
+
+    namespace NodeFlags {
+        enum Enum: u8 {
+            NONE                = 0,
+            PRIVATE             = 1 << 0,
+            PROTECTED           = 1 << 1,
+            PUBLIC              = 1 << 2,
+            OPEN                = 1 << 3,
+            STATIC              = 1 << 4,
+            WILDCARD            = 1 << 5,   // An exposed NAME written with a trailing `*`
+            TRAILING_CLOSURE    = 1 << 6,   // A CALL whose last argument is a closure written after the call
+        };
+    }
+
+    // The index of a missing node, e.g. the sibling after the last child
+    inline constexpr u32 c_NoNode = 0xFFFFFFFF;
+
+    /**
+     * @brief A syntax tree node. Nodes refer to each other by index into their Ast,
+     *      the children of a node are a list linked through `next` from `child`. Names,
+     *      operators and literal values are read from the token the node is built around.
+     */
+    struct Node {
+        u8 kind;            // NodeKind::Enum
+        u8 flags;           // NodeFlags::Enum
+        u16 reserved;
+        u32 token;          // Index in the file's TokenStream, e.g. the name of a declaration or the operator of an expression
+        u32 child;          // First child, or c_NoNode
+        u32 next;           // Next sibling, or c_NoNode
+    };
+    static_assert(sizeof(Node) == 16, "Node should stay a compact POD");
+
+    /**
+     * @brief The syntax tree of one file. Nodes are stored in fixed size arena blocks
+     *      like the tokens of a TokenStream, and children are always added before their
+     *      parent, so the root is the last node.
+     */
+    class Ast {
+    public:
+        Ast() = default;
+        Ast(const Ast&) = delete;
+        Ast& operator=(const Ast&) = delete;
+        Ast(Ast&&) = default;
+        Ast& operator=(Ast&&) = default;
+
+        /**
+         * @brief Point the tree at the tokens its nodes index into
+         *
+         */
+        void SetTokens(const Tokenizer::TokenStream* tokens) { m_Tokens = tokens; }
+        const Tokenizer::TokenStream& GetTokens() const { return *m_Tokens; }
+
+        /**
+         * @brief Append a node, returning its index
+         *
+         */
+        u32 Push(const Node& node);
+
+        const Node& operator[](u32 index) const {
+            return m_Blocks[index >> c_BlockShift][index & (c_BlockSize - 1)];
+        }
+
+        u32 Size() const { return m_Size; }
+        bool Empty() const { return m_Size == 0; }
+
+        u32 Root() const { return m_Root; }
+        void SetRoot(u32 root) { m_Root = root; }
+
+        /**
+         * @brief Drop every node from `size` on, for parses that turned out to be something else
+         *
+         */
+        void Truncate(u32 size) { m_Size = size; }
+
+        /**
+         * @brief The text of the node's token, see TokenStream::Content
+         *
+         */
+        std::string_view Text(u32 index) const { return m_Tokens->Content((*this)[index].token); }
+        SourcePosition Position(u32 index) const { return m_Tokens->Position((*this)[index].token); }
+
+        /**
+         * @brief The `n`th child of a node, or c_NoNode
+         *
+         */
+        u32 Child(u32 index, u32 n) const;
+        u32 ChildCount(u32 index) const;
+
+        class ChildIterator;
+        class Children;
+
+        /**
+         * @brief The children of a node, for `for (u32 child : ast.ChildrenOf(node))`
+         *
+         */
+        Children ChildrenOf(u32 index) const;
+
+        /**
+         * @brief A node and its children on one line, e.g. `(CALL "(" (NAME "f") (ARGUMENTS "("))`
+         *
+         */
+        std::string ToString(u32 index) const;
+
+        /**
+         * @brief Write the whole tree, one node per line indented by depth,
+         *      with the token text, modifiers and position of each node
+         */
+        void Dump(K::Writer& out) const;
+
+        /**
+         * @brief Free every node at once
+         *
+         */
+        void Clear();
+
+        /**
+         * @brief The number of bytes reserved for nodes
+         *
+         */
+        size_t MemoryUsage() const { return m_Arena.BytesReserved(); }
+
+    private:
+        friend class Parser;
+
+        Node& _At(u32 index) { return m_Blocks[index >> c_BlockShift][index & (c_BlockSize - 1)]; }
+
+        // Make room for `size` nodes, leaving the new ones uninitialized
+        void _Resize(u32 size);
+
+        void _ToString(u32 index, std::string& out) const;
+        void _Dump(K::Writer& out, u32 index, u32 depth) const;
+
+        static constexpr u32 c_BlockShift = 12;
+        static constexpr u32 c_BlockSize = 1 << c_BlockShift;
+
+        K::Arena m_Arena = K::Arena(c_BlockSize * sizeof(Node));
+        std::vector<Node*> m_Blocks;
+        u32 m_Size = 0;
+        u32 m_Root = c_NoNode;
+
+        const Tokenizer::TokenStream* m_Tokens = nullptr;
+    };
+
+    class Ast::ChildIterator {
+    public:
+        ChildIterator(const Ast* ast, u32 index) : m_Ast(ast), m_Index(index) {}
+
+        u32 operator*() const { return m_Index; }
+        ChildIterator& operator++() { m_Index = (*m_Ast)[m_Index].next; return *this; }
+        bool operator!=(const ChildIterator& other) const { return m_Index != other.m_Index; }
+
+    private:
+        const Ast* m_Ast;
+        u32 m_Index;
+    };
+
+    class Ast::Children {
+    public:
+        Children(const Ast* ast, u32 first) : m_Ast(ast), m_First(first) {}
+
+        ChildIterator begin() const { return ChildIterator(m_Ast, m_First); }
+        ChildIterator end() const { return ChildIterator(m_Ast, c_NoNode); }
+
+    private:
+        const Ast* m_Ast;
+        u32 m_First;
+    };
+
+    inline Ast::Children Ast::ChildrenOf(u32 index) const { return Children(this, (*this)[index].child); }
+}
+
+#endif // __AST_H__
@@ -0,0 +1,107 @@
+#ifndef __DAEMON_H__
+#define __DAEMON_H__
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "klib/kthreadpool.h"
+#include "modules.h"
+#include "tokenizer.h"
+
+namespace JR::Tokenizer {
+    class TokenCache;
+}
+
+namespace JR::Daemon {
+    class Server;
+
+    /**
+     * @brief Runs one forwarded command line against the server's warm state, returning its exit code
+     *
+     */
+    typedef std::function<int(int argc, char* argv[], Server& server)> RequestHandler;
+
+    /**
+     * @brief A resident compiler. Clients forward their command line, working directory, stdout
+     *      and stderr over a Unix socket, and the request runs in the server against the modules
+     *      loaded by earlier requests. Changes to loaded files are picked up with inotify, so only
+     *      the changed files are lexed and parsed again. Requests run one at a time, each one on
+     *      every worker of the pool.
+     */
+    class Server {
+    public:
+        /**
+         * @param socketPath - The path of the socket to listen on
+         * @param jobs       - The number of workers, used by every request
+         */
+        Server(std::string socketPath, size_t jobs);
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        /**
+         * @brief Handle requests until Stop() is called or the process gets SIGINT or SIGTERM
+         *
+         * @throws std::runtime_error if the socket cannot be listened on, e.g. because another server is
+         */
+        void Serve(RequestHandler handler);
+
+        /**
+         * @brief Make Serve() return after the current request. May be called from any thread.
+         *
+         */
+        void Stop();
+
+        K::ThreadPool& GetPool() { return m_Pool; }
+
+        /**
+         * @brief The loader kept for a configuration in the current working directory, with no
+         *      inputs added yet. Modules it loaded for earlier requests are reused unless they changed.
+         */
+        Modules::ModuleLoader& GetLoader(const std::vector<std::string>& searchRoots, Tokenizer::LexerEngine::Enum engine, Tokenizer::TokenCache* cache);
+
+        /**
+         * @brief The token cache kept for a directory, created with `maxBytes` by the first request using it
+         *
+         * @throws std::exception if the directory cannot be used
+         */
+        Tokenizer::TokenCache& GetTokenCache(const std::string& directory, u64 maxBytes);
+
+    private:
+        void _Listen();
+        void _Handle(int connection, const RequestHandler& handler);
+        void _Watch(const std::string& directory);
+        void _ReadEvents();
+
+        std::string m_SocketPath;
+        K::ThreadPool m_Pool;
+
+        int m_Socket = -1;
+        int m_Inotify = -1;
+        int m_StopPipe[2] = { -1, -1 };
+
+        std::unordered_map<std::string, std::unique_ptr<Modules::ModuleLoader>> m_Loaders;     // Keyed by directory and flags
+        std::unordered_map<std::string, std::unique_ptr<Tokenizer::TokenCache>> m_TokenCaches;
+        std::mutex m_WatchMutex;    // Loaders add watches from the pool's workers
+        std::unordered_map<int, std::string> m_Watches;     // Watched directory by watch descriptor
+        std::unordered_set<std::string> m_Watched;
+    };
+
+    /**
+     * @brief Run a command line in the server listening on `socketPath`, with this process's working
+     *      directory, stdout and stderr, and wait for it to finish
+     *
+     * @param args - The command line, starting with the program name
+     * @return int - The exit code of the request
+     * @throws std::runtime_error if no server is listening on the socket
+     */
+    int Forward(const std::string& socketPath, const std::vector<std::string>& args);
+}
+
+#endif // __DAEMON_H__
@@ -9,8 +9,17 @@ namespace JR {
         Flags,
         VERSION,
         OUTPUT_FILE,
+        MODULE_PATH,
+        JOBS,
         TOKENIZER_CSV_OUTPUT_FILE,
-        TOKENIZER_OUTPUT_TO_CONSOLE
+        TOKENIZER_BIN_OUTPUT_FILE,
+        TOKENIZER_OUTPUT_TO_CONSOLE,
+        TOKENIZER_REGEX_ENGINE,
+        TOKEN_CACHE_DIR,
+        TOKEN_CACHE_SIZE,
+        LOG_LEVEL,
+        DAEMON,
+        CONNECT
     )
 
     inline K::Flags::FlagDefinitionList s_FlagDefinitions = {
@@ -24,7 +33,19 @@ namespace JR {
             Flags::OUTPUT_FILE,
             { "-o", "--output" },
             true,
-            "The output file to write to"
+            "The output file to write to, for now the syntax tree of every input"
+        },
+        { 
+            Flags::MODULE_PATH,
+            { "-I", "--module-path" },
+            true,
+            "The directories to look up `use`d modules in, separated by ':' (';' on Windows). Imports are only loaded when set"
+        },
+        { 
+            Flags::JOBS,
+            { "-j", "--jobs" },
+            true,
+            "The number of input files to process in parallel, defaults to the number of hardware threads"
         },
         { 
             Flags::TOKENIZER_CSV_OUTPUT_FILE,
@@ -32,12 +53,54 @@ namespace JR {
             true,
             "The output file to write the tokenizer CSV to"
         },
+        { 
+            Flags::TOKENIZER_BIN_OUTPUT_FILE,
+            { "--tokenizer-bin-output" },
+            true,
+            "The output file to write the tokens to in the compact binary dump format"
+        },
         { 
             Flags::TOKENIZER_OUTPUT_TO_CONSOLE,
             { "--tdebug" },
             false,
             "Output the tokenizer debug to the console"
         },
+        { 
+            Flags::TOKENIZER_REGEX_ENGINE,
+            { "--tokenizer-regex" },
+            false,
+            "Tokenize with the legacy regex engine instead of the DFA lexer"
+        },
+        { 
+            Flags::TOKEN_CACHE_DIR,
+            { "--token-cache" },
+            true,
+            "A directory to cache lexed tokens in, unchanged inputs are loaded from it instead of being lexed"
+        },
+        { 
+            Flags::TOKEN_CACHE_SIZE,
+            { "--token-cache-size" },
+            true,
+            "The size in MiB the token cache is trimmed to by deleting the least recently used entries, defaults to 256"
+        },
+        { 
+            Flags::LOG_LEVEL,
+            { "--log-level" },
+            true,
+            "The most verbose messages to print: none, error, warn, info, debug or trace, defaults to info"
+        },
+        { 
+            Flags::DAEMON,
+            { "--daemon" },
+            true,
+            "Stay resident and run the command lines sent to this socket, only relexing and reparsing files that changed"
+        },
+        { 
+            Flags::CONNECT,
+            { "--connect" },
+            true,
+            "Run the rest of the command line in the daemon listening on this socket"
+        },
     };
 }
 #endif // __OPTIONS_H__
\ No newline at end of file
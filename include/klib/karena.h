@@ -0,0 +1,78 @@
+#ifndef __K_ARENA_H__
+#define __K_ARENA_H__
+
+#include "ktypes.h"
+
+#include <cstddef>
+
+/**
+    The KLib Arena. A growable bump allocator that hands out memory from a list of chunks.
+    Allocations are never freed individually, everything is released at once by Reset() or 
+    when the arena is destroyed. Memory handed out never moves, so pointers into the arena 
+    stay valid until then.
+ */
+namespace K {
+    class Arena {
+    public:
+        /**
+         * @param initialChunkSize - The size of the first chunk, later chunks double in size
+         * @param maxChunkSize     - The size chunks stop doubling at, bounding the unused tail
+         */
+        Arena(size_t initialChunkSize = 64 * 1024, size_t maxChunkSize = 16 * 1024 * 1024);
+        ~Arena();
+
+        Arena(const Arena&) = delete;
+        Arena& operator=(const Arena&) = delete;
+        Arena(Arena&& other) noexcept;
+        Arena& operator=(Arena&& other) noexcept;
+
+        /**
+         * @brief Allocate uninitialized memory from the arena
+         * 
+         * @param size      - The number of bytes to allocate
+         * @param alignment - The alignment of the allocation, must be a power of two
+         * @return void*    - The allocated memory, valid until Reset() or destruction
+         */
+        void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        /**
+         * @brief Allocate uninitialized storage for `count` objects of type T
+         * 
+         */
+        template<typename T>
+        T* AllocateArray(size_t count) {
+            return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+        }
+
+        /**
+         * @brief Release every chunk at once, invalidating all allocations
+         * 
+         */
+        void Reset();
+
+        /**
+         * @brief The number of bytes reserved from the system across all chunks
+         * 
+         */
+        size_t BytesReserved() const { return m_BytesReserved; }
+
+    private:
+        struct Chunk {
+            Chunk* next;
+            size_t size;
+        };
+
+        void Grow(size_t minimumSize);
+
+        size_t m_InitialChunkSize;
+        size_t m_MaxChunkSize;
+        size_t m_NextChunkSize;
+        size_t m_BytesReserved = 0;
+
+        Chunk* m_Head = nullptr;
+        char* m_Cursor = nullptr;
+        char* m_End = nullptr;
+    };
+}
+
+#endif // __K_ARENA_H__
@@ -48,6 +48,13 @@ namespace K::Flags {
         FlagDefinitionList flags
     );
 
+    /**
+     * @brief Forget the flags and arguments of the last init, so a long running process 
+     *          can init again with another command line
+     * 
+     */
+    void reset();
+
     /**
      * @brief Prints the help message with usage information
      * 
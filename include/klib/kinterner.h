@@ -0,0 +1,76 @@
+#ifndef __K_INTERNER_H__
+#define __K_INTERNER_H__
+
+#include "ktypes.h"
+#include "karena.h"
+
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+/**
+    The KLib Interner. Maps strings to small integer symbols, equal strings always get the
+    same symbol so they can be compared with an integer compare. The table is split into
+    shards picked by the string's hash, each with its own lock, so threads interning
+    different strings rarely wait on each other. Interned text never moves and lives as
+    long as the interner.
+ */
+namespace K {
+    class Interner {
+    public:
+        static constexpr u32 c_NoSymbol = 0;   // Never returned by Intern()
+
+        Interner() = default;
+        Interner(const Interner&) = delete;
+        Interner& operator=(const Interner&) = delete;
+
+        /**
+         * @brief Get the symbol for the text, adding it to the table if it is new
+         *
+         * @param text - The text to intern, copied into the interner
+         * @return u32 - The symbol, never c_NoSymbol
+         */
+        u32 Intern(std::string_view text);
+
+        /**
+         * @brief Intern with a hash already computed by Hash(), for callers that cache symbols by hash
+         *
+         */
+        u32 Intern(std::string_view text, u64 hash);
+
+        static u64 Hash(std::string_view text);
+
+        /**
+         * @brief Get the text of a symbol returned by Intern()
+         *
+         */
+        std::string_view Lookup(u32 symbol) const;
+
+        /**
+         * @brief The number of distinct strings interned
+         *
+         */
+        size_t Size() const;
+
+    private:
+        static constexpr u32 c_ShardBits = 6;
+        static constexpr u32 c_ShardCount = 1 << c_ShardBits;
+
+        struct Slot {
+            u32 hash;
+            u32 index;      // 1 based index into Shard::strings, 0 marks an empty slot
+        };
+
+        // Each shard sits on its own cache line so their locks don't false share
+        struct alignas(64) Shard {
+            mutable std::mutex mutex;
+            std::vector<Slot> slots;            // Open addressing, kept at most half full
+            std::vector<std::string_view> strings;
+            Arena arena = Arena(4 * 1024);
+        };
+
+        Shard m_Shards[c_ShardCount];
+    };
+}
+
+#endif // __K_INTERNER_H__
@@ -1,11 +1,20 @@
 #ifndef __K_LOG_H__
 #define __K_LOG_H__
 
-#include <iostream>
+#include <atomic>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <utility>
 
+/**
+    The KLib Log. Levels above a file's DEBUG_LEVEL compile to nothing, enabled levels are
+    also filtered at runtime by K::Log::SetLevel() before their arguments are evaluated. The
+    messages that pass go into a lock-free ring buffer and a background thread formats and
+    prints them, so logging never waits on the console. Call K::Log::Flush() before writing
+    to stdout directly, pending messages are flushed automatically at exit.
+ */
+
 // Define debug levels
 #define DEBUG_LEVEL_NONE    0
 #define DEBUG_LEVEL_ERROR   1
@@ -14,42 +23,41 @@
 #define DEBUG_LEVEL_DEBUG   4
 #define DEBUG_LEVEL_TRACE   5
 
-// Set the current debug level
+// The most verbose level compiled into the current file
 #ifndef DEBUG_LEVEL
 #define DEBUG_LEVEL DEBUG_LEVEL_DEBUG
 #endif
 
-// Helper macro to support variable arguments
-#define LOG_FORMAT(level, ...) \
-    do { \
-        if (level <= DEBUG_LEVEL) { \
-            std::ostringstream os; \
-            if (level == DEBUG_LEVEL_ERROR) { \
-                os << "\033[1;31m"; \
-                os << " [ERROR]"; \
-            } else if (level == DEBUG_LEVEL_WARN) { \
-                os << "\033[1;33m"; \
-                os << " [WARN]"; \
-            } else if (level == DEBUG_LEVEL_INFO) { \
-                os << "\033[1;32m"; \
-                os << " [INFO]"; \
-            } else if (level == DEBUG_LEVEL_DEBUG) { \
-                os << "\033[1;34m"; \
-                os << " [DEBUG]"; \
-                os << __FILE__ << ":" << __LINE__; \
-            } else if (level == DEBUG_LEVEL_TRACE) { \
-                os << "\033[1;37m"; \
-                os << __FILE__ << ":" << __LINE__; \
-                os << " [TRACE]"; \
-            } \
-            os << " " << format_log(__VA_ARGS__) << std::endl; \
-            os << "\033[0m"; \
-            std::cout << os.str(); \
-        } \
-    } while(0)
+namespace K::Log {
+    inline std::atomic<int> s_Level = DEBUG_LEVEL_INFO;
 
-// Fallback when no arguments are provided
-#define LOG(level, ...) LOG_FORMAT(level, ##__VA_ARGS__)
+    /**
+     * @brief Set the most verbose level printed at runtime, a DEBUG_LEVEL_* value
+     *
+     */
+    inline void SetLevel(int level) { s_Level.store(level, std::memory_order_relaxed); }
+    inline int GetLevel() { return s_Level.load(std::memory_order_relaxed); }
+    inline bool IsEnabled(int level) { return level <= s_Level.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Parse a level name, one of none, error, warn, info, debug and trace
+     *
+     * @return false - The name is not a level, `level` is unchanged
+     */
+    bool ParseLevel(std::string_view name, int& level);
+
+    /**
+     * @brief Queue a message for the background thread, waiting only if the ring buffer is full
+     *
+     */
+    void Push(int level, const char* file, int line, std::string message);
+
+    /**
+     * @brief Wait until every message queued so far has been printed
+     *
+     */
+    void Flush();
+}
 
 // Function to format variable arguments
 template<typename... Args>
@@ -59,11 +67,54 @@ std::string format_log(Args&&... args) {
     return oss.str();
 }
 
+// The arguments are only evaluated when the level is enabled at runtime
+#define LOG_FORMAT(level, ...) \
+    do { \
+        if (K::Log::IsEnabled(level)) { \
+            K::Log::Push(level, __FILE__, __LINE__, format_log(__VA_ARGS__)); \
+        } \
+    } while(0)
+
+// Compiled out levels still type check their arguments, but generate no code
+#define LOG_DISABLED(...) \
+    do { \
+        if (false) { \
+            format_log(__VA_ARGS__); \
+        } \
+    } while(0)
+
+// Fallback when no arguments are provided
+#define LOG(level, ...) LOG_FORMAT(level, ##__VA_ARGS__)
+
 // Define specific macros for each debug level with optional tag
+#if DEBUG_LEVEL >= DEBUG_LEVEL_ERROR
 #define LOG_ERROR(...) LOG(DEBUG_LEVEL_ERROR, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if DEBUG_LEVEL >= DEBUG_LEVEL_WARN
 #define LOG_WARN(...) LOG(DEBUG_LEVEL_WARN, ##__VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if DEBUG_LEVEL >= DEBUG_LEVEL_INFO
 #define LOG_INFO(...) LOG(DEBUG_LEVEL_INFO, ##__VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if DEBUG_LEVEL >= DEBUG_LEVEL_DEBUG
 #define LOG_DEBUG(...) LOG(DEBUG_LEVEL_DEBUG, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISABLED(__VA_ARGS__)
+#endif
+
+#if DEBUG_LEVEL >= DEBUG_LEVEL_TRACE
 #define LOG_TRACE(...) LOG(DEBUG_LEVEL_TRACE, ##__VA_ARGS__)
+#else
+#define LOG_TRACE(...) LOG_DISABLED(__VA_ARGS__)
+#endif
 
-#endif // __K_LOG_H__
\ No newline at end of file
+#endif // __K_LOG_H__
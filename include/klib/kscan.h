@@ -0,0 +1,76 @@
+#ifndef __K_SCAN_H__
+#define __K_SCAN_H__
+
+#include "ktypes.h"
+#include "kenum.h"
+
+#include <cstddef>
+
+/**
+    The KLib Scan library. Vectorized scanners that skip runs of bytes 16 or 32 at a time.
+    The best implementation the CPU supports (AVX2 or SSE2 on x86-64, NEON on arm64) is
+    chosen at runtime the first time a scanner is used, with a scalar fallback everywhere.
+    All scanners return the same results whichever implementation is active.
+ */
+namespace K::Scan {
+    K_ENUM(Level, SCALAR, SSE2, AVX2, NEON);
+
+    /**
+     * @brief The implementation the scanners currently dispatch to
+     *
+     */
+    Level::Enum GetLevel();
+
+    /**
+     * @brief Check whether this CPU and build can run the given implementation
+     *
+     */
+    bool IsSupported(Level::Enum level);
+
+    /**
+     * @brief Force the scanners onto a specific implementation, mostly for tests and benchmarks
+     *
+     * @return false - The implementation is not supported here, the active one is unchanged
+     */
+    bool SetLevel(Level::Enum level);
+
+    /**
+     * @brief The length of the run of ' ', '\t', '\r', '\f' and '\v' at the start of `s`
+     *
+     */
+    size_t SkipBlanks(const char* s, size_t size);
+
+    /**
+     * @brief The length of the run of [A-Za-z0-9_] at the start of `s`
+     *
+     */
+    size_t SkipIdentChars(const char* s, size_t size);
+
+    /**
+     * @brief The index of the first '\n' or '\r' in `s`, or `size` if there is none
+     *
+     */
+    size_t FindLineEnd(const char* s, size_t size);
+
+    /**
+     * @brief The index of the first '*' directly followed by '/' in `s`, or `size` if there is none
+     *
+     */
+    size_t FindBlockCommentEnd(const char* s, size_t size);
+
+    /**
+     * @brief The number of '\n' bytes in `s`
+     *
+     */
+    size_t CountNewlines(const char* s, size_t size);
+
+    /**
+     * @brief Write the index of every '\n' in `s` to `positions`, which needs room for 
+     *      CountNewlines(s, size) entries. `s` must be smaller than 4 GiB.
+     *
+     * @return size_t - The number of indices written
+     */
+    size_t FindNewlines(const char* s, size_t size, u32* positions);
+}
+
+#endif // __K_SCAN_H__
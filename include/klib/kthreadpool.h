@@ -0,0 +1,85 @@
+#ifndef __K_THREAD_POOL_H__
+#define __K_THREAD_POOL_H__
+
+#include "ktypes.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+    The KLib ThreadPool. A fixed set of workers that each own a task deque. Workers run their 
+    own tasks newest first and steal the oldest task from another worker when they run dry, so 
+    tasks submitted from inside a task stay on the worker that spawned them.
+ */
+namespace K {
+    class ThreadPool {
+    public:
+        typedef std::function<void()> Task;
+
+        /**
+         * @param threadCount - The number of workers, 0 uses one per hardware thread
+         */
+        explicit ThreadPool(size_t threadCount = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        /**
+         * @brief Queue a task. May be called from any thread, including from inside a task.
+         * 
+         */
+        void Submit(Task task);
+
+        /**
+         * @brief Block until every submitted task, including tasks they submit, has finished. 
+         *      The calling thread runs queued tasks while it waits. Must not be called from a task.
+         * 
+         * @throws The first exception thrown by a task since the last Wait()
+         */
+        void Wait();
+
+        /**
+         * @brief Run a batch of tasks and block until all of them have finished, running queued 
+         *      tasks on the calling thread while waiting. Unlike Wait() this may be called from a task.
+         * 
+         * @throws The first exception thrown by a task of the batch
+         */
+        void RunBatch(std::vector<Task> tasks);
+
+        size_t GetThreadCount() const { return m_Threads.size(); }
+
+    private:
+        struct WorkerQueue {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        void _WorkerLoop(size_t index);
+        bool _TryRunOne(size_t index);
+
+        std::vector<std::unique_ptr<WorkerQueue>> m_Queues;
+        std::vector<std::thread> m_Threads;
+
+        std::atomic<size_t> m_Queued = 0;       // Tasks sitting in a queue
+        std::atomic<size_t> m_Pending = 0;      // Tasks submitted but not finished
+        std::atomic<size_t> m_NextQueue = 0;
+        std::atomic<bool> m_Stopping = false;
+
+        std::mutex m_SleepMutex;
+        std::condition_variable m_WorkAvailable;
+        std::condition_variable m_AllDone;
+
+        std::mutex m_ErrorMutex;
+        std::exception_ptr m_FirstError;
+    };
+}
+
+#endif // __K_THREAD_POOL_H__
@@ -0,0 +1,119 @@
+#ifndef __K_WRITER_H__
+#define __K_WRITER_H__
+
+#include "ktypes.h"
+
+#include <atomic>
+#include <charconv>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/**
+    The KLib Writer. Formats output into a large reusable buffer and hands it to the file in
+    a few big writes instead of one per line. Optionally a background thread does the writing
+    while the caller formats into a second buffer, so formatting and I/O overlap.
+ */
+namespace K {
+    class Writer {
+    public:
+        static constexpr size_t c_DefaultBufferSize = 1024 * 1024;
+
+        explicit Writer(size_t bufferSize = c_DefaultBufferSize);
+        ~Writer();
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        /**
+         * @brief Create or truncate a file to write to
+         *
+         * @param filepath   - The file to write
+         * @param background - Write full buffers from a background thread
+         * @return false - The file could not be opened
+         */
+        bool Open(const std::string& filepath, bool background = false);
+
+        /**
+         * @brief Write to the process's standard output
+         *
+         */
+        void OpenStdout(bool background = false);
+
+        /**
+         * @brief Flush everything and close the file
+         *
+         * @return false - Some of the output could not be written
+         */
+        bool Close();
+
+        /**
+         * @brief Write out everything buffered so far
+         *
+         */
+        void Flush();
+
+        void Write(std::string_view text) {
+            if (text.size() > m_Buffer.size() - m_Size) {
+                _Drain();
+                if (text.size() > m_Buffer.size()) {
+                    _WriteDirect(text);
+                    return;
+                }
+            }
+            std::memcpy(m_Buffer.data() + m_Size, text.data(), text.size());
+            m_Size += text.size();
+        }
+
+        void Write(char c) {
+            if (m_Size == m_Buffer.size()) {
+                _Drain();
+            }
+            m_Buffer[m_Size++] = c;
+        }
+
+        void WriteNumber(u64 value) {
+            if (m_Buffer.size() - m_Size < 20) {
+                _Drain();
+            }
+            m_Size = std::to_chars(m_Buffer.data() + m_Size, m_Buffer.data() + m_Buffer.size(), value).ptr - m_Buffer.data();
+        }
+
+        /**
+         * @brief Write a quoted CSV field, doubling any quotes inside it
+         *
+         */
+        void WriteCsvField(std::string_view field);
+
+    private:
+        void _Start(bool background);
+        void _Drain();
+        void _WaitIdle();
+        void _WriteDirect(std::string_view text);
+        void _Output(const char* data, size_t size);
+        void _Run();
+
+        FILE* m_File = nullptr;
+        bool m_OwnsFile = false;
+        std::atomic<bool> m_Failed = false;
+
+        std::vector<char> m_Buffer;
+        size_t m_Size = 0;
+
+        // The background thread owns m_Pending while m_PendingSize is not 0
+        bool m_Background = false;
+        std::thread m_Thread;
+        std::mutex m_Mutex;
+        std::condition_variable m_Condition;
+        std::vector<char> m_Pending;
+        size_t m_PendingSize = 0;
+        bool m_Stopping = false;
+    };
+}
+
+#endif // __K_WRITER_H__
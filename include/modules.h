@@ -0,0 +1,167 @@
+#ifndef __MODULES_H__
+#define __MODULES_H__
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "tokenizer.h"
+#include "parser.h"
+
+namespace K {
+    class ThreadPool;
+}
+
+namespace JR::Tokenizer {
+    class TokenCache;
+}
+
+namespace JR::Modules {
+    struct Module;
+
+    /**
+     * @brief A `use` item of a module and the module it resolved to
+     *
+     */
+    struct Import {
+        Module* module;
+        u32 node;               // The USE node in the importing module's syntax tree
+    };
+
+    /**
+     * @brief One source file and everything produced for it
+     *
+     */
+    struct Module {
+        std::string name;       // The dotted path it was imported by, or the file path of an input
+        std::string filepath;
+        Tokenizer::Lexer lexer;
+        Parser::Parser parser;
+        std::vector<Import> imports;    // In source order
+        bool tokenized = false;
+        std::vector<std::string> errors;    // Empty when the module was loaded successfully
+
+        // Bookkeeping for loaders kept across builds, see ModuleLoader::Invalidate
+        bool stale = false;         // The file changed since it was loaded
+        bool resolved = false;      // Every `use` item was found when the imports were last resolved
+        u32 resolvedIn = 0;         // The loader generation the imports were last resolved in
+        size_t loadErrors = 0;      // The errors before this come from loading, the rest from the last cycle check
+    };
+
+    /**
+     * @brief Loads input files and, transitively, the modules they `use`, each on the pool as
+     *      soon as it is discovered. `use a.b` is looked up as a/b.jr in each search root in
+     *      order. Every file is loaded once however many modules import it, and modules never
+     *      wait on their imports, so import cycles are found afterwards by Wait(). A loader
+     *      can be kept across builds, changed files are then reloaded and the rest reused.
+     */
+    class ModuleLoader {
+    public:
+        /**
+         * @param pool        - The pool to load modules on, shared with the lexer and parser
+         * @param searchRoots - The directories to look up imported modules in, `use` items are
+         *      not followed when empty
+         * @param engine      - The lexer engine to tokenize with
+         * @param cache       - The token cache to load unchanged files from, or nullptr
+         */
+        ModuleLoader(K::ThreadPool& pool, std::vector<std::string> searchRoots,
+            Tokenizer::LexerEngine::Enum engine = Tokenizer::LexerEngine::DFA, Tokenizer::TokenCache* cache = nullptr);
+
+        ModuleLoader(const ModuleLoader&) = delete;
+        ModuleLoader& operator=(const ModuleLoader&) = delete;
+
+        /**
+         * @brief Start loading an input file, returning its module. A file that is already
+         *      loaded, as an input or an import, is not loaded again.
+         *
+         */
+        Module& Add(const std::string& filepath);
+
+        /**
+         * @brief Block until every added module and all of their imports are loaded, then
+         *      record an error on every module whose import closes a cycle. Must not be called from a task.
+         *
+         */
+        void Wait();
+
+        /**
+         * @brief Call `watcher` with the canonical path of every file just before it is first read,
+         *      e.g. to watch it for changes so none made while it is loaded are missed. The watcher
+         *      is called from the pool's workers, possibly several at once.
+         */
+        void SetWatcher(std::function<void(const std::string& filepath)> watcher) { m_Watcher = std::move(watcher); }
+
+        /**
+         * @brief Forget the added files for the next build, keeping every loaded module to reuse
+         *
+         */
+        void ResetInputs();
+
+        /**
+         * @brief Reload a file the next time a build reaches it, for files changed on disk
+         *
+         */
+        void Invalidate(const std::string& filepath);
+
+        /**
+         * @brief Look every `use` item up again the next time a build reaches it, for when files
+         *      were created or removed under the search roots. Items that were not found are
+         *      looked up again by every build anyway.
+         */
+        void InvalidateImports();
+
+        /**
+         * @brief The modules of the added files, in the order they were first added
+         *
+         */
+        const std::vector<Module*>& GetInputs() const { return m_Inputs; }
+
+        /**
+         * @brief Every module after Wait(), the inputs in the order they were added followed
+         *      by their imports in the order a depth first walk of the imports reaches them
+         */
+        const std::vector<Module*>& GetModules() const { return m_Modules; }
+
+        const std::vector<std::string>& GetSearchRoots() const { return m_SearchRoots; }
+
+        /**
+         * @brief The file a dotted module path maps to under the first search root that has it
+         *
+         * @return std::string - The path, or empty if no search root has the module
+         */
+        std::string Resolve(std::string_view name) const;
+
+        /**
+         * @brief Split a list of search roots separated like the PATH variable, by `:` or by `;` on Windows
+         *
+         */
+        static std::vector<std::string> SplitSearchPath(std::string_view paths);
+
+    private:
+        Module& _Request(const std::string& name, const std::string& filepath);
+        void _Load(Module& module);
+        void _ResolveImports(Module& module);
+        bool _Refresh();
+        void _CheckCycles();
+        static std::string _Error(const Module& module, u32 node, const std::string& description);
+
+        K::ThreadPool& m_Pool;
+        std::vector<std::string> m_SearchRoots;
+        Tokenizer::LexerEngine::Enum m_Engine;
+        Tokenizer::TokenCache* m_Cache;
+        std::function<void(const std::string& filepath)> m_Watcher;
+
+        std::mutex m_Mutex;
+        std::unordered_map<std::string, Module*> m_ByPath;     // Keyed by canonical path
+        std::vector<std::unique_ptr<Module>> m_Storage;
+        std::vector<Module*> m_Inputs;
+        std::vector<Module*> m_Modules;
+        u32 m_Generation = 0;       // Counts the builds, see Module::resolvedIn
+    };
+}
+
+#endif // __MODULES_H__
@@ -0,0 +1,188 @@
+#ifndef __PARSER_H__
+#define __PARSER_H__
+
+#include <string>
+#include <string_view>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "ast.h"
+#include "tokenizer.h"
+
+namespace K {
+    class ThreadPool;
+}
+
+namespace JR::Parser {
+    /**
+     * @brief Generic Parser exception
+     *
+    */
+    class ParserException : public std::exception {
+    public:
+        ParserException(std::string filepath, std::string description, size_t line, size_t column) {
+            m_Filepath = filepath;
+            m_Description = description;
+            m_Line = std::to_string(line);
+            m_Column =  std::to_string(column);
+        }
+
+        std::string what() {
+            return m_Filepath + ":" + m_Line + ":" + m_Column + ": Parser error => " + m_Description;
+        }
+    protected:
+        std::string m_Filepath;
+        std::string m_Description;
+        std::string m_Line;
+        std::string m_Column;
+    };
+
+    /**
+     * @brief A recursive descent parser over the tokens of one file, with precedence
+     *      climbing for binary operators. Every instance owns all of its state, so several
+     *      can parse different files on different threads at the same time.
+     */
+    class Parser {
+    public:
+        Parser() = default;
+        Parser(const Parser&) = delete;
+        Parser& operator=(const Parser&) = delete;
+
+        /**
+         * @brief Parse every token of a file into a syntax tree
+         *
+         * @param filepath - The name reported in diagnostics
+         * @param tokens   - The tokens of the whole file, which must outlive the tree
+         * @throws ParserException at the first syntax error
+         */
+        void Parse(std::string filepath, const Tokenizer::TokenStream& tokens);
+
+        /**
+         * @brief Parse every token of a file, splitting it between top level items and parsing 
+         *      groups of items in parallel on the pool. The tree is exactly the one Parse builds 
+         *      and a syntax error is the one Parse reports. May be called from a pool task.
+         * 
+         * @param filepath    - The name reported in diagnostics
+         * @param tokens      - The tokens of the whole file, which must outlive the tree
+         * @param pool        - The pool to parse the groups on
+         * @param chunkTokens - The approximate number of tokens per group
+         * @throws ParserException at the first syntax error
+         */
+        void ParseParallel(std::string filepath, const Tokenizer::TokenStream& tokens, K::ThreadPool& pool, size_t chunkTokens = c_DefaultChunkTokens);
+
+        static constexpr size_t c_DefaultChunkTokens = 64 * 1024;
+
+        /**
+         * @brief Release the tree
+         *
+         */
+        void Reset();
+
+        const Ast& GetAst() const { return m_Ast; }
+        const std::string& GetFilepath() const { return m_Filepath; }
+
+    private:
+        struct ChildList {
+            u32 first = c_NoNode;
+            u32 last = c_NoNode;
+        };
+
+        // Where a speculative parse started, to go back to if it turns out to be something else
+        struct Mark {
+            u32 position;
+            u32 size;
+        };
+
+        // Counts a level of recursion for as long as it lives, so input nested deeper than
+        // c_MaxDepth is a syntax error instead of a stack overflow
+        class DepthGuard {
+        public:
+            DepthGuard(Parser& parser, const char* description);
+            ~DepthGuard() { m_Parser.m_Depth--; }
+
+        private:
+            Parser& m_Parser;
+        };
+
+        static constexpr u32 c_MaxDepth = 1000;
+
+        void _Begin(std::string filepath, const Tokenizer::TokenStream& tokens, u32 begin, u32 end);
+        static std::vector<u32> _FindChunks(const Tokenizer::TokenStream& tokens, size_t chunkTokens);
+        void _Merge(const std::vector<std::unique_ptr<Parser>>& chunks, const std::vector<ChildList>& items, K::ThreadPool& pool);
+
+        // Declarations
+        ChildList _ParseItems();
+        u32 _ParseItem();
+        u32 _ParseUse();
+        u32 _ParseClass(u8 modifiers);
+        u32 _ParseClassMember();
+        u32 _ParseFunction(u8 modifiers);
+        u32 _ParseParameters(bool allowModifiers);
+        u8 _ParseModifiers();
+
+        // Types
+        u32 _ParseType();
+        u32 _TryParseType();
+        u32 _ParseTypeName();
+        bool _CloseAngle();
+
+        // Statements
+        u32 _ParseBlock();
+        void _ParseStatements(ChildList& statements);
+        u32 _ParseStatement();
+        u32 _ParseLet();
+        u32 _ParseDeclaration();
+        u32 _ParseIf();
+        u32 _ParseWhile();
+        u32 _ParseFor();
+        u32 _ParseReturn();
+        void _EndStatement();
+        bool _AtStatementEnd();
+
+        // Expressions
+        u32 _ParseExpression(u32 minPrecedence = 1);
+        u32 _ParseUnary();
+        u32 _ParsePostfix(u32 operand);
+        u32 _ParsePrimary();
+        u32 _ParseArguments();
+        u32 _ParseClosure();
+        u32 _ParseClosureParameters(u32 open);
+
+        // Tokens
+        u32 _Current();
+        const Tokenizer::Token& _Token(u32 index) const { return (*m_Tokens)[index]; }
+        bool _Is(Tokenizer::TokenType::Enum type) { return _Current() < m_End && _Token(m_Position).type == type; }
+        bool _IsOperator(std::string_view op);
+        bool _IsKeyword(u32 symbol);
+        bool _LineBreakBefore(u32 index) const;
+        void _SkipNewlines();
+        void _SkipSeparators();
+        u32 _Expect(Tokenizer::TokenType::Enum type, const char* what);
+        u32 _ExpectOperator(std::string_view op);
+        u32 _ExpectName(const char* what);
+
+        // Nodes
+        u32 _Node(u32 kind, u32 token, u32 child = c_NoNode, u8 flags = 0);
+        u32 _Empty();
+        u32 _Link(std::initializer_list<u32> children);
+        void _Append(ChildList& list, u32 node);
+        Mark _Mark() const { return { m_Position, m_Ast.Size() }; }
+        void _Rewind(const Mark& mark);
+
+        ParserException _Error(const std::string& description, u32 index) const;
+        ParserException _Expected(const char* what);
+
+        std::string m_Filepath;
+        const Tokenizer::TokenStream* m_Tokens = nullptr;
+        Ast m_Ast;
+
+        u32 m_Position = 0;
+        u32 m_End = 0;
+        u32 m_Nesting = 0;          // Open parentheses and brackets, inside which new lines are ignored
+        bool m_SplitAngle = false;  // The first `>` of the current `>>` token closed a generic argument list
+        u32 m_Depth = 0;            // Expressions, blocks and types being parsed around the current token
+    };
+}
+
+#endif // __PARSER_H__
@@ -0,0 +1,182 @@
+#ifndef __SOURCE_H__
+#define __SOURCE_H__
+
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "klib/ktypes.h"
+
+namespace JR {
+    /**
+     * @brief A read-only view of a source file's bytes. Regular files are memory mapped 
+     *      so the lexer runs directly over the page cache, anything that cannot be mapped 
+     *      (pipes, stdin) is read into an owned buffer instead.
+     */
+    class SourceBuffer {
+    public:
+        SourceBuffer() = default;
+        ~SourceBuffer();
+
+        SourceBuffer(const SourceBuffer&) = delete;
+        SourceBuffer& operator=(const SourceBuffer&) = delete;
+        SourceBuffer(SourceBuffer&& other) noexcept;
+        SourceBuffer& operator=(SourceBuffer&& other) noexcept;
+
+        /**
+         * @brief Load a file, replacing the current contents
+         * 
+         * @param filepath - The path to the file, or "-" to read stdin
+         * @throws std::runtime_error if the file cannot be opened or read
+         */
+        void Open(const std::string& filepath);
+
+        /**
+         * @brief Replace the contents with a copy of in-memory text, e.g. an unsaved editor buffer
+         * 
+         */
+        void Assign(std::string_view text);
+
+        /**
+         * @brief Replace `removedLength` bytes at `offset` with `insertedText`. A mapped 
+         *      file is copied into an owned buffer first, the file itself is never written.
+         *      The bytes after the edit are moved, so this is linear in the size of the buffer.
+         *      Invalidates every view of the old data.
+         * 
+         * @throws std::out_of_range if the removed range is not inside the buffer
+         */
+        void Replace(size_t offset, size_t removedLength, std::string_view insertedText);
+
+        /**
+         * @brief Release the mapping or owned buffer
+         * 
+         */
+        void Close();
+
+        std::string_view Data() const { return std::string_view(m_Data, m_Size); }
+        size_t Size() const { return m_Size; }
+        bool IsMapped() const { return m_Mapped; }
+
+    private:
+        const char* m_Data = nullptr;
+        size_t m_Size = 0;
+        bool m_Mapped = false;
+
+        std::vector<char> m_Owned;
+    };
+
+    /**
+     * @brief A line and column in a source file, both starting at 1. Columns count bytes.
+     */
+    struct SourcePosition {
+        u32 line = 1;
+        u32 column = 1;
+    };
+
+    /**
+     * @brief The offsets every line of a text starts at, so positions are kept as byte 
+     *      offsets and only turned into lines and columns when something asks for one
+     */
+    class LineIndex {
+    public:
+        /**
+         * @brief Index the lines of `text`, replacing the current index
+         * 
+         * @param text   - The text, smaller than 4 GiB
+         * @param origin - The position of the text's first byte, for a window into a longer text
+         */
+        void Build(std::string_view text, SourcePosition origin = {});
+
+        /**
+         * @brief The line and column of a byte offset into the indexed text
+         * 
+         */
+        SourcePosition Lookup(size_t offset) const;
+
+        /**
+         * @brief Look up offsets visited in increasing order, e.g. while writing out every token. 
+         *      `line` holds the line found by the previous call, start it at 0, and the search 
+         *      walks forward from it instead of starting over.
+         */
+        SourcePosition Lookup(size_t offset, size_t& line) const;
+
+        bool IsBuilt() const { return !m_LineStarts.empty(); }
+        void Clear() { m_LineStarts.clear(); }
+
+    private:
+        SourcePosition _Position(size_t offset, size_t line) const;
+
+        std::vector<u32> m_LineStarts;      // The first line starts at 0, the rest after a '\n'
+        SourcePosition m_Origin;
+    };
+
+    /**
+     * @brief A window over a file or pipe that is read a chunk at a time, for input that is 
+     *      generated on the fly or too large to hold at once. Bytes the reader has released 
+     *      are dropped when the next chunk is read, so memory stays bounded by the chunk size 
+     *      plus whatever is still held rather than by the length of the input.
+     */
+    class StreamBuffer {
+    public:
+        static constexpr size_t c_DefaultChunkSize = 64 * 1024;
+
+        StreamBuffer() = default;
+        ~StreamBuffer();
+
+        StreamBuffer(const StreamBuffer&) = delete;
+        StreamBuffer& operator=(const StreamBuffer&) = delete;
+
+        /**
+         * @brief Start reading a file, nothing is read before the first ReadChunk
+         * 
+         * @param filepath  - The path to the file, or "-" to read stdin
+         * @param chunkSize - The number of bytes read at a time
+         * @throws std::runtime_error if the file cannot be opened
+         */
+        void Open(const std::string& filepath, size_t chunkSize = c_DefaultChunkSize);
+
+        /**
+         * @brief Drop the released bytes and append the next chunk to the window. While 
+         *      nothing is released reads grow with the window, so text spanning many 
+         *      chunks is still read in linear time. Invalidates every view of the window.
+         * 
+         * @return false - The input has ended and nothing was appended
+         * @throws std::runtime_error if the file cannot be read
+         */
+        bool ReadChunk();
+
+        /**
+         * @brief Allow every byte before the absolute `offset` to be dropped
+         * 
+         */
+        void Release(u64 offset);
+
+        /**
+         * @brief Close the file and free the window
+         * 
+         */
+        void Close();
+
+        // The bytes read and not dropped yet, the first of them is at absolute offset Begin()
+        std::string_view Data() const { return std::string_view(m_Buffer.data() + m_Start, m_Size); }
+        u64 Begin() const { return m_Begin; }
+        bool AtEnd() const { return m_AtEnd; }
+        size_t Capacity() const { return m_Buffer.size(); }
+
+    private:
+        FILE* m_File = nullptr;
+        bool m_OwnsFile = false;
+        bool m_AtEnd = false;
+        std::string m_Filepath;
+        size_t m_ChunkSize = c_DefaultChunkSize;
+
+        std::vector<char> m_Buffer;
+        size_t m_Start = 0;         // Where the window starts in m_Buffer
+        size_t m_Size = 0;
+        size_t m_Released = 0;      // Bytes at the start of the window that may be dropped
+        u64 m_Begin = 0;
+    };
+}
+
+#endif // __SOURCE_H__
@@ -0,0 +1,79 @@
+#ifndef __TOKEN_CACHE_H__
+#define __TOKEN_CACHE_H__
+
+#include <mutex>
+#include <string>
+#include <string_view>
+
+#include "klib/ktypes.h"
+
+namespace JR::Tokenizer {
+    class TokenStream;
+
+    /**
+     * @brief A directory of lexed token streams keyed by a hash of the source text, so files
+     *      that did not change since an earlier run skip the lexer. Every entry records the
+     *      RulesFingerprint() it was lexed with and is ignored once the rules change. When the
+     *      directory grows past its size limit the least recently used entries are deleted.
+     *      Safe to share between threads, and between processes using the same directory.
+     */
+    class TokenCache {
+    public:
+        static constexpr u64 c_DefaultMaxBytes = 256ull * 1024 * 1024;
+
+        /**
+         * @brief Use a cache directory, creating it if it does not exist and evicting entries if
+         *      it is already over the size limit
+         *
+         * @param directory - The directory the entries are stored in
+         * @param maxBytes  - The total size of the entries to evict down to
+         * @throws std::filesystem::filesystem_error if the directory cannot be created
+         */
+        TokenCache(std::string directory, u64 maxBytes = c_DefaultMaxBytes);
+
+        TokenCache(const TokenCache&) = delete;
+        TokenCache& operator=(const TokenCache&) = delete;
+
+        /**
+         * @brief The key of a source buffer's entry
+         *
+         */
+        static u64 Hash(std::string_view source);
+
+        /**
+         * @brief Load the tokens lexed from `source` into an empty stream already pointed at it.
+         *      The entry is memory mapped and copied into the stream, only the distinct names
+         *      are interned again.
+         *
+         * @param hash   - Hash(source)
+         * @param source - The text the tokens index into
+         * @param tokens - The stream to fill
+         * @return false - There is no valid entry for the source, the stream is left empty
+         */
+        bool Load(u64 hash, std::string_view source, TokenStream& tokens);
+
+        /**
+         * @brief Store the tokens lexed from `source`, then evict old entries if the cache is
+         *      over its size limit. Entries appear atomically, a failure to write one is ignored.
+         *
+         * @param hash   - Hash(source)
+         * @param source - The text the tokens index into
+         * @param tokens - Every token lexed from the source
+         */
+        void Store(u64 hash, std::string_view source, const TokenStream& tokens);
+
+        const std::string& GetDirectory() const { return m_Directory; }
+        u64 GetMaxBytes() const { return m_MaxBytes; }
+
+    private:
+        std::string _EntryPath(u64 hash, size_t sourceSize) const;
+        void _Evict();
+
+        std::string m_Directory;
+        u64 m_MaxBytes;
+        std::mutex m_EvictMutex;
+        u64 m_Bytes = 0;        // The size of the entries when the directory was last listed plus those stored since
+    };
+}
+
+#endif // __TOKEN_CACHE_H__
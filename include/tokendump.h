@@ -0,0 +1,169 @@
+#ifndef __TOKEN_DUMP_H__
+#define __TOKEN_DUMP_H__
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "klib/ktypes.h"
+#include "klib/karena.h"
+#include "source.h"
+
+/*
+*   The binary token dump, a compact alternative to the tokenizer CSV for tools. All integers
+*   are little endian. The file is laid out as
+*
+*       Header          magic "JRTD", u32 version, u32 file count, u32 type count,
+*                       u64 string table offset, u64 file size
+*       Type names      u32 string index per token type value, so readers never depend on the enum
+*       Files           per input: u32 path string, u32 token count, u64 types offset,
+*                       u64 tokens offset, u64 tokens size
+*       Per input       u8 type per token, then per token the varints
+*                       offset - previous offset, length, line - previous line,
+*                       column (minus the previous column when on the same line), content string
+*       String table    u32 count, u32 offsets[count + 1] into the blob, blob
+*
+*   Every distinct string is stored once, so names and operators cost a varint per use.
+*/
+namespace JR::Tokenizer {
+    class TokenStream;
+
+    constexpr u32 c_TokenDumpVersion = 1;
+
+    /**
+     * @brief Collects the tokens of one or more files and writes them as a binary token dump
+     *
+     */
+    class TokenDumpWriter {
+    public:
+        TokenDumpWriter();
+        TokenDumpWriter(const TokenDumpWriter&) = delete;
+        TokenDumpWriter& operator=(const TokenDumpWriter&) = delete;
+
+        /**
+         * @brief Encode every token of a file, the stream is not referenced afterwards
+         *
+         * @param filepath - The path recorded for the tokens
+         * @param tokens   - The tokens lexed from the file
+         */
+        void Add(const std::string& filepath, const TokenStream& tokens);
+
+        /**
+         * @brief Write the dump of every file added so far
+         *
+         * @throws std::runtime_error if the file cannot be written
+         */
+        void Save(const std::string& filepath) const;
+
+    private:
+        u32 _Intern(std::string_view text);
+
+        struct File {
+            u32 path;
+            u32 tokenCount;
+            std::string types;
+            std::string tokens;
+        };
+        std::vector<File> m_Files;
+
+        K::Arena m_Arena = K::Arena(64 * 1024);
+        std::vector<std::string_view> m_Strings;                // Text lives in m_Arena
+        std::unordered_map<std::string_view, u32> m_StringIndices;
+        u32 m_TypeCount = 0;                                    // Type names are the first strings
+    };
+
+    /**
+     * @brief A token decoded from a dump, the content views the mapped file
+     *
+     */
+    struct DumpToken {
+        u8 type;            // TokenType::Enum when written by this version, see TokenDumpReader::TypeName
+        u32 offset;
+        u32 length;
+        u32 line;
+        u32 column;
+        std::string_view content;
+    };
+
+    /**
+     * @brief Maps a binary token dump and walks its tokens in place. Everything returned
+     *      views the mapping and is valid until the reader is closed or reopened.
+     */
+    class TokenDumpReader {
+    public:
+        TokenDumpReader() = default;
+
+        /**
+         * @brief Map a dump, replacing the current one
+         *
+         * @throws std::runtime_error if the file cannot be read or is not a valid dump of this version
+         */
+        void Open(const std::string& filepath);
+        void Close();
+
+        u32 FileCount() const { return m_FileCount; }
+        std::string_view FilePath(u32 file) const;
+        u32 TokenCount(u32 file) const;
+
+        /**
+         * @brief The name of a token type value, e.g. "IDENTIFIER"
+         *
+         */
+        std::string_view TypeName(u8 type) const;
+
+        /**
+         * @brief The type of every token of a file, one byte each
+         *
+         */
+        std::string_view Types(u32 file) const;
+
+        std::string_view String(u32 index) const;
+
+        /**
+         * @brief Decodes the tokens of one file front to back
+         *
+         */
+        class Cursor {
+        public:
+            /**
+             * @brief Decode the next token
+             *
+             * @return false - There are no more tokens, or the rest of the file is damaged
+             */
+            bool Next(DumpToken& token);
+
+        private:
+            friend class TokenDumpReader;
+
+            const TokenDumpReader* m_Reader = nullptr;
+            std::string_view m_Types;
+            const u8* m_Data = nullptr;
+            const u8* m_End = nullptr;
+            u32 m_Index = 0;
+            DumpToken m_Previous = {};
+        };
+
+        Cursor Tokens(u32 file) const;
+
+    private:
+        struct FileEntry {
+            u32 path;
+            u32 tokenCount;
+            u64 typesOffset;
+            u64 tokensOffset;
+            u64 tokensSize;
+        };
+        FileEntry _File(u32 file) const;
+
+        SourceBuffer m_File;
+        std::string_view m_Data;
+        u32 m_FileCount = 0;
+        u32 m_TypeCount = 0;
+        u32 m_StringCount = 0;
+        const u8* m_StringOffsets = nullptr;
+        std::string_view m_StringBlob;
+    };
+}
+
+#endif // __TOKEN_DUMP_H__
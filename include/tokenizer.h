@@ -2,19 +2,48 @@
 #define __TOKENIZER_H__
 
 #include <string>
+#include <memory>
+#include <string_view>
+#include <vector>
+#include <utility>
 
 #include "ref.h"
 #include "klib/kenum.h"
+#include "klib/karena.h"
+#include "klib/kinterner.h"
+#include "source.h"
+
+namespace K {
+    class ThreadPool;
+}
 
 namespace JR::Tokenizer {
-    struct Token;
+    class TokenStream;
+    class TokenRef;
+    class TokenCache;
+
+    /**
+     * @brief The matching engine used to split the input into tokens.
+     *      DFA is the hand-written single-pass lexer, REGEX is the original 
+     *      std::regex rule table, kept around to cross-check the DFA.
+     */
+    K_ENUM(
+        LexerEngine,
+        DFA, REGEX
+    );
     
+    /*
+    *   The free functions below tokenize through a Lexer owned by the calling thread.
+    *   Create Lexer instances directly to tokenize several files at once.
+    */
+
     /**
      * @brief Initialize the Tokenizer with a file path
      * 
      * @param filepath - The path to the file to tokenize
+     * @param engine   - The lexer engine to tokenize with
      */
-    void Init(std::string filepath);
+    void Init(std::string filepath, LexerEngine::Enum engine = LexerEngine::DFA);
 
     /**
      * @brief Reset the tokenizer
@@ -26,14 +55,33 @@ namespace JR::Tokenizer {
      * @brief Peek at the next token from the file
      * 
     */
-    Ref<Token> PeekToken();
+    TokenRef PeekToken();
 
     /**
      * @brief Retrieve the next token from the file
      * 
-     * @return Token 
+     * @return TokenRef - A handle to the token, valid until the tokenizer is reset
+     */
+    TokenRef NextToken();
+
+    /**
+     * @brief Every token lexed from the file so far, including the peeked token
+     * 
      */
-    Ref<Token> NextToken();
+    const TokenStream& GetTokenStream();
+
+    /**
+     * @brief The process wide table the names of IDENTIFIER, KEYWORD and TYPE tokens are 
+     *      interned into. Equal names get equal Token::symbol IDs across every file and thread.
+     */
+    K::Interner& GetSymbols();
+
+    /**
+     * @brief A hash of everything that decides how text is tokenized: the rule patterns, the 
+     *      reserved words, the token types and the Token layout. Tokens stored across runs 
+     *      are only valid for the fingerprint they were lexed with.
+     */
+    u64 RulesFingerprint();
 
     /**
      * @brief Generic Tokenizer exception
@@ -70,17 +118,386 @@ namespace JR::Tokenizer {
         OPEN_BRACKET, CLOSE_BRACKET,
         OPEN_ANGLE, CLOSE_ANGLE,
     );
+
+    /**
+     * @brief The name of a token type, e.g. "IDENTIFIER". TokenType::Strings leaves out NONE, 
+     *      so it is indexed by the value minus one.
+     */
+    inline std::string_view TokenTypeName(u32 type) {
+        if (type == TokenType::NONE || type > TokenType::Strings.size()) {
+            return "NONE";
+        }
+        return TokenType::Strings[type - 1];
+    }
     
+    namespace TokenFlags {
+        enum Enum: u8 {
+            NONE        = 0,
+            REWRITTEN   = 1 << 0,   // Content differs from the source text, e.g. hex literals converted to base 10
+            SUFFIX_F    = 1 << 1,   // FLOAT_LITERAL written with an `f` suffix
+        };
+    }
+
+    /**
+     * @brief A lexed token as stored in a TokenStream. It does not own its text, 
+     *      `offset` and `length` locate the whole match in the source buffer. The line 
+     *      and column are looked up from the offset by TokenStream::Position.
+     */
     struct Token {
-        std::string content;
-        TokenType::Enum type;
+        u8 type;            // TokenType::Enum
+        u8 flags;           // TokenFlags::Enum
+        u16 reserved;
+        u32 offset;
+        u32 length;
+
+        u32 symbol;         // Interned name of IDENTIFIER, KEYWORD and TYPE tokens in GetSymbols(), otherwise K::Interner::c_NoSymbol
+
+        // Decoded value of INTEGER_LITERAL (integer) and FLOAT_LITERAL (real) tokens, otherwise 0
+        union {
+            u64 integer;
+            double real;
+        } value;
+    };
+    static_assert(sizeof(Token) == 24, "Token should stay a compact POD");
+
+    /**
+     * @brief A range of input the lexer skipped instead of producing a token for
+     */
+    struct Trivia {
+        u8 type;            // COMMENT, WHITESPACE or a collapsed NEWLINE
+        u32 offset;
+        u32 length;
+    };
+
+    /**
+     * @brief A growable, arena backed array of tokens for one source buffer. Tokens are 
+     *      stored in fixed size blocks so they never move and are all freed at once.
+     */
+    class TokenStream {
+    public:
+        TokenStream() = default;
+        TokenStream(const TokenStream&) = delete;
+        TokenStream& operator=(const TokenStream&) = delete;
+        TokenStream(TokenStream&&) = default;
+        TokenStream& operator=(TokenStream&&) = default;
+
+        /**
+         * @brief Point the stream at the buffer its tokens index into
+         * 
+         * @param source - The buffer
+         * @param base   - The token offset `source` starts at, for a window over a longer stream. 
+         *      Offsets are compared modulo 2^32, so a window may sit past 4 GiB of input.
+         * @param origin - The position of the first byte of `source`
+         */
+        void SetSource(std::string_view source, u32 base = 0, SourcePosition origin = {}) {
+            m_Source = source;
+            m_Base = base;
+            m_Origin = origin;
+            m_Lines.Clear();
+        }
+        std::string_view GetSource() const { return m_Source; }
+        u32 GetBase() const { return m_Base; }
+
+        /**
+         * @brief The line and column of a token offset in the source. The line index is built 
+         *      by the first call after SetSource, so that call must not race with another.
+         */
+        SourcePosition PositionOf(u32 offset) const;
+        SourcePosition Position(u32 index) const { return PositionOf((*this)[index].offset); }
+
+        /**
+         * @brief The position of a token, for walking the tokens in order. `lineHint` carries 
+         *      the line between calls, see LineIndex::Lookup.
+         */
+        SourcePosition Position(u32 index, size_t& lineHint) const;
+
+        /**
+         * @brief Append a token, returning its index
+         * 
+         */
+        u32 Push(const Token& token);
+
+        /**
+         * @brief Append a token whose content is not a slice of the source, 
+         *      the content is copied into the stream's arena
+         */
+        u32 Push(const Token& token, std::string_view content);
+
+        const Token& operator[](u32 index) const {
+            return m_Blocks[index >> c_BlockShift][index & (c_BlockSize - 1)];
+        }
+
+        u32 Size() const { return m_Size; }
+        bool Empty() const { return m_Size == 0; }
+
+        /**
+         * @brief The text of the token, without the quotes for string and char literals. 
+         *      The view points into the source buffer, or into the stream for rewritten tokens.
+         */
+        std::string_view Content(u32 index) const;
+
+        TokenRef At(u32 index) const;
+
+        /**
+         * @brief Replace the tokens [first, first + count) with the tokens [from, from + inserted) 
+         *      of `replacement`. Later tokens move to close or open the gap, rewritten content 
+         *      of the new tokens is copied into this stream. The arena space of the removed 
+         *      tokens' rewritten content is only reclaimed by Clear().
+         */
+        void Splice(u32 first, u32 count, const TokenStream& replacement, u32 from, u32 inserted);
+
+        /**
+         * @brief Move every token from `first` on by `offsetDelta` bytes
+         * 
+         */
+        void Shift(u32 first, i64 offsetDelta);
 
-        size_t line;
-        size_t column;
+        /**
+         * @brief Free every token at once
+         * 
+         */
+        void Clear();
 
-        std::string ToString() {
-            return "Token(\"" + content + "\", " + TokenType::Strings[type] + ", " + std::to_string(line) + ", " + std::to_string(column) + ")";
+        /**
+         * @brief The number of bytes reserved for tokens
+         * 
+         */
+        size_t MemoryUsage() const { return m_Arena.BytesReserved(); }
+
+        class Iterator;
+        Iterator begin() const;
+        Iterator end() const;
+
+    private:
+        Token& _At(u32 index) { return m_Blocks[index >> c_BlockShift][index & (c_BlockSize - 1)]; }
+
+        static constexpr u32 c_BlockShift = 12;
+        static constexpr u32 c_BlockSize = 1 << c_BlockShift;
+
+        K::Arena m_Arena = K::Arena(c_BlockSize * sizeof(Token));
+        std::vector<Token*> m_Blocks;
+        u32 m_Size = 0;
+
+        std::string_view m_Source;
+        u32 m_Base = 0;
+        SourcePosition m_Origin;
+        mutable LineIndex m_Lines;
+        std::vector<std::pair<u32, std::string_view>> m_Rewritten;  // Sorted by token index, text lives in m_Arena
+    };
+
+    /**
+     * @brief A cheap handle to a token in a TokenStream. A null handle marks the end of the input.
+     * 
+     */
+    class TokenRef {
+    public:
+        TokenRef() = default;
+        TokenRef(const TokenStream* stream, u32 index) : m_Stream(stream), m_Index(index) {}
+
+        explicit operator bool() const { return m_Stream != nullptr; }
+        const Token* operator->() const { return &(*m_Stream)[m_Index]; }
+        const Token& operator*() const { return (*m_Stream)[m_Index]; }
+
+        u32 Index() const { return m_Index; }
+        std::string_view Content() const { return m_Stream->Content(m_Index); }
+        SourcePosition Position() const { return m_Stream->Position(m_Index); }
+
+        std::string ToString() const {
+            const Token& token = **this;
+            SourcePosition position = Position();
+            return "Token(\"" + std::string(Content()) + "\", " + std::string(TokenTypeName(token.type)) + ", " + std::to_string(position.line) + ", " + std::to_string(position.column) + ")";
         }
+
+    private:
+        const TokenStream* m_Stream = nullptr;
+        u32 m_Index = 0;
+    };
+
+    class TokenStream::Iterator {
+    public:
+        Iterator(const TokenStream* stream, u32 index) : m_Stream(stream), m_Index(index) {}
+
+        TokenRef operator*() const { return TokenRef(m_Stream, m_Index); }
+        Iterator& operator++() { m_Index++; return *this; }
+        bool operator!=(const Iterator& other) const { return m_Index != other.m_Index; }
+
+    private:
+        const TokenStream* m_Stream;
+        u32 m_Index;
+    };
+
+    inline TokenRef TokenStream::At(u32 index) const { return TokenRef(this, index); }
+    inline TokenStream::Iterator TokenStream::begin() const { return Iterator(this, 0); }
+    inline TokenStream::Iterator TokenStream::end() const { return Iterator(this, m_Size); }
+
+    /**
+     * @brief A tokenizer over one source file. Every instance owns all of its state, 
+     *      so several can lex different files on different threads at the same time.
+     */
+    class Lexer {
+    public:
+        Lexer() = default;
+        Lexer(const Lexer&) = delete;
+        Lexer& operator=(const Lexer&) = delete;
+
+        /**
+         * @brief Load a file and lex its first token
+         * 
+         * @param filepath - The path to the file to tokenize
+         * @param engine   - The lexer engine to tokenize with
+         */
+        void Init(std::string filepath, LexerEngine::Enum engine = LexerEngine::DFA);
+
+        /**
+         * @brief Load a file and lex all of it up front. Files larger than a chunk are split 
+         *      at newlines and the chunks are lexed in parallel on the pool, then stitched into 
+         *      exactly the tokens sequential lexing produces. May be called from a pool task.
+         * 
+         * @param filepath  - The path to the file to tokenize
+         * @param pool      - The pool to lex the chunks on
+         * @param engine    - The lexer engine to tokenize with
+         * @param chunkSize - The approximate number of bytes per chunk
+         */
+        void InitParallel(std::string filepath, K::ThreadPool& pool, LexerEngine::Enum engine = LexerEngine::DFA, size_t chunkSize = c_DefaultChunkSize);
+
+        static constexpr size_t c_DefaultChunkSize = 1024 * 1024;
+
+        /**
+         * @brief Lex in-memory text, e.g. an unsaved editor buffer, the same way Init lexes a file
+         * 
+         * @param filepath - The name reported in diagnostics
+         * @param text     - The text to tokenize, copied into the lexer
+         * @param engine   - The lexer engine to tokenize with
+         */
+        void InitBuffer(std::string filepath, std::string_view text, LexerEngine::Enum engine = LexerEngine::DFA);
+
+        /**
+         * @brief Lex a file or pipe as it is read, holding only a window of it in memory. 
+         *      Tokens are lexed one at a time as by Init and match it exactly, a token that 
+         *      straddles two chunks is relexed once the next chunk is in. Only the tokens 
+         *      from the last one returned by NextToken on are kept, so a handle is valid until 
+         *      the next call to NextToken, and GetTokenStream() only holds the recent tokens. 
+         *      Trivia is not kept for streamed input.
+         * 
+         * @param filepath  - The path to the file, or "-" to read stdin
+         * @param engine    - The lexer engine to tokenize with
+         * @param chunkSize - The number of bytes read at a time
+         */
+        void InitStream(std::string filepath, LexerEngine::Enum engine = LexerEngine::DFA, size_t chunkSize = StreamBuffer::c_DefaultChunkSize);
+
+        /**
+         * @brief Apply a text edit and relex only the damaged region. Relexing starts just 
+         *      before the edit and stops once it lines up with the old tokens again, which 
+         *      are then moved by the change in length. Afterwards the whole buffer is 
+         *      lexed and iteration restarts from the first token.
+         * 
+         *      Only the relexing is local. The text and every token after the edit are still 
+         *      moved, and the line index is rebuilt by the next position lookup, so an edit 
+         *      costs time linear in the length of the buffer. A one character edit in a 50k 
+         *      line (1.9 MB) buffer takes about 0.2 ms at the median and 0.5 ms at the 90th 
+         *      percentile, against about 10 ms for lexing it in full. The rewritten content of 
+         *      replaced tokens, e.g. hex literals, stays in the token stream's arena until the 
+         *      lexer is reset, so that grows with every edit that replaces such a token.
+         * 
+         * @param offset        - The byte offset of the edit in the current text
+         * @param removedLength - The number of bytes removed at `offset`
+         * @param insertedText  - The text inserted at `offset`
+         * @throws TokenizerException if the edited text does not lex, the tokens before the error are kept
+         * @throws std::runtime_error for streamed input, which is never held in full
+         */
+        void Edit(size_t offset, size_t removedLength, std::string_view insertedText);
+
+        /**
+         * @brief Release the file and every token, invalidating all handles
+         * 
+         */
+        void Reset();
+
+        /**
+         * @brief Peek at the next token from the file
+         * 
+         */
+        TokenRef PeekToken() const;
+
+        /**
+         * @brief Retrieve the next token from the file
+         * 
+         * @return TokenRef - A handle to the token, valid until the lexer is reset
+         */
+        TokenRef NextToken();
+
+        /**
+         * @brief Every token lexed from the file so far, including the peeked token
+         * 
+         */
+        const TokenStream& GetTokenStream() const { return m_Tokens; }
+
+        /**
+         * @brief Keep the comments, whitespace and collapsed newlines the lexer skips as 
+         *      Trivia ranges for tooling. Must be set before Init, Reset turns it off again.
+         * 
+         */
+        void SetKeepTrivia(bool keep) { m_KeepTrivia = keep; }
+
+        /**
+         * @brief Every skipped range lexed so far in source order, empty unless SetKeepTrivia was set
+         * 
+         */
+        const std::vector<Trivia>& GetTrivia() const { return m_Trivia; }
+
+        /**
+         * @brief Look InitParallel's tokens up in a cache before lexing and store them after. 
+         *      Not used while trivia is kept, the cache only holds tokens. Reset turns it off again.
+         * 
+         */
+        void SetTokenCache(TokenCache* cache) { m_TokenCache = cache; }
+
+        const std::string& GetFilepath() const { return m_Filepath; }
+
+    private:
+        TokenRef _ReadToken();
+        TokenizerException _Error(const char* description, size_t index) const;
+        bool _Refill();
+        TokenRef _DropStreamedTokens(TokenRef keep);
+        void _SkipTrivia(const Token& token);
+        u32 _InternSymbol(std::string_view name);
+        void _Stitch(std::vector<std::unique_ptr<Lexer>>& chunks, const std::vector<size_t>& boundaries);
+        void _AppendToken(const TokenStream& source, u32 index);
+
+        bool m_Initialized = false;
+        LexerEngine::Enum m_Engine = LexerEngine::DFA;
+
+        std::string m_Filepath = "";
+        SourceBuffer m_Source;
+        std::string_view m_Content;     // View of m_Source, or of m_Stream's window, that the lexer runs over
+
+        // Streamed input is lexed over a window, m_Index and m_End are relative to its start
+        bool m_Streaming = false;
+        StreamBuffer m_Stream;
+        u32 m_OffsetBase = 0;           // Token::offset of the window's first byte
+        SourcePosition m_Origin;        // Position of the window's first byte
+
+        size_t m_Index = 0;
+        size_t m_End = 0;               // No token starts at or after this offset
+
+        // Chunk lexers keep every NEWLINE, the collapsing is applied when the chunks are stitched
+        bool m_CollapseNewlines = true;
+
+        bool m_KeepTrivia = false;
+        std::vector<Trivia> m_Trivia;
+
+        TokenCache* m_TokenCache = nullptr;
+
+        // Direct mapped cache in front of GetSymbols(), names view the source buffer
+        struct SymbolCacheEntry {
+            std::string_view name;
+            u32 symbol = K::Interner::c_NoSymbol;
+        };
+        static constexpr size_t c_SymbolCacheSize = 1024;
+        std::vector<SymbolCacheEntry> m_SymbolCache;
+
+        TokenStream m_Tokens;
+        TokenRef m_CurrentToken;
     };
 }
 
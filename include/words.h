@@ -0,0 +1,50 @@
+#ifndef __WORDS_H__
+#define __WORDS_H__
+
+#include <string_view>
+
+#include "tokenizer.h"
+
+namespace JR::Tokenizer {
+    struct Word {
+        std::string_view text;
+        TokenType::Enum type;
+    };
+
+    /**
+     * @brief Every reserved word of the language and the token type an identifier 
+     *      spelling it is classified as. This is the single definition used by the 
+     *      lexer and the tests, add new keywords, types and word operators here.
+     */
+    inline constexpr Word s_Words[] = {
+        // Keywords
+        { "use", TokenType::KEYWORD }, { "exposing", TokenType::KEYWORD }, { "as", TokenType::KEYWORD },
+        { "fun", TokenType::KEYWORD }, { "let", TokenType::KEYWORD }, { "const", TokenType::KEYWORD },
+        { "class", TokenType::KEYWORD }, { "private", TokenType::KEYWORD }, { "protected", TokenType::KEYWORD },
+        { "public", TokenType::KEYWORD }, { "open", TokenType::KEYWORD }, { "static", TokenType::KEYWORD },
+        { "init", TokenType::KEYWORD }, { "constructor", TokenType::KEYWORD },
+        { "for", TokenType::KEYWORD }, { "in", TokenType::KEYWORD }, { "if", TokenType::KEYWORD },
+        { "else", TokenType::KEYWORD }, { "while", TokenType::KEYWORD },
+        { "sizeof", TokenType::KEYWORD }, { "type", TokenType::KEYWORD },
+        { "nullptr", TokenType::KEYWORD }, { "return", TokenType::KEYWORD },
+
+        // Types
+        { "void", TokenType::TYPE }, { "bool", TokenType::TYPE }, { "string", TokenType::TYPE },
+        { "uchar", TokenType::TYPE }, { "ushort", TokenType::TYPE }, { "uint", TokenType::TYPE }, { "ulong", TokenType::TYPE },
+        { "char", TokenType::TYPE }, { "short", TokenType::TYPE }, { "int", TokenType::TYPE }, { "long", TokenType::TYPE },
+        { "float", TokenType::TYPE }, { "double", TokenType::TYPE },
+
+        // Word operators
+        { "new", TokenType::OPERATOR }, { "delete", TokenType::OPERATOR },
+    };
+
+    /**
+     * @brief Classify an identifier against s_Words using a perfect hash built at compile time
+     * 
+     * @param word - The identifier text
+     * @return TokenType::Enum - The type from s_Words, or IDENTIFIER if the word is not reserved
+     */
+    TokenType::Enum ClassifyWord(std::string_view word);
+}
+
+#endif // __WORDS_H__
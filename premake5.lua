@@ -25,11 +25,15 @@ project "justrightc"
     externalincludedirs { "include" }
     buildoptions { "-O2" }
 
+    filter "system:linux"
+        links { "pthread" }
+
+    -- The most verbose log level compiled in, --log-level picks what is printed at runtime
     filter "configurations:Debug"
-        defines { "DEBUG" }
+        defines { "DEBUG", "DEBUG_LEVEL=DEBUG_LEVEL_TRACE" }
         symbols "On"
     filter "configurations:Release"
-        defines { "NDEBUG" }
+        defines { "NDEBUG", "DEBUG_LEVEL=DEBUG_LEVEL_INFO" }
         optimize "On"
 
 project "justrightc-tests"
@@ -51,6 +55,38 @@ project "justrightc-tests"
     testsDir = path.getabsolute("tests")
     buildoptions { "-O2", "-DTESTS_ROOT_DIR=" .. testsDir }
 
+    filter "system:linux"
+        links { "pthread" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        symbols "On"
+    filter "configurations:Release"
+        defines { "NDEBUG" }
+        optimize "On"
+
+project "justrightc-bench"
+    kind "ConsoleApp"
+    language "C++"
+    targetname "justrightc-bench"
+
+    cppdialect "C++17"
+    
+    targetdir "bin/%{cfg.buildcfg}/%{cfg.system}/%{cfg.architecture}/%{prj.name}"
+    objdir "bin-int/%{cfg.buildcfg}/%{cfg.system}/%{cfg.architecture}/%{prj.name}"
+
+    files { "src/**.cpp", "bench/**.cpp" }
+    excludes { "src/main.cpp" }
+    
+    includedirs { "include" }
+    externalincludedirs { "include" }
+
+    samplesDir = path.getabsolute("samples")
+    buildoptions { "-O2", "-DSAMPLES_ROOT_DIR=" .. samplesDir }
+
+    filter "system:linux"
+        links { "pthread" }
+
     filter "configurations:Debug"
         defines { "DEBUG" }
         symbols "On"
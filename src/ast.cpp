@@ -0,0 +1,131 @@
+#include <ast.h>
+
+#include <klib/kwriter.h>
+
+namespace JR::Parser {
+    namespace {
+        struct FlagName {
+            NodeFlags::Enum flag;
+            std::string_view name;
+        };
+
+        constexpr FlagName c_FlagNames[] = {
+            { NodeFlags::PRIVATE, "private" }, { NodeFlags::PROTECTED, "protected" }, { NodeFlags::PUBLIC, "public" },
+            { NodeFlags::OPEN, "open" }, { NodeFlags::STATIC, "static" },
+            { NodeFlags::WILDCARD, "wildcard" }, { NodeFlags::TRAILING_CLOSURE, "trailing" },
+        };
+
+        // MODULE has no token of its own and EMPTY stands in for a missing child
+        bool hasText(u32 kind) {
+            return kind != NodeKind::MODULE && kind != NodeKind::EMPTY;
+        }
+    }
+
+    u32 Ast::Push(const Node& node) {
+        if ((m_Size & (c_BlockSize - 1)) == 0 && (m_Size >> c_BlockShift) == m_Blocks.size()) {
+            m_Blocks.push_back(m_Arena.AllocateArray<Node>(c_BlockSize));
+        }
+
+        m_Blocks[m_Size >> c_BlockShift][m_Size & (c_BlockSize - 1)] = node;
+        return m_Size++;
+    }
+
+    void Ast::_Resize(u32 size) {
+        while (static_cast<size_t>(m_Blocks.size()) << c_BlockShift < size) {
+            m_Blocks.push_back(m_Arena.AllocateArray<Node>(c_BlockSize));
+        }
+        m_Size = size;
+    }
+
+    u32 Ast::Child(u32 index, u32 n) const {
+        u32 child = (*this)[index].child;
+        while (child != c_NoNode && n-- > 0) {
+            child = (*this)[child].next;
+        }
+        return child;
+    }
+
+    u32 Ast::ChildCount(u32 index) const {
+        u32 count = 0;
+        for (u32 child : ChildrenOf(index)) {
+            (void)child;
+            count++;
+        }
+        return count;
+    }
+
+    std::string Ast::ToString(u32 index) const {
+        std::string out;
+        _ToString(index, out);
+        return out;
+    }
+
+    void Ast::_ToString(u32 index, std::string& out) const {
+        const Node& node = (*this)[index];
+        if (node.kind == NodeKind::EMPTY) {
+            out += "_";
+            return;
+        }
+
+        out += "(";
+        out += NodeKindName(node.kind);
+        if (hasText(node.kind)) {
+            out += " \"";
+            out += Text(index);
+            out += "\"";
+        }
+        for (const FlagName& flag : c_FlagNames) {
+            if (node.flags & flag.flag) {
+                out += " ";
+                out += flag.name;
+            }
+        }
+        for (u32 child : ChildrenOf(index)) {
+            out += " ";
+            _ToString(child, out);
+        }
+        out += ")";
+    }
+
+    void Ast::Dump(K::Writer& out) const {
+        if (m_Root != c_NoNode) {
+            _Dump(out, m_Root, 0);
+        }
+    }
+
+    void Ast::_Dump(K::Writer& out, u32 index, u32 depth) const {
+        const Node& node = (*this)[index];
+        for (u32 i = 0; i < depth; i++) {
+            out.Write("  ");
+        }
+        out.Write(NodeKindName(node.kind));
+        if (hasText(node.kind)) {
+            out.Write(" \"");
+            out.Write(Text(index));
+            out.Write('"');
+            for (const FlagName& flag : c_FlagNames) {
+                if (node.flags & flag.flag) {
+                    out.Write(' ');
+                    out.Write(flag.name);
+                }
+            }
+            SourcePosition position = Position(index);
+            out.Write(' ');
+            out.WriteNumber(position.line);
+            out.Write(':');
+            out.WriteNumber(position.column);
+        }
+        out.Write('\n');
+
+        for (u32 child : ChildrenOf(index)) {
+            _Dump(out, child, depth + 1);
+        }
+    }
+
+    void Ast::Clear() {
+        m_Arena.Reset();
+        m_Blocks.clear();
+        m_Size = 0;
+        m_Root = c_NoNode;
+    }
+}
@@ -0,0 +1,451 @@
+#include <daemon.h>
+#include <tokencache.h>
+
+#include <klib/kflags.h>
+#include <log.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef __linux__
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+/*
+*   The protocol is one request per connection. The client sends a u32 size with its stdout and
+*   stderr attached as SCM_RIGHTS, then `size` bytes holding its working directory and arguments,
+*   each NUL terminated. The request writes straight to the client's descriptors, and once it is
+*   done the server answers with the i32 exit code and closes the connection.
+*/
+namespace JR::Daemon {
+    namespace fs = std::filesystem;
+
+    namespace {
+        constexpr u32 c_MaxRequestSize = 1024 * 1024;
+
+        std::runtime_error systemError(const std::string& what) {
+            return std::runtime_error(what + ": " + std::strerror(errno));
+        }
+
+#ifdef __linux__
+        constexpr u32 c_WatchEvents = IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+
+        // Written to by the signal handler, a pipe is the only way out of poll() that is async signal safe
+        std::atomic<int> s_SignalFd = -1;
+
+        void onSignal(int) {
+            int fd = s_SignalFd.load();
+            if (fd >= 0) {
+                char byte = 0;
+                (void)!write(fd, &byte, 1);
+            }
+        }
+
+        sockaddr_un socketAddress(const std::string& path) {
+            sockaddr_un address = {};
+            address.sun_family = AF_UNIX;
+            if (path.size() >= sizeof(address.sun_path)) {
+                throw std::runtime_error("Socket path is too long: " + path);
+            }
+            std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+            return address;
+        }
+
+        bool readAll(int fd, void* data, size_t size) {
+            char* out = static_cast<char*>(data);
+            while (size > 0) {
+                ssize_t read = recv(fd, out, size, 0);
+                if (read < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (read <= 0) {
+                    return false;
+                }
+                out += read;
+                size -= read;
+            }
+            return true;
+        }
+
+        bool writeAll(int fd, const void* data, size_t size) {
+            const char* in = static_cast<const char*>(data);
+            while (size > 0) {
+                ssize_t written = send(fd, in, size, MSG_NOSIGNAL);
+                if (written < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (written <= 0) {
+                    return false;
+                }
+                in += written;
+                size -= written;
+            }
+            return true;
+        }
+
+        // Everything buffered for stdout and stderr goes out before they are pointed somewhere else
+        void flushOutput() {
+            K::Log::Flush();
+            std::cout.flush();
+            std::cerr.flush();
+            fflush(stdout);
+            fflush(stderr);
+        }
+#endif
+    }
+
+    Server::Server(std::string socketPath, size_t jobs) : m_SocketPath(std::move(socketPath)), m_Pool(jobs) {
+#ifdef __linux__
+        if (pipe2(m_StopPipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+            throw systemError("Could not create the daemon's stop pipe");
+        }
+#endif
+    }
+
+    Server::~Server() {
+#ifdef __linux__
+        for (int fd : { m_Socket, m_Inotify, m_StopPipe[0], m_StopPipe[1] }) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+#endif
+    }
+
+    Modules::ModuleLoader& Server::GetLoader(const std::vector<std::string>& searchRoots, Tokenizer::LexerEngine::Enum engine, Tokenizer::TokenCache* cache) {
+        // Relative paths in modules and diagnostics are relative to the directory of the request
+        std::error_code error;
+        std::string key = fs::current_path(error).string();
+        key += '\0';
+        key += std::to_string(engine);
+        key += '\0';
+        key += std::to_string(reinterpret_cast<uintptr_t>(cache));
+        for (const std::string& root : searchRoots) {
+            key += '\0';
+            key += root;
+        }
+
+        std::unique_ptr<Modules::ModuleLoader>& loader = m_Loaders[key];
+        if (!loader) {
+            loader = std::make_unique<Modules::ModuleLoader>(m_Pool, searchRoots, engine, cache);
+            // Files are watched before they are first read, so an edit made while one loads is still seen
+            loader->SetWatcher([this](const std::string& filepath) { _Watch(fs::path(filepath).parent_path().string()); });
+            for (const std::string& root : searchRoots) {
+                _Watch(fs::weakly_canonical(root, error).string());
+            }
+        }
+        loader->ResetInputs();
+        return *loader;
+    }
+
+    Tokenizer::TokenCache& Server::GetTokenCache(const std::string& directory, u64 maxBytes) {
+        std::error_code error;
+        std::string key = fs::weakly_canonical(directory, error).string();
+        std::unique_ptr<Tokenizer::TokenCache>& cache = m_TokenCaches[error ? directory : key];
+        if (!cache) {
+            cache = std::make_unique<Tokenizer::TokenCache>(directory, maxBytes);
+        }
+        return *cache;
+    }
+
+#ifdef __linux__
+    void Server::Serve(RequestHandler handler) {
+        _Listen();
+
+        m_Inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_Inotify < 0) {
+            throw systemError("Could not watch for file changes");
+        }
+        // Interrupting the daemon stops it between requests so the socket is removed
+        s_SignalFd.store(m_StopPipe[1]);
+        struct sigaction action = {};
+        action.sa_handler = onSignal;
+        sigemptyset(&action.sa_mask);
+        struct sigaction previousInt, previousTerm, previousPipe;
+        sigaction(SIGINT, &action, &previousInt);
+        sigaction(SIGTERM, &action, &previousTerm);
+        // A client that goes away must not take the daemon with it
+        action.sa_handler = SIG_IGN;
+        sigaction(SIGPIPE, &action, &previousPipe);
+
+        LOG_INFO("Listening on " + m_SocketPath);
+        while (true) {
+            pollfd fds[] = {
+                { m_StopPipe[0], POLLIN, 0 },
+                { m_Inotify, POLLIN, 0 },
+                { m_Socket, POLLIN, 0 },
+            };
+            if (poll(fds, 3, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (fds[0].revents) {
+                break;
+            }
+            if (fds[1].revents) {
+                _ReadEvents();
+            }
+            if (fds[2].revents) {
+                int connection = accept4(m_Socket, nullptr, nullptr, SOCK_CLOEXEC);
+                if (connection >= 0) {
+                    _Handle(connection, handler);
+                    close(connection);
+                }
+            }
+        }
+
+        sigaction(SIGINT, &previousInt, nullptr);
+        sigaction(SIGTERM, &previousTerm, nullptr);
+        sigaction(SIGPIPE, &previousPipe, nullptr);
+        s_SignalFd.store(-1);
+        close(m_Socket);
+        m_Socket = -1;
+        unlink(m_SocketPath.c_str());
+        LOG_INFO("Daemon stopped");
+    }
+
+    void Server::Stop() {
+        char byte = 0;
+        if (m_StopPipe[1] >= 0) {
+            (void)!write(m_StopPipe[1], &byte, 1);
+        }
+    }
+
+    void Server::_Listen() {
+        sockaddr_un address = socketAddress(m_SocketPath);
+        m_Socket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_Socket < 0) {
+            throw systemError("Could not create the daemon socket");
+        }
+
+        if (bind(m_Socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            if (errno != EADDRINUSE) {
+                throw systemError("Could not listen on " + m_SocketPath);
+            }
+
+            // A socket file nobody answers on is left over from a daemon that did not stop cleanly
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool live = probe >= 0 && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+            if (probe >= 0) {
+                close(probe);
+            }
+            if (live) {
+                throw std::runtime_error("A daemon is already listening on " + m_SocketPath);
+            }
+            unlink(m_SocketPath.c_str());
+            if (bind(m_Socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+                throw systemError("Could not listen on " + m_SocketPath);
+            }
+        }
+        if (listen(m_Socket, 16) != 0) {
+            throw systemError("Could not listen on " + m_SocketPath);
+        }
+    }
+
+    void Server::_Handle(int connection, const RequestHandler& handler) {
+        u32 size = 0;
+        iovec data = { &size, sizeof(size) };
+        alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))];
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        if (recvmsg(connection, &message, MSG_CMSG_CLOEXEC) != sizeof(size)) {
+            return;
+        }
+
+        int clientFds[2] = { -1, -1 };
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        if (header && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS && header->cmsg_len == CMSG_LEN(2 * sizeof(int))) {
+            std::memcpy(clientFds, CMSG_DATA(header), sizeof(clientFds));
+        }
+
+        std::string payload(size, '\0');
+        if (clientFds[0] < 0 || size > c_MaxRequestSize || !readAll(connection, payload.data(), size) || payload.empty() || payload.back() != '\0') {
+            for (int fd : clientFds) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+            return;
+        }
+
+        // The first string is the working directory, the rest is the command line
+        std::vector<char*> argv;
+        for (size_t begin = 0; begin < payload.size(); begin = payload.find('\0', begin) + 1) {
+            argv.push_back(payload.data() + begin);
+        }
+        const char* directory = argv.front();
+        argv.erase(argv.begin());
+
+        // Files written by the previous request or changed while it ran must not be reused
+        _ReadEvents();
+
+        std::error_code error;
+        fs::path previousDirectory = fs::current_path(error);
+        int previousLevel = K::Log::GetLevel();
+
+        flushOutput();
+        int savedOut = dup(STDOUT_FILENO);
+        int savedErr = dup(STDERR_FILENO);
+        dup2(clientFds[0], STDOUT_FILENO);
+        dup2(clientFds[1], STDERR_FILENO);
+
+        i32 code = 1;
+        if (chdir(directory) != 0) {
+            std::cerr << "Could not change to the directory " << directory << ": " << std::strerror(errno) << std::endl;
+        } else if (!argv.empty()) {
+            K::Flags::reset();
+            try {
+                code = handler(static_cast<int>(argv.size()), argv.data(), *this);
+            } catch (std::exception& e) {
+                LOG_ERROR(e.what());
+            }
+        }
+
+        flushOutput();
+        dup2(savedOut, STDOUT_FILENO);
+        dup2(savedErr, STDERR_FILENO);
+        close(savedOut);
+        close(savedErr);
+        close(clientFds[0]);
+        close(clientFds[1]);
+        K::Log::SetLevel(previousLevel);
+
+        fs::current_path(previousDirectory, error);
+        writeAll(connection, &code, sizeof(code));
+    }
+
+    // Watching the directory rather than the file also sees modules created next to it
+    void Server::_Watch(const std::string& directory) {
+        std::lock_guard<std::mutex> lock(m_WatchMutex);
+        if (m_Inotify < 0 || directory.empty() || m_Watched.count(directory)) {
+            return;
+        }
+        int watch = inotify_add_watch(m_Inotify, directory.c_str(), c_WatchEvents);
+        if (watch >= 0) {
+            m_Watched.insert(directory);
+            m_Watches[watch] = directory;
+        }
+    }
+
+    void Server::_ReadEvents() {
+        alignas(inotify_event) char buffer[16 * 1024];
+        while (true) {
+            ssize_t size = read(m_Inotify, buffer, sizeof(buffer));
+            if (size <= 0) {
+                return;
+            }
+
+            for (ssize_t offset = 0; offset < size; ) {
+                const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                if (event->mask & IN_Q_OVERFLOW) {
+                    // Changes were lost, nothing loaded can be trusted
+                    LOG_WARN("Too many file changes at once, reloading everything");
+                    m_Loaders.clear();
+                    continue;
+                }
+                std::lock_guard<std::mutex> lock(m_WatchMutex);
+                auto watch = m_Watches.find(event->wd);
+                if (watch == m_Watches.end()) {
+                    continue;
+                }
+                if (event->mask & IN_IGNORED) {
+                    m_Watched.erase(watch->second);
+                    m_Watches.erase(watch);
+                    continue;
+                }
+                if (event->len == 0) {
+                    continue;
+                }
+
+                std::string path = (fs::path(watch->second) / event->name).string();
+                bool moved = event->mask & (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO);
+                for (auto& [key, loader] : m_Loaders) {
+                    loader->Invalidate(path);
+                    // A module appearing or disappearing can change what any `use` resolves to
+                    if (moved) {
+                        loader->InvalidateImports();
+                    }
+                }
+            }
+        }
+    }
+
+    int Forward(const std::string& socketPath, const std::vector<std::string>& args) {
+        sockaddr_un address = socketAddress(socketPath);
+        int connection = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (connection < 0) {
+            throw systemError("Could not create a socket");
+        }
+        if (connect(connection, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            close(connection);
+            throw systemError("Could not connect to the daemon at " + socketPath);
+        }
+
+        std::error_code error;
+        std::string payload = fs::current_path(error).string();
+        payload += '\0';
+        for (const std::string& arg : args) {
+            payload += arg;
+            payload += '\0';
+        }
+
+        u32 size = static_cast<u32>(payload.size());
+        iovec data = { &size, sizeof(size) };
+        alignas(cmsghdr) char control[CMSG_SPACE(2 * sizeof(int))] = {};
+        msghdr message = {};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        cmsghdr* header = CMSG_FIRSTHDR(&message);
+        header->cmsg_level = SOL_SOCKET;
+        header->cmsg_type = SCM_RIGHTS;
+        header->cmsg_len = CMSG_LEN(2 * sizeof(int));
+        int fds[2] = { STDOUT_FILENO, STDERR_FILENO };
+        std::memcpy(CMSG_DATA(header), fds, sizeof(fds));
+
+        // Anything this process buffered comes before the output of the request
+        std::cout.flush();
+        fflush(stdout);
+
+        i32 code = 1;
+        bool sent = sendmsg(connection, &message, MSG_NOSIGNAL) == sizeof(size) && writeAll(connection, payload.data(), payload.size());
+        bool answered = sent && readAll(connection, &code, sizeof(code));
+        close(connection);
+        if (!answered) {
+            throw std::runtime_error("The daemon at " + socketPath + " did not finish the request");
+        }
+        return code;
+    }
+#else
+    void Server::Serve(RequestHandler handler) {
+        throw std::runtime_error("The daemon is only supported on Linux");
+    }
+
+    void Server::Stop() {}
+
+    void Server::_Watch(const std::string& directory) {}
+
+    int Forward(const std::string& socketPath, const std::vector<std::string>& args) {
+        throw std::runtime_error("The daemon is only supported on Linux");
+    }
+#endif
+}
@@ -0,0 +1,77 @@
+#include <klib/karena.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace K {
+    Arena::Arena(size_t initialChunkSize, size_t maxChunkSize)
+        : m_InitialChunkSize(initialChunkSize), m_MaxChunkSize(maxChunkSize), m_NextChunkSize(initialChunkSize) {}
+
+    Arena::~Arena() {
+        Reset();
+    }
+
+    Arena::Arena(Arena&& other) noexcept
+        : m_InitialChunkSize(other.m_InitialChunkSize), m_MaxChunkSize(other.m_MaxChunkSize),
+          m_NextChunkSize(std::exchange(other.m_NextChunkSize, other.m_InitialChunkSize)),
+          m_BytesReserved(std::exchange(other.m_BytesReserved, 0)),
+          m_Head(std::exchange(other.m_Head, nullptr)),
+          m_Cursor(std::exchange(other.m_Cursor, nullptr)),
+          m_End(std::exchange(other.m_End, nullptr)) {}
+
+    Arena& Arena::operator=(Arena&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            m_InitialChunkSize = other.m_InitialChunkSize;
+            m_MaxChunkSize = other.m_MaxChunkSize;
+            m_NextChunkSize = std::exchange(other.m_NextChunkSize, other.m_InitialChunkSize);
+            m_BytesReserved = std::exchange(other.m_BytesReserved, 0);
+            m_Head = std::exchange(other.m_Head, nullptr);
+            m_Cursor = std::exchange(other.m_Cursor, nullptr);
+            m_End = std::exchange(other.m_End, nullptr);
+        }
+        return *this;
+    }
+
+    void* Arena::Allocate(size_t size, size_t alignment) {
+        uintptr_t aligned = (reinterpret_cast<uintptr_t>(m_Cursor) + alignment - 1) & ~(alignment - 1);
+        if (m_Cursor == nullptr || aligned + size > reinterpret_cast<uintptr_t>(m_End)) {
+            Grow(size + alignment);
+            aligned = (reinterpret_cast<uintptr_t>(m_Cursor) + alignment - 1) & ~(alignment - 1);
+        }
+
+        m_Cursor = reinterpret_cast<char*>(aligned + size);
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    void Arena::Reset() {
+        while (m_Head) {
+            Chunk* next = m_Head->next;
+            ::operator delete(m_Head);
+            m_Head = next;
+        }
+        m_Cursor = m_End = nullptr;
+        m_NextChunkSize = m_InitialChunkSize;
+        m_BytesReserved = 0;
+    }
+
+    void Arena::Grow(size_t minimumSize) {
+        size_t size = m_NextChunkSize;
+        while (size < minimumSize + sizeof(Chunk)) {
+            size *= 2;
+        }
+        m_NextChunkSize = std::max(m_NextChunkSize, std::min(size * 2, m_MaxChunkSize));
+
+        // Chunks come from the global operator new so allocation accounting sees them
+        Chunk* chunk = static_cast<Chunk*>(::operator new(size));
+        chunk->next = m_Head;
+        chunk->size = size;
+        m_Head = chunk;
+        m_BytesReserved += size;
+
+        m_Cursor = reinterpret_cast<char*>(chunk + 1);
+        m_End = reinterpret_cast<char*>(chunk) + size;
+    }
+}
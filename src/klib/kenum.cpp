@@ -2,13 +2,21 @@
 
 namespace K::Enum {
     std::vector<std::string> SplitEnumString(std::string s) {
+        // The stringized list keeps the spaces after commas and may end in a trailing comma
         std::vector<std::string> result; 
-        size_t start = 0, end;
-        while ((end = s.find(',', start)) != std::string::npos) {
-            result.push_back(s.substr(start, end - start)); 
+        size_t start = 0;
+        while (start <= s.size()) {
+            size_t end = s.find(',', start);
+            if (end == std::string::npos) {
+                end = s.size();
+            }
+            size_t first = s.find_first_not_of(" \t\r\n", start);
+            if (first < end) {
+                size_t last = s.find_last_not_of(" \t\r\n", end - 1);
+                result.push_back(s.substr(first, last - first + 1));
+            }
             start = end + 1;
         }
-        result.push_back(s.substr(start));
         return result; 
     }
-}
\ No newline at end of file
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iostream>
 
 #include <klib/kflags.h>
@@ -87,11 +88,22 @@ namespace K::Flags {
         return true;
     }
 
+    void reset() {
+        s_Initialized = false;
+        s_FileName = "";
+        s_Usage = "";
+        s_FlagDefinitions.resize(RESERVED_FLAG_CNT);
+        s_FlagValues.clear();
+        s_UnqualifiedFlags.clear();
+    }
+
     void printHelp() {
         if (!s_Initialized) {
             std::cerr << "Flags library not initialized, cannot print help message." << std::endl;
         }
 
+        // Messages logged before the help, e.g. why it is shown, come first
+        K::Log::Flush();
         std::cout << "Usage: " << s_FileName << " " << s_Usage << std::endl;
         std::cout << "Flags:" << std::endl;
         for (FlagDefinition flag : s_FlagDefinitions) {
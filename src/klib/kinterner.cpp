@@ -0,0 +1,88 @@
+#include <klib/kinterner.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace K {
+    // Mixes 8 bytes at a time with a splitmix64 finalizer, the high bits pick the shard and the low bits the slot
+    u64 Interner::Hash(std::string_view text) {
+        u64 hash = text.size() * 0x9E3779B97F4A7C15ull;
+        size_t i = 0;
+        for (; i + 8 <= text.size(); i += 8) {
+            u64 word;
+            std::memcpy(&word, text.data() + i, 8);
+            hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+            hash ^= hash >> 31;
+        }
+        if (i < text.size()) {
+            u64 word = 0;
+            std::memcpy(&word, text.data() + i, text.size() - i);
+            hash = (hash ^ word) * 0xBF58476D1CE4E5B9ull;
+        }
+
+        hash = (hash ^ (hash >> 30)) * 0x94D049BB133111EBull;
+        return hash ^ (hash >> 31);
+    }
+
+    u32 Interner::Intern(std::string_view text) {
+        return Intern(text, Hash(text));
+    }
+
+    u32 Interner::Intern(std::string_view text, u64 hash) {
+        u32 shardIndex = static_cast<u32>(hash >> (64 - c_ShardBits));
+        u32 slotHash = static_cast<u32>(hash);
+        Shard& shard = m_Shards[shardIndex];
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.slots.empty()) {
+            shard.slots.resize(64);
+        }
+
+        size_t mask = shard.slots.size() - 1;
+        size_t position = slotHash & mask;
+        for (; shard.slots[position].index != 0; position = (position + 1) & mask) {
+            const Slot& slot = shard.slots[position];
+            if (slot.hash == slotHash && shard.strings[slot.index - 1] == text) {
+                return (slot.index << c_ShardBits) | shardIndex;
+            }
+        }
+
+        char* copy = shard.arena.AllocateArray<char>(text.size());
+        std::copy(text.begin(), text.end(), copy);
+        shard.strings.emplace_back(copy, text.size());
+        u32 index = static_cast<u32>(shard.strings.size());
+        shard.slots[position] = { slotHash, index };
+
+        if (shard.strings.size() * 2 > shard.slots.size()) {
+            std::vector<Slot> slots(shard.slots.size() * 2);
+            mask = slots.size() - 1;
+            for (const Slot& slot : shard.slots) {
+                if (slot.index != 0) {
+                    size_t i = slot.hash & mask;
+                    while (slots[i].index != 0) {
+                        i = (i + 1) & mask;
+                    }
+                    slots[i] = slot;
+                }
+            }
+            shard.slots = std::move(slots);
+        }
+
+        return (index << c_ShardBits) | shardIndex;
+    }
+
+    std::string_view Interner::Lookup(u32 symbol) const {
+        const Shard& shard = m_Shards[symbol & (c_ShardCount - 1)];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.strings[(symbol >> c_ShardBits) - 1];
+    }
+
+    size_t Interner::Size() const {
+        size_t size = 0;
+        for (const Shard& shard : m_Shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            size += shard.strings.size();
+        }
+        return size;
+    }
+}
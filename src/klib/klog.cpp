@@ -0,0 +1,214 @@
+#include <klib/klog.h>
+#include <klib/ktypes.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#define K_LOG_ATFORK 1
+#endif
+
+namespace K::Log {
+    /*
+    *   A bounded multi producer ring in the style of Vyukov's queue. Every slot carries a
+    *   sequence number: a producer claims position p by moving the head from p to p + 1 when
+    *   the slot's sequence is p, fills it and publishes it by setting the sequence to p + 1.
+    *   The single consumer prints slot p once its sequence is p + 1, then hands it back to the
+    *   producers of the next lap by setting it to p + c_RingSize.
+    */
+    constexpr u64 c_RingSize = 4096;
+    constexpr size_t c_BatchSize = 64 * 1024;  // Printed in one write even while messages keep coming
+
+    struct Entry {
+        std::atomic<u64> sequence;
+        int level;
+        const char* file;
+        int line;
+        std::string message;
+    };
+
+    class Logger {
+    public:
+        Logger() {
+            for (u64 i = 0; i < c_RingSize; i++) {
+                m_Entries[i].sequence.store(i, std::memory_order_relaxed);
+            }
+            m_Thread = std::thread(&Logger::_Run, this);
+            m_Thread.detach();
+        }
+
+        void Push(int level, const char* file, int line, std::string message) {
+            u64 position = m_Head.load(std::memory_order_relaxed);
+            Entry* entry;
+            while (true) {
+                entry = &m_Entries[position & (c_RingSize - 1)];
+                i64 lag = static_cast<i64>(entry->sequence.load(std::memory_order_acquire) - position);
+                if (lag == 0) {
+                    if (m_Head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (lag < 0) {
+                    // Full, the consumer is a lap behind
+                    m_Wake.notify_one();
+                    std::this_thread::yield();
+                    position = m_Head.load(std::memory_order_relaxed);
+                } else {
+                    position = m_Head.load(std::memory_order_relaxed);
+                }
+            }
+
+            entry->level = level;
+            entry->file = file;
+            entry->line = line;
+            entry->message = std::move(message);
+            entry->sequence.store(position + 1, std::memory_order_release);
+            m_Wake.notify_one();
+        }
+
+        void Flush() {
+            u64 head = m_Head.load(std::memory_order_acquire);
+            while (m_Tail.load(std::memory_order_acquire) < head) {
+                m_Wake.notify_one();
+                std::this_thread::yield();
+            }
+        }
+
+    private:
+        void _Run() {
+            std::string out;
+            u64 tail = 0;
+            while (true) {
+                Entry& entry = m_Entries[tail & (c_RingSize - 1)];
+                if (entry.sequence.load(std::memory_order_acquire) != tail + 1) {
+                    // Print what has been batched before waiting for more, a producer that
+                    // publishes between the check and the wait is picked up by the timeout
+                    if (!out.empty()) {
+                        std::cout.write(out.data(), out.size());
+                        std::cout.flush();
+                        out.clear();
+                        m_Tail.store(tail, std::memory_order_release);
+                    }
+                    std::unique_lock<std::mutex> lock(m_WakeMutex);
+                    m_Wake.wait_for(lock, std::chrono::milliseconds(10), [&entry, tail]() {
+                        return entry.sequence.load(std::memory_order_acquire) == tail + 1;
+                    });
+                    continue;
+                }
+
+                _Format(out, entry);
+                entry.message.clear();
+                entry.sequence.store(tail + c_RingSize, std::memory_order_release);
+                tail++;
+
+                if (out.size() >= c_BatchSize) {
+                    std::cout.write(out.data(), out.size());
+                    out.clear();
+                }
+            }
+        }
+
+        static void _Format(std::string& out, const Entry& entry) {
+            std::string location = std::string(entry.file) + ":" + std::to_string(entry.line);
+            switch (entry.level) {
+                case DEBUG_LEVEL_ERROR: out += "\033[1;31m [ERROR]"; break;
+                case DEBUG_LEVEL_WARN:  out += "\033[1;33m [WARN]"; break;
+                case DEBUG_LEVEL_INFO:  out += "\033[1;32m [INFO]"; break;
+                case DEBUG_LEVEL_DEBUG: out += "\033[1;34m [DEBUG]" + location; break;
+                case DEBUG_LEVEL_TRACE: out += "\033[1;37m" + location + " [TRACE]"; break;
+                default: break;
+            }
+            out += " ";
+            out += entry.message;
+            out += "\n\033[0m";
+        }
+
+        Entry m_Entries[c_RingSize];
+        alignas(64) std::atomic<u64> m_Head = 0;   // The next position producers claim
+        alignas(64) std::atomic<u64> m_Tail = 0;   // Every position before this has been printed
+
+        std::mutex m_WakeMutex;
+        std::condition_variable m_Wake;
+        std::thread m_Thread;
+    };
+
+    /*
+    *   The logger is created by the first message and never destroyed, so messages logged
+    *   from static destructors still work. Pending messages are flushed at exit and before
+    *   fork, a forked child starts its own logger since it has no copy of the thread.
+    */
+    std::atomic<Logger*> s_Logger = nullptr;
+    std::mutex s_LoggerMutex;
+
+    void _FlushAtExit() {
+        Flush();
+    }
+
+#ifdef K_LOG_ATFORK
+    void _BeforeFork() {
+        Flush();
+        s_LoggerMutex.lock();
+    }
+
+    void _AfterForkParent() {
+        s_LoggerMutex.unlock();
+    }
+
+    void _AfterForkChild() {
+        s_Logger.store(nullptr, std::memory_order_release);
+        s_LoggerMutex.unlock();
+    }
+#endif
+
+    Logger& _GetLogger() {
+        Logger* logger = s_Logger.load(std::memory_order_acquire);
+        if (logger) {
+            return *logger;
+        }
+
+        std::lock_guard<std::mutex> lock(s_LoggerMutex);
+        logger = s_Logger.load(std::memory_order_relaxed);
+        if (!logger) {
+            static bool s_HooksInstalled = false;
+            if (!s_HooksInstalled) {
+                std::atexit(_FlushAtExit);
+#ifdef K_LOG_ATFORK
+                pthread_atfork(_BeforeFork, _AfterForkParent, _AfterForkChild);
+#endif
+                s_HooksInstalled = true;
+            }
+            logger = new Logger();
+            s_Logger.store(logger, std::memory_order_release);
+        }
+        return *logger;
+    }
+
+    bool ParseLevel(std::string_view name, int& level) {
+        static const std::pair<std::string_view, int> s_Levels[] = {
+            { "none", DEBUG_LEVEL_NONE }, { "error", DEBUG_LEVEL_ERROR }, { "warn", DEBUG_LEVEL_WARN },
+            { "info", DEBUG_LEVEL_INFO }, { "debug", DEBUG_LEVEL_DEBUG }, { "trace", DEBUG_LEVEL_TRACE },
+        };
+        for (const auto& [levelName, value] : s_Levels) {
+            if (levelName == name) {
+                level = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Push(int level, const char* file, int line, std::string message) {
+        _GetLogger().Push(level, file, line, std::move(message));
+    }
+
+    void Flush() {
+        Logger* logger = s_Logger.load(std::memory_order_acquire);
+        if (logger) {
+            logger->Flush();
+        }
+    }
+}
@@ -0,0 +1,496 @@
+#include <klib/kscan.h>
+
+#include <atomic>
+#include <bitset>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define K_SCAN_SSE2 1
+#endif
+
+// AVX2 is compiled per function with a target attribute and only used when the CPU reports it
+#if defined(K_SCAN_SSE2) && defined(__GNUC__)
+#include <immintrin.h>
+#define K_SCAN_AVX2 1
+#define K_SCAN_AVX2_FN __attribute__((target("avx2")))
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define K_SCAN_NEON 1
+#endif
+
+namespace K::Scan {
+    inline u32 _CountTrailingZeros(u64 mask) {
+#ifdef __GNUC__
+        return __builtin_ctzll(mask);
+#else
+        u32 count = 0;
+        while (!(mask & 1)) {
+            mask >>= 1;
+            count++;
+        }
+        return count;
+#endif
+    }
+
+    inline u32 _PopCount(u64 mask) {
+#ifdef __GNUC__
+        return __builtin_popcountll(mask);
+#else
+        return static_cast<u32>(std::bitset<64>(mask).count());
+#endif
+    }
+
+    /*
+    *   Scalar implementations. They also finish the tail of every vectorized scan, so each
+    *   takes the index to start from.
+    */
+    inline bool _IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+    inline bool _IsIdentChar(char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    size_t _SkipBlanksScalar(const char* s, size_t size, size_t i = 0) {
+        while (i < size && _IsBlank(s[i])) {
+            i++;
+        }
+        return i;
+    }
+
+    size_t _SkipIdentCharsScalar(const char* s, size_t size, size_t i = 0) {
+        while (i < size && _IsIdentChar(s[i])) {
+            i++;
+        }
+        return i;
+    }
+
+    size_t _FindLineEndScalar(const char* s, size_t size, size_t i = 0) {
+        while (i < size && s[i] != '\n' && s[i] != '\r') {
+            i++;
+        }
+        return i;
+    }
+
+    size_t _FindBlockCommentEndScalar(const char* s, size_t size, size_t i = 0) {
+        for (; i + 1 < size; i++) {
+            if (s[i] == '*' && s[i + 1] == '/') {
+                return i;
+            }
+        }
+        return size;
+    }
+
+    size_t _CountNewlinesScalar(const char* s, size_t size, size_t i = 0) {
+        size_t count = 0;
+        for (; i < size; i++) {
+            count += s[i] == '\n';
+        }
+        return count;
+    }
+
+    size_t _FindNewlinesScalar(const char* s, size_t size, u32* positions, size_t i = 0) {
+        size_t count = 0;
+        for (; i < size; i++) {
+            if (s[i] == '\n') {
+                positions[count++] = static_cast<u32>(i);
+            }
+        }
+        return count;
+    }
+
+#ifdef K_SCAN_SSE2
+    /*
+    *   SSE2 only has signed byte compares, so a byte range [lo, hi] is checked by shifting it
+    *   down to start at -128 and comparing against -128 + the width of the range.
+    */
+    inline __m128i _InRangeSSE2(__m128i v, char lo, char hi) {
+        return _mm_cmplt_epi8(
+            _mm_add_epi8(v, _mm_set1_epi8(static_cast<char>(128 - lo))),
+            _mm_set1_epi8(static_cast<char>(-128 + (hi - lo + 1)))
+        );
+    }
+
+    inline u32 _BlankMaskSSE2(__m128i v) {
+        __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+        __m128i control = _mm_andnot_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _InRangeSSE2(v, '\t', '\r'));
+        return _mm_movemask_epi8(_mm_or_si128(space, control));
+    }
+
+    inline u32 _IdentMaskSSE2(__m128i v) {
+        __m128i letter = _InRangeSSE2(_mm_or_si128(v, _mm_set1_epi8(0x20)), 'a', 'z');
+        __m128i digit = _InRangeSSE2(v, '0', '9');
+        __m128i underscore = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+        return _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(letter, digit), underscore));
+    }
+
+    size_t _SkipBlanksSSE2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            u32 rest = ~_BlankMaskSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i))) & 0xFFFF;
+            if (rest) {
+                return i + _CountTrailingZeros(rest);
+            }
+        }
+        return _SkipBlanksScalar(s, size, i);
+    }
+
+    size_t _SkipIdentCharsSSE2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            u32 rest = ~_IdentMaskSSE2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i))) & 0xFFFF;
+            if (rest) {
+                return i + _CountTrailingZeros(rest);
+            }
+        }
+        return _SkipIdentCharsScalar(s, size, i);
+    }
+
+    size_t _FindLineEndSSE2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            u32 found = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(v, _mm_set1_epi8('\r'))));
+            if (found) {
+                return i + _CountTrailingZeros(found);
+            }
+        }
+        return _FindLineEndScalar(s, size, i);
+    }
+
+    size_t _FindBlockCommentEndSSE2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 17 <= size; i += 16) {
+            __m128i star = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)), _mm_set1_epi8('*'));
+            __m128i slash = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 1)), _mm_set1_epi8('/'));
+            u32 found = _mm_movemask_epi8(_mm_and_si128(star, slash));
+            if (found) {
+                return i + _CountTrailingZeros(found);
+            }
+        }
+        return _FindBlockCommentEndScalar(s, size, i);
+    }
+
+    size_t _CountNewlinesSSE2(const char* s, size_t size) {
+        size_t i = 0, count = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            count += _PopCount(_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))));
+        }
+        return count + _CountNewlinesScalar(s, size, i);
+    }
+
+    size_t _FindNewlinesSSE2(const char* s, size_t size, u32* positions) {
+        size_t i = 0, count = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+            for (u32 found = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n'))); found; found &= found - 1) {
+                positions[count++] = static_cast<u32>(i + _CountTrailingZeros(found));
+            }
+        }
+        return count + _FindNewlinesScalar(s, size, positions + count, i);
+    }
+#endif
+
+#ifdef K_SCAN_AVX2
+    K_SCAN_AVX2_FN inline __m256i _InRangeAVX2(__m256i v, char lo, char hi) {
+        return _mm256_cmpgt_epi8(
+            _mm256_set1_epi8(static_cast<char>(-128 + (hi - lo + 1))),
+            _mm256_add_epi8(v, _mm256_set1_epi8(static_cast<char>(128 - lo)))
+        );
+    }
+
+    K_SCAN_AVX2_FN inline u32 _BlankMaskAVX2(__m256i v) {
+        __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+        __m256i control = _mm256_andnot_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _InRangeAVX2(v, '\t', '\r'));
+        return _mm256_movemask_epi8(_mm256_or_si256(space, control));
+    }
+
+    K_SCAN_AVX2_FN inline u32 _IdentMaskAVX2(__m256i v) {
+        __m256i letter = _InRangeAVX2(_mm256_or_si256(v, _mm256_set1_epi8(0x20)), 'a', 'z');
+        __m256i digit = _InRangeAVX2(v, '0', '9');
+        __m256i underscore = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        return _mm256_movemask_epi8(_mm256_or_si256(_mm256_or_si256(letter, digit), underscore));
+    }
+
+    K_SCAN_AVX2_FN size_t _SkipBlanksAVX2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            u32 rest = ~_BlankMaskAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)));
+            if (rest) {
+                return i + _CountTrailingZeros(rest);
+            }
+        }
+        return _SkipBlanksScalar(s, size, i);
+    }
+
+    K_SCAN_AVX2_FN size_t _SkipIdentCharsAVX2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            u32 rest = ~_IdentMaskAVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)));
+            if (rest) {
+                return i + _CountTrailingZeros(rest);
+            }
+        }
+        return _SkipIdentCharsScalar(s, size, i);
+    }
+
+    K_SCAN_AVX2_FN size_t _FindLineEndAVX2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            u32 found = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r'))));
+            if (found) {
+                return i + _CountTrailingZeros(found);
+            }
+        }
+        return _FindLineEndScalar(s, size, i);
+    }
+
+    K_SCAN_AVX2_FN size_t _FindBlockCommentEndAVX2(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 33 <= size; i += 32) {
+            __m256i star = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i)), _mm256_set1_epi8('*'));
+            __m256i slash = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + 1)), _mm256_set1_epi8('/'));
+            u32 found = _mm256_movemask_epi8(_mm256_and_si256(star, slash));
+            if (found) {
+                return i + _CountTrailingZeros(found);
+            }
+        }
+        return _FindBlockCommentEndScalar(s, size, i);
+    }
+
+    K_SCAN_AVX2_FN size_t _CountNewlinesAVX2(const char* s, size_t size) {
+        size_t i = 0, count = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            count += _PopCount(static_cast<u32>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')))));
+        }
+        return count + _CountNewlinesScalar(s, size, i);
+    }
+
+    K_SCAN_AVX2_FN size_t _FindNewlinesAVX2(const char* s, size_t size, u32* positions) {
+        size_t i = 0, count = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i));
+            for (u32 found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n'))); found; found &= found - 1) {
+                positions[count++] = static_cast<u32>(i + _CountTrailingZeros(found));
+            }
+        }
+        return count + _FindNewlinesScalar(s, size, positions + count, i);
+    }
+#endif
+
+#ifdef K_SCAN_NEON
+    /*
+    *   NEON has no movemask, narrowing the compare result by 4 bits per lane packs it into
+    *   a 64-bit mask with one nibble per byte instead.
+    */
+    inline u64 _MaskNEON(uint8x16_t matches) {
+        return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+    }
+
+    inline uint8x16_t _InRangeNEON(uint8x16_t v, u8 lo, u8 hi) {
+        return vcleq_u8(vsubq_u8(v, vdupq_n_u8(lo)), vdupq_n_u8(hi - lo));
+    }
+
+    inline uint8x16_t _BlankMatchNEON(uint8x16_t v) {
+        uint8x16_t space = vceqq_u8(v, vdupq_n_u8(' '));
+        uint8x16_t control = vbicq_u8(_InRangeNEON(v, '\t', '\r'), vceqq_u8(v, vdupq_n_u8('\n')));
+        return vorrq_u8(space, control);
+    }
+
+    inline uint8x16_t _IdentMatchNEON(uint8x16_t v) {
+        uint8x16_t letter = _InRangeNEON(vorrq_u8(v, vdupq_n_u8(0x20)), 'a', 'z');
+        uint8x16_t digit = _InRangeNEON(v, '0', '9');
+        uint8x16_t underscore = vceqq_u8(v, vdupq_n_u8('_'));
+        return vorrq_u8(vorrq_u8(letter, digit), underscore);
+    }
+
+    inline const uint8_t* _Bytes(const char* s) {
+        return reinterpret_cast<const uint8_t*>(s);
+    }
+
+    size_t _SkipBlanksNEON(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            u64 rest = ~_MaskNEON(_BlankMatchNEON(vld1q_u8(_Bytes(s + i))));
+            if (rest) {
+                return i + _CountTrailingZeros(rest) / 4;
+            }
+        }
+        return _SkipBlanksScalar(s, size, i);
+    }
+
+    size_t _SkipIdentCharsNEON(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            u64 rest = ~_MaskNEON(_IdentMatchNEON(vld1q_u8(_Bytes(s + i))));
+            if (rest) {
+                return i + _CountTrailingZeros(rest) / 4;
+            }
+        }
+        return _SkipIdentCharsScalar(s, size, i);
+    }
+
+    size_t _FindLineEndNEON(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            uint8x16_t v = vld1q_u8(_Bytes(s + i));
+            u64 found = _MaskNEON(vorrq_u8(vceqq_u8(v, vdupq_n_u8('\n')), vceqq_u8(v, vdupq_n_u8('\r'))));
+            if (found) {
+                return i + _CountTrailingZeros(found) / 4;
+            }
+        }
+        return _FindLineEndScalar(s, size, i);
+    }
+
+    size_t _FindBlockCommentEndNEON(const char* s, size_t size) {
+        size_t i = 0;
+        for (; i + 17 <= size; i += 16) {
+            uint8x16_t star = vceqq_u8(vld1q_u8(_Bytes(s + i)), vdupq_n_u8('*'));
+            uint8x16_t slash = vceqq_u8(vld1q_u8(_Bytes(s + i + 1)), vdupq_n_u8('/'));
+            u64 found = _MaskNEON(vandq_u8(star, slash));
+            if (found) {
+                return i + _CountTrailingZeros(found) / 4;
+            }
+        }
+        return _FindBlockCommentEndScalar(s, size, i);
+    }
+
+    size_t _CountNewlinesNEON(const char* s, size_t size) {
+        size_t i = 0, count = 0;
+        for (; i + 16 <= size; i += 16) {
+            uint8x16_t newlines = vandq_u8(vceqq_u8(vld1q_u8(_Bytes(s + i)), vdupq_n_u8('\n')), vdupq_n_u8(1));
+            count += vaddvq_u8(newlines);
+        }
+        return count + _CountNewlinesScalar(s, size, i);
+    }
+
+    size_t _FindNewlinesNEON(const char* s, size_t size, u32* positions) {
+        size_t i = 0, count = 0;
+        for (; i + 16 <= size; i += 16) {
+            u64 found = _MaskNEON(vceqq_u8(vld1q_u8(_Bytes(s + i)), vdupq_n_u8('\n')));
+            while (found) {
+                u32 bit = _CountTrailingZeros(found);
+                positions[count++] = static_cast<u32>(i + bit / 4);
+                found &= ~(u64(0xF) << bit);
+            }
+        }
+        return count + _FindNewlinesScalar(s, size, positions + count, i);
+    }
+#endif
+
+    struct Scanners {
+        Level::Enum level;
+        size_t (*skipBlanks)(const char*, size_t);
+        size_t (*skipIdentChars)(const char*, size_t);
+        size_t (*findLineEnd)(const char*, size_t);
+        size_t (*findBlockCommentEnd)(const char*, size_t);
+        size_t (*countNewlines)(const char*, size_t);
+        size_t (*findNewlines)(const char*, size_t, u32*);
+    };
+
+    size_t _SkipBlanksScalarEntry(const char* s, size_t size) { return _SkipBlanksScalar(s, size); }
+    size_t _SkipIdentCharsScalarEntry(const char* s, size_t size) { return _SkipIdentCharsScalar(s, size); }
+    size_t _FindLineEndScalarEntry(const char* s, size_t size) { return _FindLineEndScalar(s, size); }
+    size_t _FindBlockCommentEndScalarEntry(const char* s, size_t size) { return _FindBlockCommentEndScalar(s, size); }
+    size_t _CountNewlinesScalarEntry(const char* s, size_t size) { return _CountNewlinesScalar(s, size); }
+    size_t _FindNewlinesScalarEntry(const char* s, size_t size, u32* positions) { return _FindNewlinesScalar(s, size, positions); }
+
+    const Scanners s_ScalarScanners = {
+        Level::SCALAR, _SkipBlanksScalarEntry, _SkipIdentCharsScalarEntry,
+        _FindLineEndScalarEntry, _FindBlockCommentEndScalarEntry, _CountNewlinesScalarEntry, _FindNewlinesScalarEntry
+    };
+#ifdef K_SCAN_SSE2
+    const Scanners s_SSE2Scanners = {
+        Level::SSE2, _SkipBlanksSSE2, _SkipIdentCharsSSE2,
+        _FindLineEndSSE2, _FindBlockCommentEndSSE2, _CountNewlinesSSE2, _FindNewlinesSSE2
+    };
+#endif
+#ifdef K_SCAN_AVX2
+    const Scanners s_AVX2Scanners = {
+        Level::AVX2, _SkipBlanksAVX2, _SkipIdentCharsAVX2,
+        _FindLineEndAVX2, _FindBlockCommentEndAVX2, _CountNewlinesAVX2, _FindNewlinesAVX2
+    };
+#endif
+#ifdef K_SCAN_NEON
+    const Scanners s_NEONScanners = {
+        Level::NEON, _SkipBlanksNEON, _SkipIdentCharsNEON,
+        _FindLineEndNEON, _FindBlockCommentEndNEON, _CountNewlinesNEON, _FindNewlinesNEON
+    };
+#endif
+
+    std::atomic<const Scanners*> s_ActiveScanners { nullptr };
+
+    const Scanners* _GetScanners(Level::Enum level) {
+        switch (level) {
+#ifdef K_SCAN_SSE2
+            case Level::SSE2: return &s_SSE2Scanners;
+#endif
+#ifdef K_SCAN_AVX2
+            case Level::AVX2: return __builtin_cpu_supports("avx2") ? &s_AVX2Scanners : nullptr;
+#endif
+#ifdef K_SCAN_NEON
+            case Level::NEON: return &s_NEONScanners;
+#endif
+            case Level::SCALAR: return &s_ScalarScanners;
+            default: return nullptr;
+        }
+    }
+
+    // Picked on first use, racing threads all land on the same table
+    inline const Scanners& _Active() {
+        const Scanners* scanners = s_ActiveScanners.load(std::memory_order_acquire);
+        if (scanners == nullptr) {
+            for (Level::Enum level : { Level::AVX2, Level::NEON, Level::SSE2, Level::SCALAR }) {
+                if ((scanners = _GetScanners(level))) {
+                    break;
+                }
+            }
+            s_ActiveScanners.store(scanners, std::memory_order_release);
+        }
+        return *scanners;
+    }
+
+    Level::Enum GetLevel() {
+        return _Active().level;
+    }
+
+    bool IsSupported(Level::Enum level) {
+        return _GetScanners(level) != nullptr;
+    }
+
+    bool SetLevel(Level::Enum level) {
+        const Scanners* scanners = _GetScanners(level);
+        if (scanners == nullptr) {
+            return false;
+        }
+        s_ActiveScanners.store(scanners, std::memory_order_release);
+        return true;
+    }
+
+    size_t SkipBlanks(const char* s, size_t size) {
+        return _Active().skipBlanks(s, size);
+    }
+
+    size_t SkipIdentChars(const char* s, size_t size) {
+        return _Active().skipIdentChars(s, size);
+    }
+
+    size_t FindLineEnd(const char* s, size_t size) {
+        return _Active().findLineEnd(s, size);
+    }
+
+    size_t FindBlockCommentEnd(const char* s, size_t size) {
+        return _Active().findBlockCommentEnd(s, size);
+    }
+
+    size_t CountNewlines(const char* s, size_t size) {
+        return _Active().countNewlines(s, size);
+    }
+
+    size_t FindNewlines(const char* s, size_t size, u32* positions) {
+        return _Active().findNewlines(s, size, positions);
+    }
+}
@@ -0,0 +1,168 @@
+#include <klib/kthreadpool.h>
+
+#include <algorithm>
+#include <utility>
+
+namespace K {
+    // The pool and queue index of the worker running on this thread, if any
+    thread_local ThreadPool* s_CurrentPool = nullptr;
+    thread_local size_t s_CurrentWorker = 0;
+
+    ThreadPool::ThreadPool(size_t threadCount) {
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        for (size_t i = 0; i < threadCount; i++) {
+            m_Queues.push_back(std::make_unique<WorkerQueue>());
+        }
+        for (size_t i = 0; i < threadCount; i++) {
+            m_Threads.emplace_back(&ThreadPool::_WorkerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Stopping = true;
+        }
+        m_WorkAvailable.notify_all();
+        for (auto& thread : m_Threads) {
+            thread.join();
+        }
+    }
+
+    void ThreadPool::Submit(Task task) {
+        size_t index = (s_CurrentPool == this) 
+            ? s_CurrentWorker 
+            : m_NextQueue.fetch_add(1, std::memory_order_relaxed) % m_Queues.size();
+
+        m_Pending.fetch_add(1);
+        {
+            // Taking the sleep lock orders this against a worker checking m_Queued before it sleeps. 
+            // m_Queued is raised before the push so a thief can never take it below zero.
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Queued.fetch_add(1);
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_Queues[index]->mutex);
+            m_Queues[index]->tasks.push_back(std::move(task));
+        }
+        m_WorkAvailable.notify_one();
+    }
+
+    void ThreadPool::Wait() {
+        while (m_Pending.load() > 0) {
+            if (_TryRunOne(m_NextQueue.load(std::memory_order_relaxed) % m_Queues.size())) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_AllDone.wait(lock, [this]() { return m_Pending.load() == 0 || m_Queued.load() > 0; });
+        }
+
+        std::lock_guard<std::mutex> lock(m_ErrorMutex);
+        if (m_FirstError) {
+            std::rethrow_exception(std::exchange(m_FirstError, nullptr));
+        }
+    }
+
+    void ThreadPool::RunBatch(std::vector<Task> tasks) {
+        std::atomic<size_t> remaining = tasks.size();
+        std::mutex errorMutex;
+        std::exception_ptr firstError;
+
+        for (Task& task : tasks) {
+            Submit([&, task = std::move(task)]() {
+                try {
+                    task();
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (!firstError) {
+                        firstError = std::current_exception();
+                    }
+                }
+                if (remaining.fetch_sub(1) == 1) {
+                    // The caller may be asleep below, nothing on this frame is touched after this
+                    std::lock_guard<std::mutex> lock(m_SleepMutex);
+                    m_WorkAvailable.notify_all();
+                }
+            });
+        }
+
+        // Sleeps like an idle worker, but also wakes when the batch is done. New work still wakes
+        // it, since the batch may be waiting on tasks that only this thread is free to run.
+        size_t index = (s_CurrentPool == this) ? s_CurrentWorker : 0;
+        while (remaining.load() > 0) {
+            if (_TryRunOne(index)) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_WorkAvailable.wait(lock, [&]() { return remaining.load() == 0 || m_Queued.load() > 0; });
+        }
+
+        if (firstError) {
+            std::rethrow_exception(firstError);
+        }
+    }
+
+    bool ThreadPool::_TryRunOne(size_t index) {
+        Task task;
+        {
+            // Own work first, newest task first while it is still hot in cache
+            std::lock_guard<std::mutex> lock(m_Queues[index]->mutex);
+            if (!m_Queues[index]->tasks.empty()) {
+                task = std::move(m_Queues[index]->tasks.back());
+                m_Queues[index]->tasks.pop_back();
+            }
+        }
+
+        for (size_t i = 1; !task && i < m_Queues.size(); i++) {
+            // Steal the oldest task from the next worker that has one
+            WorkerQueue& victim = *m_Queues[(index + i) % m_Queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+            }
+        }
+
+        if (!task) {
+            return false;
+        }
+        m_Queued.fetch_sub(1);
+
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(m_ErrorMutex);
+            if (!m_FirstError) {
+                m_FirstError = std::current_exception();
+            }
+        }
+
+        if (m_Pending.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_AllDone.notify_all();
+        }
+        return true;
+    }
+
+    void ThreadPool::_WorkerLoop(size_t index) {
+        s_CurrentPool = this;
+        s_CurrentWorker = index;
+
+        while (true) {
+            if (_TryRunOne(index)) {
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_WorkAvailable.wait(lock, [this]() { return m_Stopping.load() || m_Queued.load() > 0; });
+            if (m_Stopping.load() && m_Queued.load() == 0) {
+                return;
+            }
+        }
+    }
+}
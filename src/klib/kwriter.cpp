@@ -0,0 +1,139 @@
+#include <klib/kwriter.h>
+
+namespace K {
+    Writer::Writer(size_t bufferSize) : m_Buffer(bufferSize) {}
+
+    Writer::~Writer() {
+        Close();
+    }
+
+    bool Writer::Open(const std::string& filepath, bool background) {
+        Close();
+        m_File = fopen(filepath.c_str(), "wb");
+        if (!m_File) {
+            return false;
+        }
+        // Writes are already batched, stdio's own buffer would only add a copy
+        setvbuf(m_File, nullptr, _IONBF, 0);
+        m_OwnsFile = true;
+        _Start(background);
+        return true;
+    }
+
+    void Writer::OpenStdout(bool background) {
+        Close();
+        m_File = stdout;
+        m_OwnsFile = false;
+        _Start(background);
+    }
+
+    void Writer::_Start(bool background) {
+        m_Failed = false;
+        m_Background = background;
+        if (m_Background) {
+            m_Pending.resize(m_Buffer.size());
+            m_Stopping = false;
+            m_Thread = std::thread(&Writer::_Run, this);
+        }
+    }
+
+    bool Writer::Close() {
+        if (!m_File) {
+            return true;
+        }
+
+        Flush();
+        if (m_Background) {
+            {
+                std::lock_guard<std::mutex> lock(m_Mutex);
+                m_Stopping = true;
+            }
+            m_Condition.notify_all();
+            m_Thread.join();
+            m_Background = false;
+        }
+
+        if (m_OwnsFile && fclose(m_File) != 0) {
+            m_Failed = true;
+        }
+        m_File = nullptr;
+        return !m_Failed;
+    }
+
+    void Writer::Flush() {
+        _Drain();
+        _WaitIdle();
+        if (m_File && fflush(m_File) != 0) {
+            m_Failed = true;
+        }
+    }
+
+    void Writer::WriteCsvField(std::string_view field) {
+        Write('"');
+        for (size_t quote = field.find('"'); quote != std::string_view::npos; quote = field.find('"')) {
+            Write(field.substr(0, quote + 1));
+            Write('"');
+            field.remove_prefix(quote + 1);
+        }
+        Write(field);
+        Write('"');
+    }
+
+    void Writer::_Drain() {
+        if (m_Size == 0) {
+            return;
+        }
+
+        if (!m_Background) {
+            _Output(m_Buffer.data(), m_Size);
+            m_Size = 0;
+            return;
+        }
+
+        // Wait for the previous buffer to be written, then swap so formatting continues in it
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_PendingSize == 0; });
+            std::swap(m_Buffer, m_Pending);
+            m_PendingSize = m_Size;
+        }
+        m_Condition.notify_all();
+        m_Size = 0;
+    }
+
+    void Writer::_WaitIdle() {
+        if (m_Background) {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Condition.wait(lock, [this]() { return m_PendingSize == 0; });
+        }
+    }
+
+    void Writer::_WriteDirect(std::string_view text) {
+        // Text larger than the buffer skips it, after everything before it has been written
+        _WaitIdle();
+        _Output(text.data(), text.size());
+    }
+
+    void Writer::_Output(const char* data, size_t size) {
+        if (!m_File || fwrite(data, 1, size, m_File) != size) {
+            m_Failed = true;
+        }
+    }
+
+    void Writer::_Run() {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        while (true) {
+            m_Condition.wait(lock, [this]() { return m_PendingSize != 0 || m_Stopping; });
+            if (m_PendingSize == 0) {
+                return;
+            }
+
+            size_t size = m_PendingSize;
+            lock.unlock();
+            _Output(m_Pending.data(), size);
+            lock.lock();
+            m_PendingSize = 0;
+            m_Condition.notify_all();
+        }
+    }
+}
@@ -1,30 +1,161 @@
 #include <tokenizer.h>
+#include <tokencache.h>
+#include <tokendump.h>
+#include <parser.h>
+#include <modules.h>
+#include <daemon.h>
 
-#define DEBUG_LEVEL DEBUG_LEVEL_TRACE
 #include <log.h>
 #include <flags.h>
 #include <klib/kflags.h>
+#include <klib/kthreadpool.h>
+#include <klib/kwriter.h>
 
+#include <algorithm>
 #include <exception>
 #include <iostream>
-#include <fstream>
+#include <memory>
 
 using namespace JR;
 
-int main(int argc, char *argv[]) {
+// Report diagnostics in module order so the output never depends on scheduling
+bool reportErrors(const std::vector<Modules::Module*>& modules) {
+    bool failed = false;
+    for (Modules::Module* module : modules) {
+        for (const std::string& error : module->errors) {
+            LOG_ERROR(error);
+            failed = true;
+        }
+    }
+    return failed;
+}
+
+// One row per token, formatted straight into the writer's buffer
+void writeTokensCsv(K::Writer& out, const Modules::Module& module, bool withFilepath) {
+    const Tokenizer::TokenStream& tokens = module.lexer.GetTokenStream();
+    size_t line = 0;
+    for (u32 i = 0; i < tokens.Size(); i++) {
+        const Tokenizer::Token& token = tokens[i];
+        if (withFilepath) {
+            out.WriteCsvField(module.filepath);
+            out.Write(',');
+        }
+        out.Write(Tokenizer::TokenTypeName(token.type));
+        out.Write(',');
+        out.WriteCsvField(tokens.Content(i));
+        out.Write(',');
+        SourcePosition position = tokens.Position(i, line);
+        out.WriteNumber(position.line);
+        out.Write(',');
+        out.WriteNumber(position.column);
+        out.Write('\n');
+    }
+}
+
+// The same text as TokenRef::ToString, without building temporary strings per token
+void writeTokensConsole(K::Writer& out, const Modules::Module& module) {
+    const Tokenizer::TokenStream& tokens = module.lexer.GetTokenStream();
+    size_t line = 0;
+    for (u32 i = 0; i < tokens.Size(); i++) {
+        const Tokenizer::Token& token = tokens[i];
+        out.Write("Token(\"");
+        out.Write(tokens.Content(i));
+        out.Write("\", ");
+        out.Write(Tokenizer::TokenTypeName(token.type));
+        out.Write(", ");
+        SourcePosition position = tokens.Position(i, line);
+        out.WriteNumber(position.line);
+        out.Write(", ");
+        out.WriteNumber(position.column);
+        out.Write(")\n");
+    }
+}
+
+// The command line without `--connect <socket>`, to run in the daemon
+std::vector<std::string> forwardedArgs(int argc, char *argv[]) {
+    std::vector<std::string> identifiers;
+    for (const K::Flags::FlagDefinition& flag : s_FlagDefinitions) {
+        if (flag.identity == Flags::CONNECT) {
+            identifiers = flag.identifiers;
+        }
+    }
+
+    std::vector<std::string> args;
+    for (int i = 0; i < argc; i++) {
+        if (std::find(identifiers.begin(), identifiers.end(), argv[i]) != identifiers.end()) {
+            i++;
+            continue;
+        }
+        args.push_back(argv[i]);
+    }
+    return args;
+}
+
+// Run one command line, either on its own or as a request to the daemon `server`, reusing its loaded modules
+int compile(int argc, char *argv[], Daemon::Server* server) {
     if (!K::Flags::init(
         argc, argv,
-        "<flags> <input.jr>",
+        "<flags> <input.jr> [<input.jr> ...]",
         s_FlagDefinitions)
     ) {
         return 1;
     }
 
+    K::Flags::FlagData connectFlag = K::Flags::getFlag(Flags::CONNECT);
+    K::Flags::FlagData daemonFlag = K::Flags::getFlag(Flags::DAEMON);
+    if (server && (connectFlag.present || daemonFlag.present)) {
+        LOG_ERROR("A daemon cannot start or forward to another daemon");
+        return 1;
+    }
+    if (connectFlag.present) {
+        try {
+            return Daemon::Forward(connectFlag.value, forwardedArgs(argc, argv));
+        } catch (std::exception& e) {
+            LOG_ERROR(e.what());
+            return 1;
+        }
+    }
+
+    K::Flags::FlagData logLevelFlag = K::Flags::getFlag(Flags::LOG_LEVEL);
+    if (logLevelFlag.present) {
+        int level;
+        if (!K::Log::ParseLevel(logLevelFlag.value, level)) {
+            LOG_ERROR("Invalid log level: " + logLevelFlag.value);
+            return 1;
+        }
+        K::Log::SetLevel(level);
+    }
+
     if (K::Flags::getFlag(Flags::VERSION).present) {
         std::cout << "JR Version 0.0.1" << std::endl;
         return 0;
     }
 
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    K::Flags::FlagData jobsFlag = K::Flags::getFlag(Flags::JOBS);
+    if (jobsFlag.present) {
+        try {
+            jobs = std::stoul(jobsFlag.value);
+        } catch (std::exception& e) {
+            jobs = 0;
+        }
+        if (jobs == 0) {
+            LOG_ERROR("Invalid job count: " + jobsFlag.value);
+            return 1;
+        }
+    }
+
+    if (daemonFlag.present) {
+        try {
+            Daemon::Server daemon(daemonFlag.value, jobs);
+            daemon.Serve([](int argc, char *argv[], Daemon::Server& server) { return compile(argc, argv, &server); });
+        } catch (std::exception& e) {
+            LOG_ERROR(e.what());
+            return 1;
+        }
+        return 0;
+    }
+
     std::vector<std::string> inputFiles = K::Flags::getUnqualifiedFlags();
     if (inputFiles.size() == 0) {
         LOG_ERROR("No input file provided");
@@ -32,54 +163,161 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    try {
-        LOG_TRACE("Initializing tokenizer\n");
-        Tokenizer::Init(inputFiles[0]);
-    } catch (std::exception &e) {
-        LOG_ERROR(e.what());
-        return 1;
+    Tokenizer::LexerEngine::Enum engine = K::Flags::getFlag(Flags::TOKENIZER_REGEX_ENGINE).present
+        ? Tokenizer::LexerEngine::REGEX
+        : Tokenizer::LexerEngine::DFA;
+
+    std::unique_ptr<Tokenizer::TokenCache> ownCache;
+    Tokenizer::TokenCache* cache = nullptr;
+    K::Flags::FlagData cacheFlag = K::Flags::getFlag(Flags::TOKEN_CACHE_DIR);
+    if (cacheFlag.present) {
+        u64 cacheSize = Tokenizer::TokenCache::c_DefaultMaxBytes;
+        K::Flags::FlagData cacheSizeFlag = K::Flags::getFlag(Flags::TOKEN_CACHE_SIZE);
+        if (cacheSizeFlag.present) {
+            try {
+                cacheSize = std::stoull(cacheSizeFlag.value) * 1024 * 1024;
+            } catch (std::exception& e) {
+                LOG_ERROR("Invalid token cache size: " + cacheSizeFlag.value);
+                return 1;
+            }
+        }
+
+        try {
+            if (server) {
+                cache = &server->GetTokenCache(cacheFlag.value, cacheSize);
+            } else {
+                ownCache = std::make_unique<Tokenizer::TokenCache>(cacheFlag.value, cacheSize);
+                cache = ownCache.get();
+            }
+        } catch (std::exception& e) {
+            LOG_ERROR("Could not use token cache directory " + cacheFlag.value + ": " + e.what());
+            return 1;
+        }
+    }
+
+    std::vector<std::string> searchRoots;
+    K::Flags::FlagData modulePathFlag = K::Flags::getFlag(Flags::MODULE_PATH);
+    if (modulePathFlag.present) {
+        searchRoots = Modules::ModuleLoader::SplitSearchPath(modulePathFlag.value);
     }
 
-    std::vector <Ref<Tokenizer::Token>> tokens;
-    try {
-        LOG_TRACE("Tokenizing file...");
-        while (Tokenizer::PeekToken() ) {
-            Ref<Tokenizer::Token> token = Tokenizer::NextToken();
-            tokens.push_back(token);
+    // Inputs and the modules they import are lexed and parsed on one pool, each as soon as it is found.
+    // The daemon's pool and loaders outlive the request, so only files that changed since the last one load.
+    std::unique_ptr<K::ThreadPool> ownPool;
+    std::unique_ptr<Modules::ModuleLoader> ownLoader;
+    Modules::ModuleLoader* loader = nullptr;
+    if (server) {
+        loader = &server->GetLoader(searchRoots, engine, cache);
+    } else {
+        ownPool = std::make_unique<K::ThreadPool>(jobs);
+        ownLoader = std::make_unique<Modules::ModuleLoader>(*ownPool, searchRoots, engine, cache);
+        loader = ownLoader.get();
+    }
+
+    LOG_TRACE("Loading " + std::to_string(inputFiles.size()) + " file(s)...");
+    for (std::string& inputFile : inputFiles) {
+        loader->Add(inputFile);
+    }
+    loader->Wait();
+    const std::vector<Modules::Module*>& inputs = loader->GetInputs();
+
+    std::vector<Modules::Module*> untokenized;
+    for (Modules::Module* input : inputs) {
+        if (!input->tokenized) {
+            untokenized.push_back(input);
         }
-        LOG_TRACE("File tokenized successfully\n");
-    } catch (Tokenizer::TokenizerException& e) {
-        LOG_ERROR(e.what());
-        return 1;
-    } catch (std::exception& e) {
-        LOG_ERROR(e.what());
+    }
+    if (reportErrors(untokenized)) {
         return 1;
     }
+    LOG_TRACE("Files tokenized successfully\n");
+
+    // With several inputs the dumps gain a File column so every token stays attributable
+    bool multipleInputs = inputs.size() > 1;
 
     K::Flags::FlagData tokenizeToCsv = K::Flags::getFlag(Flags::TOKENIZER_CSV_OUTPUT_FILE);
     if (tokenizeToCsv.present) {
         LOG_TRACE("Writing Tokenizer CSV file");
         std::string csvFile = tokenizeToCsv.value;
-        std::ofstream file(csvFile);
-        if (!file.is_open()) {
+        K::Writer file;
+        if (!file.Open(csvFile, true)) {
             LOG_ERROR("Could not open Tokenizer CSV file: " + csvFile);
             return 1;
         } 
-        file << "Type,Value,Line,Column" << std::endl;
-        for (auto &token : tokens) {
-            file << Tokenizer::TokenType::Strings[token->type] << ",\"" << token->content << "\"," << token->line << "," << token->column << std::endl;
+        file.Write(multipleInputs ? "File,Type,Value,Line,Column\n" : "Type,Value,Line,Column\n");
+        for (Modules::Module* input : inputs) {
+            writeTokensCsv(file, *input, multipleInputs);
+        }
+        if (!file.Close()) {
+            LOG_ERROR("Could not write Tokenizer CSV file: " + csvFile);
+            return 1;
         }
-        file.close();
         LOG_TRACE("Tokenizer CSV file written successfully");
     }
 
+    K::Flags::FlagData tokenizeToBinary = K::Flags::getFlag(Flags::TOKENIZER_BIN_OUTPUT_FILE);
+    if (tokenizeToBinary.present) {
+        LOG_TRACE("Writing Tokenizer binary dump");
+        Tokenizer::TokenDumpWriter writer;
+        for (Modules::Module* input : inputs) {
+            writer.Add(input->filepath, input->lexer.GetTokenStream());
+        }
+        try {
+            writer.Save(tokenizeToBinary.value);
+        } catch (std::exception& e) {
+            LOG_ERROR(e.what());
+            return 1;
+        }
+        LOG_TRACE("Tokenizer binary dump written successfully");
+    }
+
     K::Flags::FlagData tokenizeToConsole = K::Flags::getFlag(Flags::TOKENIZER_OUTPUT_TO_CONSOLE);
     if (tokenizeToConsole.present) {
         LOG_TRACE("Printing tokens to console");
-        for (auto &token : tokens) {
-            std::cout << token->ToString() << std::endl;
+        K::Log::Flush();
+        K::Writer console;
+        console.OpenStdout(true);
+        for (Modules::Module* input : inputs) {
+            if (multipleInputs) {
+                console.Write(input->filepath);
+                console.Write(":\n");
+            }
+            writeTokensConsole(console, *input);
         }
+        console.Close();
+    }
+
+    // The token dumps above are written first so they stay usable on input that does not parse
+    if (reportErrors(loader->GetModules())) {
+        return 1;
+    }
+    LOG_TRACE(std::to_string(loader->GetModules().size()) + " module(s) parsed successfully");
+
+    K::Flags::FlagData output = K::Flags::getFlag(Flags::OUTPUT_FILE);
+    if (output.present) {
+        LOG_TRACE("Writing syntax tree");
+        K::Writer file;
+        if (!file.Open(output.value, true)) {
+            LOG_ERROR("Could not open output file: " + output.value);
+            return 1;
+        }
+        for (Modules::Module* input : inputs) {
+            if (multipleInputs) {
+                file.Write(input->filepath);
+                file.Write(":\n");
+            }
+            input->parser.GetAst().Dump(file);
+        }
+        if (!file.Close()) {
+            LOG_ERROR("Could not write output file: " + output.value);
+            return 1;
+        }
+        LOG_TRACE("Syntax tree written successfully");
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char *argv[]) {
+    return compile(argc, argv, nullptr);
+}
@@ -0,0 +1,301 @@
+#include <modules.h>
+
+#include <klib/kthreadpool.h>
+
+#include <filesystem>
+#include <system_error>
+#include <unordered_set>
+
+namespace JR::Modules {
+    namespace fs = std::filesystem;
+
+    namespace {
+        // The key a file is loaded under, so `a/../b.jr` and `b.jr` are one module
+        std::string canonicalPath(const std::string& filepath) {
+            std::error_code error;
+            fs::path path = fs::weakly_canonical(filepath, error);
+            return error ? filepath : path.string();
+        }
+    }
+
+    ModuleLoader::ModuleLoader(K::ThreadPool& pool, std::vector<std::string> searchRoots, Tokenizer::LexerEngine::Enum engine, Tokenizer::TokenCache* cache)
+        : m_Pool(pool), m_SearchRoots(std::move(searchRoots)), m_Engine(engine), m_Cache(cache) {}
+
+    Module& ModuleLoader::Add(const std::string& filepath) {
+        Module& module = _Request(filepath, filepath);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (Module* input : m_Inputs) {
+            if (input == &module) {
+                return module;
+            }
+        }
+        m_Inputs.push_back(&module);
+        return module;
+    }
+
+    void ModuleLoader::Wait() {
+        m_Pool.Wait();
+        while (_Refresh()) {
+            m_Pool.Wait();
+        }
+        _CheckCycles();
+        m_Generation++;
+    }
+
+    void ModuleLoader::ResetInputs() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Inputs.clear();
+        m_Modules.clear();
+    }
+
+    void ModuleLoader::Invalidate(const std::string& filepath) {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        auto found = m_ByPath.find(canonicalPath(filepath));
+        if (found != m_ByPath.end()) {
+            found->second->stale = true;
+        }
+    }
+
+    void ModuleLoader::InvalidateImports() {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        for (auto& module : m_Storage) {
+            module->resolved = false;
+        }
+    }
+
+    std::string ModuleLoader::Resolve(std::string_view name) const {
+        fs::path relative;
+        size_t begin = 0;
+        while (begin <= name.size()) {
+            size_t end = name.find('.', begin);
+            if (end == std::string_view::npos) {
+                end = name.size();
+            }
+            relative /= std::string(name.substr(begin, end - begin));
+            begin = end + 1;
+        }
+        relative += ".jr";
+
+        for (const std::string& root : m_SearchRoots) {
+            fs::path candidate = fs::path(root) / relative;
+            std::error_code error;
+            if (fs::is_regular_file(candidate, error)) {
+                return candidate.string();
+            }
+        }
+        return "";
+    }
+
+    std::vector<std::string> ModuleLoader::SplitSearchPath(std::string_view paths) {
+#ifdef _WIN32
+        constexpr char separator = ';';
+#else
+        constexpr char separator = ':';
+#endif
+        std::vector<std::string> roots;
+        size_t begin = 0;
+        while (begin <= paths.size()) {
+            size_t end = paths.find(separator, begin);
+            if (end == std::string_view::npos) {
+                end = paths.size();
+            }
+            if (end > begin) {
+                roots.emplace_back(paths.substr(begin, end - begin));
+            }
+            begin = end + 1;
+        }
+        return roots;
+    }
+
+    Module& ModuleLoader::_Request(const std::string& name, const std::string& filepath) {
+        std::string key = canonicalPath(filepath);
+        Module* module = nullptr;
+        bool first = false;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            auto found = m_ByPath.find(key);
+            if (found != m_ByPath.end()) {
+                module = found->second;
+                if (!module->stale) {
+                    return *module;
+                }
+                module->stale = false;
+            } else {
+                m_Storage.push_back(std::make_unique<Module>());
+                module = m_Storage.back().get();
+                module->name = name;
+                module->filepath = filepath;
+                m_ByPath.emplace(key, module);
+                first = true;
+            }
+        }
+
+        if (first && m_Watcher) {
+            m_Watcher(key);
+        }
+
+        // Only the first request after a module is added or changed gets here, so every module is loaded exactly once
+        m_Pool.Submit([this, module]() { _Load(*module); });
+        return *module;
+    }
+
+    void ModuleLoader::_Load(Module& module) {
+        // A changed module is reloaded in place, so the modules importing it keep pointing at it
+        module.parser.Reset();
+        module.lexer.Reset();
+        module.imports.clear();
+        module.errors.clear();
+        module.tokenized = false;
+
+        try {
+            module.lexer.SetTokenCache(m_Cache);
+            module.lexer.InitParallel(module.filepath, m_Pool, m_Engine);
+            module.tokenized = true;
+            module.parser.ParseParallel(module.filepath, module.lexer.GetTokenStream(), m_Pool);
+        } catch (Tokenizer::TokenizerException& e) {
+            module.errors.push_back(e.what());
+        } catch (Parser::ParserException& e) {
+            module.errors.push_back(e.what());
+        } catch (std::exception& e) {
+            module.errors.push_back(e.what());
+        }
+
+        if (!module.errors.empty()) {
+            module.resolved = true;
+            module.loadErrors = module.errors.size();
+            return;
+        }
+        _ResolveImports(module);
+    }
+
+    void ModuleLoader::_ResolveImports(Module& module) {
+        module.imports.clear();
+        module.errors.clear();
+        module.resolved = true;
+        module.resolvedIn = m_Generation;
+
+        // Imports are queued as soon as they are found, so dependencies load alongside the rest of this file's imports
+        const Parser::Ast& ast = module.parser.GetAst();
+        for (u32 item : ast.ChildrenOf(ast.Root())) {
+            if (m_SearchRoots.empty() || ast[item].kind != Parser::NodeKind::USE) {
+                continue;
+            }
+
+            u32 path = ast[item].child;
+            std::string name;
+            for (u32 segment : ast.ChildrenOf(path)) {
+                if (!name.empty()) {
+                    name += '.';
+                }
+                name += ast.Text(segment);
+            }
+
+            std::string filepath = Resolve(name);
+            if (filepath.empty()) {
+                module.errors.push_back(_Error(module, path, "Module `" + name + "` not found in the module path"));
+                module.resolved = false;
+                continue;
+            }
+            module.imports.push_back({ &_Request(name, filepath), path });
+        }
+        module.loadErrors = module.errors.size();
+    }
+
+    // Modules reused from an earlier build never load, so the ones reachable from the inputs
+    // that changed or whose imports may resolve differently are found by walking the graph.
+    // The walk only reads, modules are reloaded after it so no load runs while it looks at them.
+    bool ModuleLoader::_Refresh() {
+        std::vector<Module*> reload;
+        std::vector<Module*> resolve;
+        std::unordered_set<Module*> visited;
+        std::vector<Module*> stack(m_Inputs.rbegin(), m_Inputs.rend());
+        while (!stack.empty()) {
+            Module* module = stack.back();
+            stack.pop_back();
+            if (!visited.insert(module).second) {
+                continue;
+            }
+
+            if (module->stale) {
+                reload.push_back(module);
+                continue;
+            }
+            if (!module->resolved && module->resolvedIn != m_Generation) {
+                resolve.push_back(module);
+            }
+            for (auto import = module->imports.rbegin(); import != module->imports.rend(); ++import) {
+                stack.push_back(import->module);
+            }
+        }
+
+        for (Module* module : reload) {
+            _Request(module->name, module->filepath);
+        }
+        for (Module* module : resolve) {
+            _ResolveImports(*module);
+        }
+        return !reload.empty() || !resolve.empty();
+    }
+
+    // Loads never wait on each other, so cycles are found in one walk of the finished graph.
+    // The walk also fixes the order of GetModules() regardless of the order modules loaded in.
+    void ModuleLoader::_CheckCycles() {
+        enum class State { UNVISITED, OPEN, DONE };
+        std::unordered_map<const Module*, State> states;
+        m_Modules.clear();
+
+        struct Frame {
+            Module* module;
+            size_t next;        // The index of the next import to follow
+        };
+        std::vector<Frame> stack;
+
+        for (auto& module : m_Storage) {
+            module->errors.resize(module->loadErrors);
+        }
+
+        for (Module* input : m_Inputs) {
+            if (states[input] != State::UNVISITED) {
+                continue;
+            }
+            states[input] = State::OPEN;
+            m_Modules.push_back(input);
+            stack.push_back({ input, 0 });
+
+            while (!stack.empty()) {
+                Frame& frame = stack.back();
+                if (frame.next == frame.module->imports.size()) {
+                    states[frame.module] = State::DONE;
+                    stack.pop_back();
+                    continue;
+                }
+
+                const Import& import = frame.module->imports[frame.next++];
+                State& state = states[import.module];
+                if (state == State::UNVISITED) {
+                    state = State::OPEN;
+                    m_Modules.push_back(import.module);
+                    stack.push_back({ import.module, 0 });
+                } else if (state == State::OPEN) {
+                    // The imported module is still on the stack, so the modules from it to here form the cycle
+                    std::string cycle;
+                    bool inCycle = false;
+                    for (const Frame& open : stack) {
+                        inCycle = inCycle || open.module == import.module;
+                        if (inCycle) {
+                            cycle += open.module->name + " -> ";
+                        }
+                    }
+                    cycle += import.module->name;
+                    frame.module->errors.push_back(_Error(*frame.module, import.node, "Import cycle: " + cycle));
+                }
+            }
+        }
+    }
+
+    std::string ModuleLoader::_Error(const Module& module, u32 node, const std::string& description) {
+        SourcePosition position = module.parser.GetAst().Position(node);
+        return module.filepath + ":" + std::to_string(position.line) + ":" + std::to_string(position.column)
+            + ": Module error => " + description;
+    }
+}
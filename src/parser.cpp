@@ -0,0 +1,1230 @@
+#include <parser.h>
+
+#include <klib/kthreadpool.h>
+
+#include <atomic>
+#include <cstring>
+
+namespace JR::Parser {
+    using Tokenizer::Token;
+    namespace TokenType = Tokenizer::TokenType;
+
+    namespace {
+        // Symbols of the words the grammar looks for, interned once for every parser
+        struct Keywords {
+            u32 Use, As, Exposing, Fun, Let, Class;
+            u32 Private, Protected, Public, Open, Static;
+            u32 Init, Constructor, For, In, If, Else, While, Sizeof, Nullptr, Return;
+            u32 Is;     // Not reserved, only an operator after an expression
+        };
+
+        const Keywords& keywords() {
+            static const Keywords s_Keywords = [] {
+                K::Interner& symbols = Tokenizer::GetSymbols();
+                Keywords words;
+                words.Use = symbols.Intern("use");
+                words.As = symbols.Intern("as");
+                words.Exposing = symbols.Intern("exposing");
+                words.Fun = symbols.Intern("fun");
+                words.Let = symbols.Intern("let");
+                words.Class = symbols.Intern("class");
+                words.Private = symbols.Intern("private");
+                words.Protected = symbols.Intern("protected");
+                words.Public = symbols.Intern("public");
+                words.Open = symbols.Intern("open");
+                words.Static = symbols.Intern("static");
+                words.Init = symbols.Intern("init");
+                words.Constructor = symbols.Intern("constructor");
+                words.For = symbols.Intern("for");
+                words.In = symbols.Intern("in");
+                words.If = symbols.Intern("if");
+                words.Else = symbols.Intern("else");
+                words.While = symbols.Intern("while");
+                words.Sizeof = symbols.Intern("sizeof");
+                words.Nullptr = symbols.Intern("nullptr");
+                words.Return = symbols.Intern("return");
+                words.Is = symbols.Intern("is");
+                return words;
+            }();
+            return s_Keywords;
+        }
+
+        // Binding power of binary operators, from loosest to tightest
+        enum Precedence: u32 {
+            NOT_BINARY = 0,
+            ASSIGNMENT, OR, AND, BIT_OR, BIT_XOR, BIT_AND, EQUALITY, COMPARISON, RANGE, SHIFT, SUM, PRODUCT
+        };
+
+        Precedence binaryPrecedence(std::string_view op) {
+            switch (op.size()) {
+                case 1:
+                    switch (op[0]) {
+                        case '=': return ASSIGNMENT;
+                        case '|': return BIT_OR;
+                        case '^': return BIT_XOR;
+                        case '&': return BIT_AND;
+                        case '<': case '>': return COMPARISON;
+                        case '+': case '-': return SUM;
+                        case '*': case '/': case '%': return PRODUCT;
+                        default: return NOT_BINARY;
+                    }
+                case 2:
+                    if (op[1] == '=') {
+                        switch (op[0]) {
+                            case '=': case '!': return EQUALITY;
+                            case '<': case '>': return COMPARISON;
+                            default: return ASSIGNMENT;
+                        }
+                    }
+                    if (op == "||") return OR;
+                    if (op == "&&") return AND;
+                    if (op == "<<" || op == ">>") return SHIFT;
+                    return NOT_BINARY;
+                case 3:
+                    if (op == "...") return RANGE;
+                    if (op == "<<=" || op == ">>=") return ASSIGNMENT;
+                    return NOT_BINARY;
+                default:
+                    return NOT_BINARY;
+            }
+        }
+
+        bool isPrefixOperator(std::string_view op) {
+            return op == "-" || op == "+" || op == "!" || op == "~" || op == "*" || op == "&" ||
+                op == "++" || op == "--" || op == "delete";
+        }
+    }
+
+    void Parser::Parse(std::string filepath, const Tokenizer::TokenStream& tokens) {
+        _Begin(filepath, tokens, 0, tokens.Size());
+        ChildList items = _ParseItems();
+        m_Ast.SetRoot(_Node(NodeKind::MODULE, 0, items.first));
+    }
+
+    void Parser::ParseParallel(std::string filepath, const Tokenizer::TokenStream& tokens, K::ThreadPool& pool, size_t chunkTokens) {
+        std::vector<u32> boundaries = _FindChunks(tokens, chunkTokens);
+        if (boundaries.size() <= 2) {
+            Parse(filepath, tokens);
+            return;
+        }
+
+        // Chunks that fail format their error with a position from the shared stream, whose line
+        // index is built lazily by the first lookup, so it is built here before they can race on it
+        tokens.Position(boundaries.front());
+
+        // Every chunk starts a new item, so it parses exactly as it would as part of the whole file
+        std::vector<std::unique_ptr<Parser>> chunks;
+        std::vector<ChildList> items(boundaries.size() - 1);
+        std::atomic<bool> failed = false;
+        std::vector<K::ThreadPool::Task> tasks;
+        for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+            chunks.push_back(std::make_unique<Parser>());
+            Parser& chunk = *chunks.back();
+            chunk._Begin(filepath, tokens, boundaries[i], boundaries[i + 1]);
+
+            tasks.push_back([&chunk, &items, &failed, i]() {
+                try {
+                    items[i] = chunk._ParseItems();
+                } catch (ParserException& e) {
+                    failed = true;
+                }
+            });
+        }
+        pool.RunBatch(std::move(tasks));
+
+        // The error may sit in an item that only reads as broken once cut off at the chunk 
+        // end, parse the whole file again to report the one Parse finds
+        if (failed) {
+            Parse(filepath, tokens);
+            return;
+        }
+
+        _Begin(filepath, tokens, 0, tokens.Size());
+        _Merge(chunks, items, pool);
+    }
+
+    void Parser::_Begin(std::string filepath, const Tokenizer::TokenStream& tokens, u32 begin, u32 end) {
+        Reset();
+        m_Filepath = filepath;
+        m_Tokens = &tokens;
+        m_Position = begin;
+        m_End = end;
+        m_Ast.SetTokens(&tokens);
+    }
+
+    // Top level items start with `use`, `class`, `fun` or a modifier right after a NEWLINE or `;` 
+    // outside of every bracket. Split at the first such start at or past every multiple of the chunk size.
+    std::vector<u32> Parser::_FindChunks(const Tokenizer::TokenStream& tokens, size_t chunkTokens) {
+        const Keywords& words = keywords();
+        std::vector<u32> boundaries = { 0 };
+        size_t target = chunkTokens;
+        i64 depth = 0;
+        u8 previous = TokenType::NONE;
+        for (u32 i = 0; i < tokens.Size(); i++) {
+            const Token& token = tokens[i];
+            switch (token.type) {
+                case TokenType::OPEN_SCOPE:
+                case TokenType::OPEN_PARAM:
+                case TokenType::OPEN_BRACKET:
+                    depth++;
+                    break;
+                case TokenType::CLOSE_SCOPE:
+                case TokenType::CLOSE_PARAM:
+                case TokenType::CLOSE_BRACKET:
+                    depth--;
+                    break;
+                case TokenType::KEYWORD:
+                    if (depth == 0 && i >= target && (previous == TokenType::NEWLINE || previous == TokenType::SEMICOLON) && (
+                        token.symbol == words.Use || token.symbol == words.Class || token.symbol == words.Fun ||
+                        token.symbol == words.Private || token.symbol == words.Protected || token.symbol == words.Public ||
+                        token.symbol == words.Open || token.symbol == words.Static
+                    )) {
+                        boundaries.push_back(i);
+                        target = i + chunkTokens;
+                    }
+                    break;
+                default:
+                    break;
+            }
+            previous = token.type;
+        }
+        boundaries.push_back(tokens.Size());
+        return boundaries;
+    }
+
+    // Move the nodes of every chunk into this tree in order, shifting the indices they refer to each other by
+    void Parser::_Merge(const std::vector<std::unique_ptr<Parser>>& chunks, const std::vector<ChildList>& items, K::ThreadPool& pool) {
+        std::vector<u32> offsets = { 0 };
+        for (const auto& chunk : chunks) {
+            offsets.push_back(offsets.back() + chunk->m_Ast.Size());
+        }
+        m_Ast._Resize(offsets.back());
+
+        std::vector<K::ThreadPool::Task> tasks;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            tasks.push_back([this, &chunks, &offsets, i]() {
+                const Ast& chunk = chunks[i]->m_Ast;
+                u32 offset = offsets[i];
+                for (u32 index = 0; index < chunk.Size(); index++) {
+                    Node node = chunk[index];
+                    if (node.child != c_NoNode) {
+                        node.child += offset;
+                    }
+                    if (node.next != c_NoNode) {
+                        node.next += offset;
+                    }
+                    m_Ast._At(offset + index) = node;
+                }
+            });
+        }
+        pool.RunBatch(std::move(tasks));
+
+        ChildList module;
+        for (size_t i = 0; i < chunks.size(); i++) {
+            if (items[i].first == c_NoNode) {
+                continue;
+            }
+            if (module.last == c_NoNode) {
+                module.first = items[i].first + offsets[i];
+            } else {
+                m_Ast._At(module.last).next = items[i].first + offsets[i];
+            }
+            module.last = items[i].last + offsets[i];
+        }
+        m_Ast.SetRoot(_Node(NodeKind::MODULE, 0, module.first));
+    }
+
+    void Parser::Reset() {
+        m_Ast.Clear();
+        m_Ast.SetTokens(nullptr);
+        m_Tokens = nullptr;
+        m_Filepath.clear();
+        m_Position = 0;
+        m_End = 0;
+        m_Nesting = 0;
+        m_SplitAngle = false;
+        m_Depth = 0;
+    }
+
+    Parser::DepthGuard::DepthGuard(Parser& parser, const char* description) : m_Parser(parser) {
+        if (++parser.m_Depth > c_MaxDepth) {
+            throw parser._Error(description, parser._Current());
+        }
+    }
+
+    /*
+    *   Declarations
+    */
+
+    Parser::ChildList Parser::_ParseItems() {
+        ChildList items;
+        while (true) {
+            _SkipSeparators();
+            if (m_Position >= m_End) {
+                return items;
+            }
+            _Append(items, _ParseItem());
+        }
+    }
+
+    u32 Parser::_ParseItem() {
+        const Keywords& words = keywords();
+        if (_IsKeyword(words.Use)) {
+            return _ParseUse();
+        }
+
+        u8 modifiers = _ParseModifiers();
+        if (_IsKeyword(words.Class)) {
+            return _ParseClass(modifiers);
+        }
+        if (_IsKeyword(words.Fun)) {
+            return _ParseFunction(modifiers);
+        }
+        if (modifiers != 0) {
+            throw _Expected("`class` or `fun` after the modifiers");
+        }
+        return _ParseStatement();
+    }
+
+    // use a.b.c [as Alias] [exposing { name, prefix* }]
+    u32 Parser::_ParseUse() {
+        const Keywords& words = keywords();
+        u32 use = m_Position++;
+
+        u32 first = _Current();
+        ChildList segments;
+        _Append(segments, _Node(NodeKind::NAME, _ExpectName("a module name")));
+        while (_IsOperator(".")) {
+            m_Position++;
+            _Append(segments, _Node(NodeKind::NAME, _ExpectName("a module name")));
+        }
+        u32 path = _Node(NodeKind::PATH, first, segments.first);
+
+        u32 alias = c_NoNode;
+        if (_IsKeyword(words.As)) {
+            m_Position++;
+            alias = _Node(NodeKind::NAME, _Expect(TokenType::IDENTIFIER, "a namespace name"));
+        } else {
+            alias = _Empty();
+        }
+
+        u32 exposing = c_NoNode;
+        if (_IsKeyword(words.Exposing)) {
+            u32 token = m_Position++;
+            _Expect(TokenType::OPEN_SCOPE, "`{`");
+            m_Nesting++;
+
+            ChildList names;
+            while (!_Is(TokenType::CLOSE_SCOPE)) {
+                u32 name = _ExpectName("a member name");
+                u8 flags = 0;
+                if (_IsOperator("*")) {
+                    m_Position++;
+                    flags = NodeFlags::WILDCARD;
+                }
+                _Append(names, _Node(NodeKind::NAME, name, c_NoNode, flags));
+                if (!_Is(TokenType::SEPERATOR)) {
+                    break;
+                }
+                m_Position++;
+            }
+
+            _Expect(TokenType::CLOSE_SCOPE, "`}`");
+            m_Nesting--;
+            exposing = _Node(NodeKind::EXPOSING, token, names.first);
+        } else {
+            exposing = _Empty();
+        }
+
+        _EndStatement();
+        return _Node(NodeKind::USE, use, _Link({ path, alias, exposing }));
+    }
+
+    // [open] class Name[(parameters)] [: Base] { members }
+    u32 Parser::_ParseClass(u8 modifiers) {
+        m_Position++;
+        u32 name = _Expect(TokenType::IDENTIFIER, "a class name");
+        u32 parameters = _Is(TokenType::OPEN_PARAM) ? _ParseParameters(true) : _Empty();
+
+        u32 base = c_NoNode;
+        if (_IsOperator(":")) {
+            m_Position++;
+            base = _ParseType();
+        } else {
+            base = _Empty();
+        }
+
+        _Expect(TokenType::OPEN_SCOPE, "`{`");
+        ChildList members;
+        while (true) {
+            _SkipSeparators();
+            if (m_Position >= m_End || _Token(m_Position).type == TokenType::CLOSE_SCOPE) {
+                break;
+            }
+            _Append(members, _ParseClassMember());
+        }
+        _Expect(TokenType::CLOSE_SCOPE, "`}`");
+
+        u32 children = _Link({ parameters, base });
+        m_Ast._At(base).next = members.first;
+        return _Node(NodeKind::CLASS, name, children, modifiers);
+    }
+
+    u32 Parser::_ParseClassMember() {
+        const Keywords& words = keywords();
+        u8 modifiers = _ParseModifiers();
+
+        if (_IsKeyword(words.Fun)) {
+            return _ParseFunction(modifiers);
+        }
+
+        if (_IsKeyword(words.Init)) {
+            if (modifiers != 0) {
+                throw _Error("The primary constructor can not have modifiers", m_Position);
+            }
+            u32 init = m_Position++;
+            return _Node(NodeKind::INIT, init, _ParseBlock());
+        }
+
+        if (_IsKeyword(words.Constructor)) {
+            u32 constructor = m_Position++;
+            u32 parameters = _ParseParameters(false);
+            u32 body = _ParseBlock();
+            return _Node(NodeKind::CONSTRUCTOR, constructor, _Link({ parameters, body }), modifiers);
+        }
+
+        // name: Type [= value]
+        if (_Is(TokenType::IDENTIFIER)) {
+            u32 name = m_Position++;
+            _ExpectOperator(":");
+            u32 type = _ParseType();
+            u32 value = c_NoNode;
+            if (_IsOperator("=")) {
+                m_Position++;
+                _SkipNewlines();
+                value = _ParseExpression();
+            } else {
+                value = _Empty();
+            }
+            _EndStatement();
+            return _Node(NodeKind::FIELD, name, _Link({ type, value }), modifiers);
+        }
+
+        throw _Expected("a class member");
+    }
+
+    // fun Name(parameters) [: ReturnType] { body }
+    u32 Parser::_ParseFunction(u8 modifiers) {
+        m_Position++;
+        u32 name = _Expect(TokenType::IDENTIFIER, "a function name");
+        u32 parameters = _ParseParameters(false);
+
+        u32 returnType = c_NoNode;
+        if (_IsOperator(":")) {
+            m_Position++;
+            returnType = _ParseType();
+        } else {
+            returnType = _Empty();
+        }
+
+        u32 body = _ParseBlock();
+        return _Node(NodeKind::FUNCTION, name, _Link({ parameters, returnType, body }), modifiers);
+    }
+
+    // ([modifiers] name: Type, ...), the modifiers make primary constructor parameters members
+    u32 Parser::_ParseParameters(bool allowModifiers) {
+        u32 open = _Expect(TokenType::OPEN_PARAM, "`(`");
+        m_Nesting++;
+
+        ChildList parameters;
+        while (!_Is(TokenType::CLOSE_PARAM)) {
+            u8 modifiers = allowModifiers ? _ParseModifiers() : 0;
+            u32 name = _Expect(TokenType::IDENTIFIER, "a parameter name");
+            _ExpectOperator(":");
+            u32 type = _ParseType();
+            _Append(parameters, _Node(NodeKind::PARAMETER, name, type, modifiers));
+            if (!_Is(TokenType::SEPERATOR)) {
+                break;
+            }
+            m_Position++;
+        }
+
+        _Expect(TokenType::CLOSE_PARAM, "`)`");
+        m_Nesting--;
+        return _Node(NodeKind::PARAMETERS, open, parameters.first);
+    }
+
+    u8 Parser::_ParseModifiers() {
+        const Keywords& words = keywords();
+        u8 modifiers = 0;
+        while (_Is(TokenType::KEYWORD)) {
+            u32 symbol = _Token(m_Position).symbol;
+            u8 modifier =
+                symbol == words.Private     ? NodeFlags::PRIVATE :
+                symbol == words.Protected   ? NodeFlags::PROTECTED :
+                symbol == words.Public      ? NodeFlags::PUBLIC :
+                symbol == words.Open        ? NodeFlags::OPEN :
+                symbol == words.Static      ? NodeFlags::STATIC : 0;
+            if (modifier == 0) {
+                break;
+            }
+            if (modifiers & modifier) {
+                throw _Error("Repeated modifier `" + std::string(m_Tokens->Content(m_Position)) + "`", m_Position);
+            }
+            modifiers |= modifier;
+            m_Position++;
+        }
+        return modifiers;
+    }
+
+    /*
+    *   Types
+    */
+
+    u32 Parser::_ParseType() {
+        u32 type = _TryParseType();
+        if (type == c_NoNode) {
+            throw _Expected("a type");
+        }
+        return type;
+    }
+
+    u32 Parser::_TryParseType() {
+        Mark mark = _Mark();
+        u32 type = _ParseTypeName();
+        // A `>>` only half used closes nothing the caller knows about, e.g. `a<b>> c`
+        if (type != c_NoNode && m_SplitAngle) {
+            _Rewind(mark);
+            return c_NoNode;
+        }
+        return type;
+    }
+
+    // Name[<Type, ...>][*...], leaving everything as it was if the tokens are not a type
+    u32 Parser::_ParseTypeName() {
+        Mark mark = _Mark();
+        u32 name = _Current();
+        if (name >= m_End || (_Token(name).type != TokenType::IDENTIFIER && _Token(name).type != TokenType::TYPE)) {
+            return c_NoNode;
+        }
+        m_Position++;
+
+        ChildList arguments;
+        if (_IsOperator("<")) {
+            // Only arguments nest, so types tried speculatively inside deep expressions are not counted
+            DepthGuard depth(*this, "Type nested too deeply");
+            m_Position++;
+            while (true) {
+                u32 argument = _ParseTypeName();
+                if (argument == c_NoNode) {
+                    _Rewind(mark);
+                    return c_NoNode;
+                }
+                _Append(arguments, argument);
+                if (!_Is(TokenType::SEPERATOR)) {
+                    break;
+                }
+                m_Position++;
+            }
+            if (!_CloseAngle()) {
+                _Rewind(mark);
+                return c_NoNode;
+            }
+        }
+
+        u32 type = _Node(NodeKind::TYPE_NAME, name, arguments.first);
+        while (!m_SplitAngle && _IsOperator("*")) {
+            type = _Node(NodeKind::POINTER_TYPE, m_Position++, type);
+        }
+        return type;
+    }
+
+    // Consume one `>`, the lexer reads the end of nested arguments `a<b<c>>` as a single `>>`
+    bool Parser::_CloseAngle() {
+        if (m_SplitAngle) {
+            m_SplitAngle = false;
+            m_Position++;
+            return true;
+        }
+        if (_IsOperator(">")) {
+            m_Position++;
+            return true;
+        }
+        if (_IsOperator(">>")) {
+            m_SplitAngle = true;
+            return true;
+        }
+        return false;
+    }
+
+    /*
+    *   Statements
+    */
+
+    u32 Parser::_ParseBlock() {
+        DepthGuard depth(*this, "Block nested too deeply");
+        u32 open = _Expect(TokenType::OPEN_SCOPE, "`{`");
+        // New lines end statements again inside a block, even one passed as an argument
+        u32 nesting = m_Nesting;
+        m_Nesting = 0;
+
+        ChildList statements;
+        _ParseStatements(statements);
+        _Expect(TokenType::CLOSE_SCOPE, "`}`");
+
+        m_Nesting = nesting;
+        return _Node(NodeKind::BLOCK, open, statements.first);
+    }
+
+    void Parser::_ParseStatements(ChildList& statements) {
+        while (true) {
+            _SkipSeparators();
+            if (m_Position >= m_End || _Token(m_Position).type == TokenType::CLOSE_SCOPE) {
+                return;
+            }
+            _Append(statements, _ParseStatement());
+        }
+    }
+
+    u32 Parser::_ParseStatement() {
+        const Keywords& words = keywords();
+        const Token& token = _Token(_Current());
+        switch (token.type) {
+            case TokenType::KEYWORD:
+                if (token.symbol == words.Let) return _ParseLet();
+                if (token.symbol == words.If) return _ParseIf();
+                if (token.symbol == words.While) return _ParseWhile();
+                if (token.symbol == words.For) return _ParseFor();
+                if (token.symbol == words.Return) return _ParseReturn();
+                if (token.symbol == words.Fun) return _ParseFunction(0);
+                break;
+            case TokenType::OPEN_SCOPE:
+                return _ParseBlock();
+            case TokenType::IDENTIFIER:
+            case TokenType::TYPE: {
+                u32 declaration = _ParseDeclaration();
+                if (declaration != c_NoNode) {
+                    return declaration;
+                }
+                break;
+            }
+            default:
+                break;
+        }
+
+        u32 expression = _ParseExpression();
+        _EndStatement();
+        return expression;
+    }
+
+    // let name [: Type[(arguments)]] [= value]
+    u32 Parser::_ParseLet() {
+        m_Position++;
+        u32 name = _Expect(TokenType::IDENTIFIER, "a variable name");
+
+        u32 type = c_NoNode;
+        u32 value = c_NoNode;
+        if (_IsOperator(":")) {
+            m_Position++;
+            type = _ParseType();
+            if (_Is(TokenType::OPEN_PARAM) && !_LineBreakBefore(m_Position)) {
+                value = _ParseArguments();
+            }
+        } else {
+            type = _Empty();
+        }
+
+        if (value == c_NoNode && _IsOperator("=")) {
+            m_Position++;
+            _SkipNewlines();
+            value = _ParseExpression();
+        }
+        if (value == c_NoNode) {
+            value = _Empty();
+        }
+
+        _EndStatement();
+        return _Node(NodeKind::LET, name, _Link({ type, value }));
+    }
+
+    // Type name [= value], told apart from an expression by parsing it and backing off if it isn't one
+    u32 Parser::_ParseDeclaration() {
+        u32 index = m_Position;
+        if (index + 1 >= m_End) {
+            return c_NoNode;
+        }
+
+        // Only `T name`, `T<...` and `T*` can start one, the rest are expressions for sure
+        const Token& next = _Token(index + 1);
+        if (next.type != TokenType::IDENTIFIER) {
+            if (next.type != TokenType::OPERATOR || next.length != 1) {
+                return c_NoNode;
+            }
+            std::string_view op = m_Tokens->Content(index + 1);
+            if (op != "<" && op != "*") {
+                return c_NoNode;
+            }
+        }
+
+        Mark mark = _Mark();
+        u32 type = _TryParseType();
+        if (type != c_NoNode && _Is(TokenType::IDENTIFIER) && !_LineBreakBefore(m_Position)) {
+            u32 name = m_Position++;
+            bool assigned = _IsOperator("=");
+            if (assigned || _AtStatementEnd()) {
+                u32 value = c_NoNode;
+                if (assigned) {
+                    m_Position++;
+                    _SkipNewlines();
+                    value = _ParseExpression();
+                } else {
+                    value = _Empty();
+                }
+                _EndStatement();
+                return _Node(NodeKind::VARIABLE, name, _Link({ type, value }));
+            }
+        }
+
+        _Rewind(mark);
+        return c_NoNode;
+    }
+
+    u32 Parser::_ParseIf() {
+        const Keywords& words = keywords();
+        u32 token = m_Position++;
+        _Expect(TokenType::OPEN_PARAM, "`(`");
+        m_Nesting++;
+        u32 condition = _ParseExpression();
+        _Expect(TokenType::CLOSE_PARAM, "`)`");
+        m_Nesting--;
+        u32 body = _ParseBlock();
+
+        // `else` may start the next line
+        u32 next = m_Position;
+        while (next < m_End && _Token(next).type == TokenType::NEWLINE) {
+            next++;
+        }
+
+        u32 otherwise = c_NoNode;
+        if (next < m_End && _Token(next).type == TokenType::KEYWORD && _Token(next).symbol == words.Else) {
+            m_Position = next + 1;
+            otherwise = _IsKeyword(words.If) ? _ParseIf() : _ParseBlock();
+        } else {
+            otherwise = _Empty();
+        }
+
+        return _Node(NodeKind::IF, token, _Link({ condition, body, otherwise }));
+    }
+
+    u32 Parser::_ParseWhile() {
+        u32 token = m_Position++;
+        _Expect(TokenType::OPEN_PARAM, "`(`");
+        m_Nesting++;
+        u32 condition = _ParseExpression();
+        _Expect(TokenType::CLOSE_PARAM, "`)`");
+        m_Nesting--;
+        u32 body = _ParseBlock();
+        return _Node(NodeKind::WHILE, token, _Link({ condition, body }));
+    }
+
+    // for (name [: Type] in iterable) { body }
+    u32 Parser::_ParseFor() {
+        const Keywords& words = keywords();
+        m_Position++;
+        _Expect(TokenType::OPEN_PARAM, "`(`");
+        m_Nesting++;
+
+        u32 name = _Expect(TokenType::IDENTIFIER, "a loop variable");
+        u32 type = c_NoNode;
+        if (_IsOperator(":")) {
+            m_Position++;
+            type = _ParseType();
+        } else {
+            type = _Empty();
+        }
+
+        if (!_IsKeyword(words.In)) {
+            throw _Expected("`in`");
+        }
+        m_Position++;
+        u32 iterable = _ParseExpression();
+        _Expect(TokenType::CLOSE_PARAM, "`)`");
+        m_Nesting--;
+
+        u32 body = _ParseBlock();
+        return _Node(NodeKind::FOR, name, _Link({ type, iterable, body }));
+    }
+
+    u32 Parser::_ParseReturn() {
+        u32 token = m_Position++;
+        u32 value = _AtStatementEnd() ? _Empty() : _ParseExpression();
+        _EndStatement();
+        return _Node(NodeKind::RETURN, token, value);
+    }
+
+    // Semicolons are optional, a statement also ends at a new line or the end of its block
+    bool Parser::_AtStatementEnd() {
+        u32 index = _Current();
+        if (index >= m_End) {
+            return true;
+        }
+        u8 type = _Token(index).type;
+        return type == TokenType::NEWLINE || type == TokenType::SEMICOLON || type == TokenType::CLOSE_SCOPE ||
+            _LineBreakBefore(index);
+    }
+
+    void Parser::_EndStatement() {
+        if (!_AtStatementEnd()) {
+            throw _Expected("a new line or `;` after the statement");
+        }
+        if (_Is(TokenType::NEWLINE) || _Is(TokenType::SEMICOLON)) {
+            m_Position++;
+        }
+    }
+
+    /*
+    *   Expressions
+    */
+
+    u32 Parser::_ParseExpression(u32 minPrecedence) {
+        const Keywords& words = keywords();
+        u32 left = _ParseUnary();
+        while (true) {
+            u32 index = _Current();
+            if (index >= m_End) {
+                break;
+            }
+
+            const Token& token = _Token(index);
+            u32 precedence = NOT_BINARY;
+            if (token.type == TokenType::OPERATOR) {
+                precedence = binaryPrecedence(m_Tokens->Content(index));
+            } else if (token.type == TokenType::IDENTIFIER && token.symbol == words.Is) {
+                precedence = COMPARISON;
+            }
+            if (precedence == NOT_BINARY || precedence < minPrecedence || (m_Nesting == 0 && _LineBreakBefore(index))) {
+                break;
+            }
+            m_Position++;
+
+            if (token.type == TokenType::IDENTIFIER) {
+                u32 type = _ParseType();
+                left = _Node(NodeKind::IS, index, _Link({ left, type }));
+                continue;
+            }
+
+            // An operator at the end of a line continues the expression on the next
+            _SkipNewlines();
+            // Assignments group to the right, everything else to the left
+            u32 right = _ParseExpression(precedence == ASSIGNMENT ? precedence : precedence + 1);
+            left = _Node(NodeKind::BINARY, index, _Link({ left, right }));
+        }
+        return left;
+    }
+
+    // Every nested expression, e.g. in parentheses or after a prefix operator, comes through here
+    u32 Parser::_ParseUnary() {
+        DepthGuard depth(*this, "Expression nested too deeply");
+        u32 index = _Current();
+        if (index < m_End && _Token(index).type == TokenType::OPERATOR) {
+            std::string_view op = m_Tokens->Content(index);
+            if (op == "new") {
+                m_Position++;
+                u32 type = _ParseType();
+                u32 arguments = (_Is(TokenType::OPEN_PARAM) && !_LineBreakBefore(m_Position)) ? _ParseArguments() : _Empty();
+                return _Node(NodeKind::NEW, index, _Link({ type, arguments }));
+            }
+            if (isPrefixOperator(op)) {
+                m_Position++;
+                return _Node(NodeKind::UNARY, index, _ParseUnary());
+            }
+        }
+        return _ParsePostfix(_ParsePrimary());
+    }
+
+    u32 Parser::_ParsePostfix(u32 operand) {
+        while (true) {
+            u32 index = _Current();
+            if (index >= m_End || (m_Nesting == 0 && _LineBreakBefore(index))) {
+                return operand;
+            }
+
+            const Token& token = _Token(index);
+            switch (token.type) {
+                case TokenType::OPEN_PARAM: {
+                    u32 arguments = _ParseArguments();
+                    operand = _Node(NodeKind::CALL, index, _Link({ operand, arguments }));
+                    break;
+                }
+                case TokenType::OPEN_BRACKET: {
+                    m_Position++;
+                    m_Nesting++;
+                    u32 subscript = _ParseExpression();
+                    _Expect(TokenType::CLOSE_BRACKET, "`]`");
+                    m_Nesting--;
+                    operand = _Node(NodeKind::INDEX, index, _Link({ operand, subscript }));
+                    break;
+                }
+                case TokenType::OPEN_SCOPE: {
+                    // A closure after something callable is passed to it, `f { ... }` or `f(a) { ... }`
+                    u8 kind = m_Ast[operand].kind;
+                    u8 flags = m_Ast[operand].flags;
+                    if (kind != NodeKind::NAME && kind != NodeKind::MEMBER && kind != NodeKind::SCOPE &&
+                        kind != NodeKind::CALL && kind != NodeKind::TYPE_NAME
+                    ) {
+                        return operand;
+                    }
+
+                    u32 closure = _ParseClosure();
+                    if (kind == NodeKind::CALL && !(flags & NodeFlags::TRAILING_CLOSURE)) {
+                        u32 arguments = m_Ast[m_Ast[operand].child].next;
+                        u32 last = m_Ast[arguments].child;
+                        if (last == c_NoNode) {
+                            m_Ast._At(arguments).child = closure;
+                        } else {
+                            while (m_Ast[last].next != c_NoNode) {
+                                last = m_Ast[last].next;
+                            }
+                            m_Ast._At(last).next = closure;
+                        }
+                        m_Ast._At(operand).flags |= NodeFlags::TRAILING_CLOSURE;
+                    } else {
+                        u32 arguments = _Node(NodeKind::ARGUMENTS, index, closure);
+                        operand = _Node(NodeKind::CALL, index, _Link({ operand, arguments }), NodeFlags::TRAILING_CLOSURE);
+                    }
+                    break;
+                }
+                case TokenType::OPERATOR: {
+                    std::string_view op = m_Tokens->Content(index);
+                    if (op == "." || op == "::") {
+                        m_Position++;
+                        u32 name = _ExpectName("a member name");
+                        operand = _Node(op[0] == '.' ? NodeKind::MEMBER : NodeKind::SCOPE, name, operand);
+                        break;
+                    }
+                    if (op == "++" || op == "--") {
+                        m_Position++;
+                        operand = _Node(NodeKind::POSTFIX, index, operand);
+                        break;
+                    }
+                    return operand;
+                }
+                default:
+                    return operand;
+            }
+        }
+    }
+
+    u32 Parser::_ParsePrimary() {
+        const Keywords& words = keywords();
+        u32 index = _Current();
+        if (index >= m_End) {
+            throw _Expected("an expression");
+        }
+
+        const Token& token = _Token(index);
+        switch (token.type) {
+            case TokenType::INTEGER_LITERAL:
+            case TokenType::FLOAT_LITERAL:
+            case TokenType::STRING_LITERAL:
+            case TokenType::CHAR_LITERAL:
+            case TokenType::BOOLEAN_LITERAL:
+                m_Position++;
+                return _Node(NodeKind::LITERAL, index);
+
+            case TokenType::KEYWORD:
+                if (token.symbol == words.Nullptr) {
+                    m_Position++;
+                    return _Node(NodeKind::LITERAL, index);
+                }
+                // Calls the primary constructor from a secondary one
+                if (token.symbol == words.Init) {
+                    m_Position++;
+                    return _Node(NodeKind::NAME, index);
+                }
+                if (token.symbol == words.Sizeof) {
+                    m_Position++;
+                    _Expect(TokenType::OPEN_PARAM, "`(`");
+                    m_Nesting++;
+                    Mark mark = _Mark();
+                    u32 operand = _TryParseType();
+                    if (operand == c_NoNode || !_Is(TokenType::CLOSE_PARAM)) {
+                        _Rewind(mark);
+                        operand = _ParseExpression();
+                    }
+                    _Expect(TokenType::CLOSE_PARAM, "`)`");
+                    m_Nesting--;
+                    return _Node(NodeKind::SIZEOF, index, operand);
+                }
+                break;
+
+            case TokenType::IDENTIFIER:
+            case TokenType::TYPE: {
+                // A generic type used as a value, `list<int>(20)` or `set<int>::heap(20)`
+                if (index + 1 < m_End && _Token(index + 1).type == TokenType::OPERATOR && _Token(index + 1).length == 1 &&
+                    m_Tokens->Content(index + 1) == "<"
+                ) {
+                    Mark mark = _Mark();
+                    u32 type = _TryParseType();
+                    if (type != c_NoNode && (_Is(TokenType::OPEN_PARAM) || _IsOperator("::")) && !_LineBreakBefore(m_Position)) {
+                        return type;
+                    }
+                    _Rewind(mark);
+                }
+                m_Position++;
+                return _Node(token.type == TokenType::TYPE ? NodeKind::TYPE_NAME : NodeKind::NAME, index);
+            }
+
+            case TokenType::OPEN_PARAM: {
+                m_Position++;
+                m_Nesting++;
+
+                // A cast if the parentheses hold something that can only be a type, `(int*)p`
+                Mark mark = _Mark();
+                u32 type = _TryParseType();
+                if (type != c_NoNode && _Is(TokenType::CLOSE_PARAM)) {
+                    const Node& node = m_Ast[type];
+                    if (node.kind == NodeKind::POINTER_TYPE || node.child != c_NoNode || _Token(node.token).type == TokenType::TYPE) {
+                        m_Position++;
+                        m_Nesting--;
+                        u32 operand = _ParseUnary();
+                        return _Node(NodeKind::CAST, index, _Link({ type, operand }));
+                    }
+                }
+                _Rewind(mark);
+
+                u32 inner = _ParseExpression();
+                _Expect(TokenType::CLOSE_PARAM, "`)`");
+                m_Nesting--;
+                return inner;
+            }
+
+            case TokenType::OPEN_SCOPE:
+                return _ParseClosure();
+
+            default:
+                break;
+        }
+
+        throw _Expected("an expression");
+    }
+
+    u32 Parser::_ParseArguments() {
+        u32 open = m_Position++;
+        m_Nesting++;
+
+        ChildList arguments;
+        while (!_Is(TokenType::CLOSE_PARAM)) {
+            _Append(arguments, _ParseExpression());
+            if (!_Is(TokenType::SEPERATOR)) {
+                break;
+            }
+            m_Position++;
+        }
+
+        _Expect(TokenType::CLOSE_PARAM, "`)`");
+        m_Nesting--;
+        return _Node(NodeKind::ARGUMENTS, open, arguments.first);
+    }
+
+    // { [name [: Type], ... ->] statements }
+    u32 Parser::_ParseClosure() {
+        u32 open = m_Position++;
+        u32 nesting = m_Nesting;
+        m_Nesting = 0;
+
+        u32 parameters = _ParseClosureParameters(open);
+        ChildList statements;
+        _ParseStatements(statements);
+        _Expect(TokenType::CLOSE_SCOPE, "`}`");
+
+        m_Nesting = nesting;
+        u32 body = _Node(NodeKind::BLOCK, open, statements.first);
+        return _Node(NodeKind::CLOSURE, open, _Link({ parameters, body }));
+    }
+
+    // The parameters before the `->`, if the closure starts with any
+    u32 Parser::_ParseClosureParameters(u32 open) {
+        Mark mark = _Mark();
+        ChildList parameters;
+        while (_Is(TokenType::IDENTIFIER)) {
+            u32 name = m_Position++;
+            u32 type = c_NoNode;
+            if (_IsOperator(":")) {
+                m_Position++;
+                type = _TryParseType();
+                if (type == c_NoNode) {
+                    break;
+                }
+            } else {
+                type = _Empty();
+            }
+            _Append(parameters, _Node(NodeKind::PARAMETER, name, type));
+
+            if (_Is(TokenType::SEPERATOR)) {
+                m_Position++;
+                continue;
+            }
+
+            // The lexer has no `->` operator, it is a `-` directly followed by a `>`
+            if (_IsOperator("-") && m_Position + 1 < m_End) {
+                const Token& minus = _Token(m_Position);
+                const Token& greater = _Token(m_Position + 1);
+                if (greater.type == TokenType::OPERATOR && greater.offset == minus.offset + 1 &&
+                    m_Tokens->Content(m_Position + 1) == ">"
+                ) {
+                    m_Position += 2;
+                    return _Node(NodeKind::PARAMETERS, open, parameters.first);
+                }
+            }
+            break;
+        }
+
+        _Rewind(mark);
+        return _Node(NodeKind::PARAMETERS, open);
+    }
+
+    /*
+    *   Tokens
+    */
+
+    u32 Parser::_Current() {
+        if (m_Nesting > 0) {
+            while (m_Position < m_End && _Token(m_Position).type == TokenType::NEWLINE) {
+                m_Position++;
+            }
+        }
+        return m_Position;
+    }
+
+    bool Parser::_IsOperator(std::string_view op) {
+        if (_Current() >= m_End) {
+            return false;
+        }
+        const Token& token = _Token(m_Position);
+        return token.type == TokenType::OPERATOR && token.length == op.size() && m_Tokens->Content(m_Position) == op;
+    }
+
+    bool Parser::_IsKeyword(u32 symbol) {
+        if (_Current() >= m_End) {
+            return false;
+        }
+        const Token& token = _Token(m_Position);
+        return token.type == TokenType::KEYWORD && token.symbol == symbol;
+    }
+
+    // Whether a line ends between this token and the one before, in a NEWLINE token or in skipped comments
+    bool Parser::_LineBreakBefore(u32 index) const {
+        if (index == 0 || index >= m_End) {
+            return false;
+        }
+        const Token& previous = _Token(index - 1);
+        if (previous.type == TokenType::NEWLINE) {
+            return true;
+        }
+
+        std::string_view source = m_Tokens->GetSource();
+        u32 from = static_cast<u32>(previous.offset + previous.length - m_Tokens->GetBase());
+        u32 to = static_cast<u32>(_Token(index).offset - m_Tokens->GetBase());
+        return to > from && to <= source.size() && std::memchr(source.data() + from, '\n', to - from) != nullptr;
+    }
+
+    void Parser::_SkipNewlines() {
+        while (m_Position < m_End && _Token(m_Position).type == TokenType::NEWLINE) {
+            m_Position++;
+        }
+    }
+
+    void Parser::_SkipSeparators() {
+        while (m_Position < m_End && (_Token(m_Position).type == TokenType::NEWLINE || _Token(m_Position).type == TokenType::SEMICOLON)) {
+            m_Position++;
+        }
+    }
+
+    u32 Parser::_Expect(TokenType::Enum type, const char* what) {
+        if (!_Is(type)) {
+            throw _Expected(what);
+        }
+        return m_Position++;
+    }
+
+    u32 Parser::_ExpectOperator(std::string_view op) {
+        if (!_IsOperator(op)) {
+            throw _Expected(("`" + std::string(op) + "`").c_str());
+        }
+        return m_Position++;
+    }
+
+    // Names after `use`, `.` and `::` may be spelled like reserved words, e.g. `exposing { open }`
+    u32 Parser::_ExpectName(const char* what) {
+        if (!_Is(TokenType::IDENTIFIER) && !_Is(TokenType::KEYWORD) && !_Is(TokenType::TYPE)) {
+            throw _Expected(what);
+        }
+        return m_Position++;
+    }
+
+    /*
+    *   Nodes
+    */
+
+    u32 Parser::_Node(u32 kind, u32 token, u32 child, u8 flags) {
+        return m_Ast.Push(Node{ static_cast<u8>(kind), flags, 0, token, child, c_NoNode });
+    }
+
+    u32 Parser::_Empty() {
+        return _Node(NodeKind::EMPTY, 0);
+    }
+
+    u32 Parser::_Link(std::initializer_list<u32> children) {
+        u32 first = c_NoNode;
+        u32 previous = c_NoNode;
+        for (u32 child : children) {
+            if (previous == c_NoNode) {
+                first = child;
+            } else {
+                m_Ast._At(previous).next = child;
+            }
+            previous = child;
+        }
+        return first;
+    }
+
+    void Parser::_Append(ChildList& list, u32 node) {
+        if (list.last == c_NoNode) {
+            list.first = node;
+        } else {
+            m_Ast._At(list.last).next = node;
+        }
+        list.last = node;
+    }
+
+    void Parser::_Rewind(const Mark& mark) {
+        m_Position = mark.position;
+        m_Ast.Truncate(mark.size);
+        m_SplitAngle = false;
+    }
+
+    ParserException Parser::_Error(const std::string& description, u32 index) const {
+        SourcePosition position;
+        if (index < m_End) {
+            position = m_Tokens->Position(index);
+        } else if (m_End > 0) {
+            const Token& last = _Token(m_End - 1);
+            position = m_Tokens->PositionOf(last.offset + last.length);
+        }
+        return ParserException(m_Filepath, description, position.line, position.column);
+    }
+
+    ParserException Parser::_Expected(const char* what) {
+        u32 index = _Current();
+        std::string found;
+        if (index >= m_End) {
+            found = "the end of the file";
+        } else if (_Token(index).type == TokenType::NEWLINE) {
+            found = "a new line";
+        } else {
+            found = "`" + std::string(m_Tokens->Content(index)) + "`";
+        }
+        return _Error("Expected " + std::string(what) + ", found " + found, index);
+    }
+}
@@ -0,0 +1,262 @@
+#include <source.h>
+#include <klib/kscan.h>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define JR_POSIX_SOURCE 1
+#else
+#include <fstream>
+#endif
+
+namespace JR {
+    SourceBuffer::~SourceBuffer() {
+        Close();
+    }
+
+    SourceBuffer::SourceBuffer(SourceBuffer&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    SourceBuffer& SourceBuffer::operator=(SourceBuffer&& other) noexcept {
+        if (this != &other) {
+            Close();
+            m_Owned = std::move(other.m_Owned);
+            m_Mapped = std::exchange(other.m_Mapped, false);
+            m_Size = std::exchange(other.m_Size, 0);
+            m_Data = m_Mapped ? std::exchange(other.m_Data, nullptr) : m_Owned.data();
+            other.m_Data = nullptr;
+        }
+        return *this;
+    }
+
+    void SourceBuffer::Close() {
+#ifdef JR_POSIX_SOURCE
+        if (m_Mapped) {
+            munmap(const_cast<char*>(m_Data), m_Size);
+        }
+#endif
+        m_Owned = {};
+        m_Data = nullptr;
+        m_Size = 0;
+        m_Mapped = false;
+    }
+
+    void SourceBuffer::Assign(std::string_view text) {
+        Close();
+        m_Owned.assign(text.begin(), text.end());
+        m_Data = m_Owned.data();
+        m_Size = m_Owned.size();
+    }
+
+    void SourceBuffer::Replace(size_t offset, size_t removedLength, std::string_view insertedText) {
+        if (offset > m_Size || removedLength > m_Size - offset) {
+            throw std::out_of_range("Edit range is outside of the source buffer");
+        }
+
+        if (m_Mapped) {
+            std::vector<char> owned(m_Data, m_Data + m_Size);
+            Close();
+            m_Owned = std::move(owned);
+        }
+
+        // Overwrite the common prefix in place so a replacement only moves the tail once
+        size_t common = std::min(removedLength, insertedText.size());
+        std::copy(insertedText.begin(), insertedText.begin() + common, m_Owned.begin() + offset);
+        if (removedLength > common) {
+            m_Owned.erase(m_Owned.begin() + offset + common, m_Owned.begin() + offset + removedLength);
+        } else {
+            m_Owned.insert(m_Owned.begin() + offset + common, insertedText.begin() + common, insertedText.end());
+        }
+        m_Data = m_Owned.data();
+        m_Size = m_Owned.size();
+    }
+
+#ifdef JR_POSIX_SOURCE
+    void SourceBuffer::Open(const std::string& filepath) {
+        Close();
+
+        bool isStdin = filepath == "-";
+        int fd = isStdin ? STDIN_FILENO : open(filepath.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Could not open input file " + filepath);
+        }
+
+        struct stat info = {};
+        bool isRegular = fstat(fd, &info) == 0 && S_ISREG(info.st_mode);
+        if (isRegular && info.st_size > 0) {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                m_Data = static_cast<const char*>(mapping);
+                m_Size = info.st_size;
+                m_Mapped = true;
+                if (!isStdin) {
+                    close(fd);
+                }
+                return;
+            }
+        }
+
+        // Fall back to reading into an owned buffer, sized up front when the file size is known
+        m_Owned.resize(isRegular ? info.st_size : 64 * 1024);
+        size_t size = 0;
+        while (true) {
+            if (size == m_Owned.size()) {
+                if (isRegular) {
+                    break;
+                }
+                m_Owned.resize(m_Owned.size() * 2);
+            }
+
+            ssize_t bytesRead = read(fd, m_Owned.data() + size, m_Owned.size() - size);
+            if (bytesRead < 0) {
+                if (!isStdin) {
+                    close(fd);
+                }
+                m_Owned = {};
+                throw std::runtime_error("Could not read input file " + filepath);
+            }
+            if (bytesRead == 0) {
+                break;
+            }
+            size += bytesRead;
+        }
+
+        if (!isStdin) {
+            close(fd);
+        }
+        m_Owned.resize(size);
+        m_Data = m_Owned.data();
+        m_Size = size;
+    }
+#else
+    void SourceBuffer::Open(const std::string& filepath) {
+        Close();
+
+        std::ifstream file(filepath, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            throw std::runtime_error("Could not open input file " + filepath);
+        }
+
+        m_Owned.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(m_Owned.data(), m_Owned.size());
+        m_Data = m_Owned.data();
+        m_Size = m_Owned.size();
+    }
+#endif
+
+    void LineIndex::Build(std::string_view text, SourcePosition origin) {
+        m_Origin = origin;
+        m_LineStarts.resize(K::Scan::CountNewlines(text.data(), text.size()) + 1);
+        m_LineStarts[0] = 0;
+        K::Scan::FindNewlines(text.data(), text.size(), m_LineStarts.data() + 1);
+        for (size_t i = 1; i < m_LineStarts.size(); i++) {
+            m_LineStarts[i]++;
+        }
+    }
+
+    SourcePosition LineIndex::Lookup(size_t offset) const {
+        size_t line = std::upper_bound(m_LineStarts.begin(), m_LineStarts.end(), offset) - m_LineStarts.begin() - 1;
+        return _Position(offset, line);
+    }
+
+    SourcePosition LineIndex::Lookup(size_t offset, size_t& line) const {
+        if (line >= m_LineStarts.size() || m_LineStarts[line] > offset) {
+            line = std::upper_bound(m_LineStarts.begin(), m_LineStarts.end(), offset) - m_LineStarts.begin() - 1;
+        }
+        while (line + 1 < m_LineStarts.size() && m_LineStarts[line + 1] <= offset) {
+            line++;
+        }
+        return _Position(offset, line);
+    }
+
+    SourcePosition LineIndex::_Position(size_t offset, size_t line) const {
+        u32 column = static_cast<u32>(offset - m_LineStarts[line]);
+        return { static_cast<u32>(m_Origin.line + line), line == 0 ? m_Origin.column + column : column + 1 };
+    }
+
+    StreamBuffer::~StreamBuffer() {
+        Close();
+    }
+
+    void StreamBuffer::Open(const std::string& filepath, size_t chunkSize) {
+        Close();
+
+        if (filepath == "-") {
+            m_File = stdin;
+        } else {
+            m_File = fopen(filepath.c_str(), "rb");
+            if (!m_File) {
+                throw std::runtime_error("Could not open input file " + filepath);
+            }
+            m_OwnsFile = true;
+        }
+        m_Filepath = filepath;
+        m_ChunkSize = std::max<size_t>(chunkSize, 1);
+    }
+
+    void StreamBuffer::Close() {
+        if (m_OwnsFile) {
+            fclose(m_File);
+        }
+        m_File = nullptr;
+        m_OwnsFile = false;
+        m_AtEnd = false;
+        m_Filepath.clear();
+        m_Buffer = {};
+        m_Start = m_Size = m_Released = 0;
+        m_Begin = 0;
+    }
+
+    void StreamBuffer::Release(u64 offset) {
+        if (offset > m_Begin) {
+            m_Released = static_cast<size_t>(std::min<u64>(offset - m_Begin, m_Size));
+        }
+    }
+
+    bool StreamBuffer::ReadChunk() {
+        if (!m_File) {
+            return false;
+        }
+
+        m_Start += m_Released;
+        m_Size -= m_Released;
+        m_Begin += m_Released;
+        m_Released = 0;
+        if (m_AtEnd) {
+            return false;
+        }
+
+        // Only the bytes still held are moved to make room, the buffer grows only when they don't fit.
+        // Nothing is held before the first read, when the buffer has no storage to move from yet.
+        size_t wanted = std::max(m_ChunkSize, m_Size);
+        if (m_Start + m_Size + wanted > m_Buffer.size()) {
+            if (m_Size > 0) {
+                std::memmove(m_Buffer.data(), m_Buffer.data() + m_Start, m_Size);
+            }
+            m_Start = 0;
+            if (m_Size + wanted > m_Buffer.size()) {
+                m_Buffer.resize(m_Size + wanted);
+            }
+        }
+
+        size_t bytesRead = fread(m_Buffer.data() + m_Start + m_Size, 1, wanted, m_File);
+        if (bytesRead < wanted) {
+            if (ferror(m_File)) {
+                throw std::runtime_error("Could not read input file " + m_Filepath);
+            }
+            m_AtEnd = true;
+        }
+        m_Size += bytesRead;
+        return bytesRead > 0;
+    }
+}
@@ -0,0 +1,264 @@
+#include <tokencache.h>
+#include <tokenizer.h>
+#include <source.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace JR::Tokenizer {
+    /*
+    *   An entry is a header followed by the tokens exactly as they sit in a TokenStream, except
+    *   that symbols are 1 based indices into the entry's own name list. Each name is stored as
+    *   the index of the first token spelling it, since the name is that token's source text.
+    *   Rewritten token content follows as (token, offset, length) records and a text blob.
+    *   Everything is in host byte order, the fingerprint covers the Token layout.
+    */
+    constexpr char c_Magic[4] = { 'J', 'R', 'T', 'C' };
+    constexpr u32 c_FormatVersion = 1;
+    constexpr const char* c_Extension = ".jrtc";
+
+    struct EntryHeader {
+        char magic[4];
+        u32 version;
+        u64 fingerprint;    // RulesFingerprint()
+        u64 sourceHash;
+        u64 sourceSize;
+        u32 tokenCount;
+        u32 nameCount;
+        u32 rewrittenCount;
+        u32 rewrittenBytes;
+    };
+
+    struct RewrittenRecord {
+        u32 token;
+        u32 offset;         // Into the text blob
+        u32 length;
+    };
+
+    template<typename T>
+    T _ReadRecord(const char* data, size_t index) {
+        T record;
+        std::memcpy(&record, data + index * sizeof(T), sizeof(T));
+        return record;
+    }
+
+    TokenCache::TokenCache(std::string directory, u64 maxBytes)
+        : m_Directory(std::move(directory)), m_MaxBytes(maxBytes) {
+        std::filesystem::create_directories(m_Directory);
+        _Evict();
+    }
+
+    // Files are hashed with the interner's word at a time hash, which runs at several GB/s
+    u64 TokenCache::Hash(std::string_view source) {
+        return K::Interner::Hash(source);
+    }
+
+    std::string TokenCache::_EntryPath(u64 hash, size_t sourceSize) const {
+        char name[64];
+        snprintf(name, sizeof(name), "%016llx-%llx", static_cast<unsigned long long>(hash), static_cast<unsigned long long>(sourceSize));
+        return (std::filesystem::path(m_Directory) / (std::string(name) + c_Extension)).string();
+    }
+
+    bool TokenCache::Load(u64 hash, std::string_view source, TokenStream& tokens) {
+        std::string path = _EntryPath(hash, source.size());
+        SourceBuffer entry;
+        try {
+            entry.Open(path);
+        } catch (std::exception& e) {
+            return false;
+        }
+
+        std::string_view data = entry.Data();
+        if (data.size() < sizeof(EntryHeader)) {
+            return false;
+        }
+        EntryHeader header = _ReadRecord<EntryHeader>(data.data(), 0);
+        if (std::memcmp(header.magic, c_Magic, sizeof(c_Magic)) != 0 || header.version != c_FormatVersion ||
+            header.fingerprint != RulesFingerprint() || header.sourceHash != hash || header.sourceSize != source.size()) {
+            return false;
+        }
+
+        const char* tokenData = data.data() + sizeof(EntryHeader);
+        const char* nameData = tokenData + size_t(header.tokenCount) * sizeof(Token);
+        const char* rewrittenData = nameData + size_t(header.nameCount) * sizeof(u32);
+        const char* textData = rewrittenData + size_t(header.rewrittenCount) * sizeof(RewrittenRecord);
+        if (size_t(textData - data.data()) + header.rewrittenBytes != data.size()) {
+            return false;
+        }
+
+        // A damaged entry must not produce tokens outside of the source
+        auto inSource = [&source](const Token& token) {
+            return token.offset <= source.size() && token.length <= source.size() - token.offset;
+        };
+
+        std::vector<u32> symbols(header.nameCount + 1, K::Interner::c_NoSymbol);
+        for (u32 i = 0; i < header.nameCount; i++) {
+            u32 first = _ReadRecord<u32>(nameData, i);
+            if (first >= header.tokenCount) {
+                return false;
+            }
+            Token token = _ReadRecord<Token>(tokenData, first);
+            if (!inSource(token)) {
+                return false;
+            }
+            symbols[i + 1] = GetSymbols().Intern(source.substr(token.offset, token.length));
+        }
+
+        u32 rewritten = 0;
+        for (u32 i = 0; i < header.tokenCount; i++) {
+            Token token = _ReadRecord<Token>(tokenData, i);
+            bool valid = inSource(token) && token.symbol <= header.nameCount;
+            RewrittenRecord record = {};
+            if (valid && (token.flags & TokenFlags::REWRITTEN)) {
+                valid = rewritten < header.rewrittenCount;
+                if (valid) {
+                    record = _ReadRecord<RewrittenRecord>(rewrittenData, rewritten++);
+                    valid = record.token == i && record.offset <= header.rewrittenBytes && record.length <= header.rewrittenBytes - record.offset;
+                }
+            }
+            if (!valid) {
+                tokens.Clear();
+                return false;
+            }
+
+            token.symbol = symbols[token.symbol];
+            if (token.flags & TokenFlags::REWRITTEN) {
+                tokens.Push(token, std::string_view(textData + record.offset, record.length));
+            } else {
+                tokens.Push(token);
+            }
+        }
+        if (rewritten != header.rewrittenCount) {
+            tokens.Clear();
+            return false;
+        }
+
+        // The modification time doubles as the last use for eviction
+        std::error_code error;
+        std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+        return true;
+    }
+
+    void TokenCache::Store(u64 hash, std::string_view source, const TokenStream& tokens) {
+        EntryHeader header = {};
+        std::memcpy(header.magic, c_Magic, sizeof(c_Magic));
+        header.version = c_FormatVersion;
+        header.fingerprint = RulesFingerprint();
+        header.sourceHash = hash;
+        header.sourceSize = source.size();
+        header.tokenCount = tokens.Size();
+
+        std::vector<Token> entryTokens;
+        entryTokens.reserve(tokens.Size());
+        std::unordered_map<u32, u32> names;
+        std::vector<u32> firstTokens;
+        std::vector<RewrittenRecord> rewritten;
+        std::string text;
+        for (u32 i = 0; i < tokens.Size(); i++) {
+            Token token = tokens[i];
+            if (token.symbol != K::Interner::c_NoSymbol) {
+                auto [it, inserted] = names.emplace(token.symbol, static_cast<u32>(names.size() + 1));
+                if (inserted) {
+                    firstTokens.push_back(i);
+                }
+                token.symbol = it->second;
+            }
+            if (token.flags & TokenFlags::REWRITTEN) {
+                std::string_view content = tokens.Content(i);
+                rewritten.push_back({ i, static_cast<u32>(text.size()), static_cast<u32>(content.size()) });
+                text += content;
+            }
+            entryTokens.push_back(token);
+        }
+        header.nameCount = static_cast<u32>(firstTokens.size());
+        header.rewrittenCount = static_cast<u32>(rewritten.size());
+        header.rewrittenBytes = static_cast<u32>(text.size());
+
+        // Write under a name no other writer will pick, then rename over the entry so readers 
+        // never see a partial file
+        static std::atomic<u64> s_TemporaryCounter = 0;
+        std::string path = _EntryPath(hash, source.size());
+        std::string temporaryPath = path + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + "." +
+            std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()) + "." + std::to_string(s_TemporaryCounter++) + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(entryTokens.data()), entryTokens.size() * sizeof(Token));
+            file.write(reinterpret_cast<const char*>(firstTokens.data()), firstTokens.size() * sizeof(u32));
+            file.write(reinterpret_cast<const char*>(rewritten.data()), rewritten.size() * sizeof(RewrittenRecord));
+            file.write(text.data(), text.size());
+            if (!file) {
+                file.close();
+                std::error_code error;
+                std::filesystem::remove(temporaryPath, error);
+                return;
+            }
+        }
+
+        // Another writer may have stored the same entry, then the size is counted twice until the next listing
+        u64 size = sizeof(header) + entryTokens.size() * sizeof(Token) + firstTokens.size() * sizeof(u32) +
+            rewritten.size() * sizeof(RewrittenRecord) + text.size();
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if (error) {
+            std::filesystem::remove(temporaryPath, error);
+            return;
+        }
+
+        // The directory is only listed again once the running total says it is over the limit
+        {
+            std::lock_guard<std::mutex> lock(m_EvictMutex);
+            m_Bytes += size;
+            if (m_Bytes <= m_MaxBytes) {
+                return;
+            }
+        }
+        _Evict();
+    }
+
+    // Lists the directory to find the real total, which other processes sharing it may have changed
+    void TokenCache::_Evict() {
+        std::lock_guard<std::mutex> lock(m_EvictMutex);
+
+        struct Entry {
+            std::filesystem::file_time_type lastUse;
+            u64 size;
+            std::filesystem::path path;
+        };
+        std::vector<Entry> entries;
+        u64 totalSize = 0;
+
+        std::error_code error;
+        for (auto it = std::filesystem::directory_iterator(m_Directory, error); !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+            if (it->path().extension() != c_Extension) {
+                continue;
+            }
+            std::error_code entryError;
+            u64 size = it->file_size(entryError);
+            std::filesystem::file_time_type lastUse = it->last_write_time(entryError);
+            if (!entryError) {
+                entries.push_back({ lastUse, size, it->path() });
+                totalSize += size;
+            }
+        }
+        if (totalSize > m_MaxBytes) {
+            // Oldest first, another process may already have removed some of them
+            std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.lastUse < b.lastUse; });
+            for (const Entry& entry : entries) {
+                if (totalSize <= m_MaxBytes) {
+                    break;
+                }
+                std::filesystem::remove(entry.path, error);
+                totalSize -= entry.size;
+            }
+        }
+        m_Bytes = totalSize;
+    }
+}
@@ -0,0 +1,310 @@
+#include <tokendump.h>
+#include <tokenizer.h>
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+namespace JR::Tokenizer {
+    constexpr char c_DumpMagic[4] = { 'J', 'R', 'T', 'D' };
+    constexpr size_t c_DumpHeaderSize = 32;
+    constexpr size_t c_DumpFileEntrySize = 32;
+
+    void _PutU32(std::string& out, u32 value) {
+        for (size_t i = 0; i < 4; i++) {
+            out += static_cast<char>(value >> (i * 8));
+        }
+    }
+
+    void _PutU64(std::string& out, u64 value) {
+        for (size_t i = 0; i < 8; i++) {
+            out += static_cast<char>(value >> (i * 8));
+        }
+    }
+
+    void _PutVarint(std::string& out, u32 value) {
+        while (value >= 0x80) {
+            out += static_cast<char>(value | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    u32 _GetU32(const char* data) {
+        u32 value = 0;
+        for (size_t i = 0; i < 4; i++) {
+            value |= u32(static_cast<u8>(data[i])) << (i * 8);
+        }
+        return value;
+    }
+
+    u64 _GetU64(const char* data) {
+        u64 value = 0;
+        for (size_t i = 0; i < 8; i++) {
+            value |= u64(static_cast<u8>(data[i])) << (i * 8);
+        }
+        return value;
+    }
+
+    // Decodes at most 5 bytes, returns false if the varint runs past `end` or is too long
+    inline bool _GetVarint(const u8*& data, const u8* end, u32& value) {
+        value = 0;
+        for (u32 shift = 0; shift < 35 && data < end; shift += 7) {
+            u8 byte = *data++;
+            value |= u32(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /*
+    *   ------------------------------
+    *   Writer
+    *   ------------------------------
+    */
+
+    TokenDumpWriter::TokenDumpWriter() {
+        for (u32 type = 0; type <= TokenType::Values.size(); type++) {
+            _Intern(TokenTypeName(type));
+        }
+        m_TypeCount = static_cast<u32>(m_Strings.size());
+    }
+
+    u32 TokenDumpWriter::_Intern(std::string_view text) {
+        auto it = m_StringIndices.find(text);
+        if (it != m_StringIndices.end()) {
+            return it->second;
+        }
+
+        char* copy = m_Arena.AllocateArray<char>(text.size());
+        std::copy(text.begin(), text.end(), copy);
+        std::string_view stored(copy, text.size());
+        u32 index = static_cast<u32>(m_Strings.size());
+        m_Strings.push_back(stored);
+        m_StringIndices.emplace(stored, index);
+        return index;
+    }
+
+    void TokenDumpWriter::Add(const std::string& filepath, const TokenStream& tokens) {
+        File file;
+        file.path = _Intern(filepath);
+        file.tokenCount = tokens.Size();
+        file.types.reserve(tokens.Size());
+        file.tokens.reserve(tokens.Size() * 6);
+
+        // Deltas are taken modulo 2^32 so any order of tokens round trips
+        u32 previousOffset = 0;
+        SourcePosition previous = { 0, 0 };
+        size_t line = 0;
+        for (u32 i = 0; i < tokens.Size(); i++) {
+            const Token& token = tokens[i];
+            SourcePosition position = tokens.Position(i, line);
+            file.types += static_cast<char>(token.type);
+            _PutVarint(file.tokens, token.offset - previousOffset);
+            _PutVarint(file.tokens, token.length);
+            _PutVarint(file.tokens, position.line - previous.line);
+            _PutVarint(file.tokens, position.line == previous.line ? position.column - previous.column : position.column);
+            _PutVarint(file.tokens, _Intern(tokens.Content(i)));
+            previousOffset = token.offset;
+            previous = position;
+        }
+
+        m_Files.push_back(std::move(file));
+    }
+
+    void TokenDumpWriter::Save(const std::string& filepath) const {
+        u64 offset = c_DumpHeaderSize + m_TypeCount * 4 + m_Files.size() * c_DumpFileEntrySize;
+        std::string directory;
+        for (const File& file : m_Files) {
+            _PutU32(directory, file.path);
+            _PutU32(directory, file.tokenCount);
+            _PutU64(directory, offset);
+            _PutU64(directory, offset + file.types.size());
+            _PutU64(directory, file.tokens.size());
+            offset += file.types.size() + file.tokens.size();
+        }
+        u64 stringTableOffset = offset;
+        u64 fileSize = stringTableOffset + 4 + (m_Strings.size() + 1) * 4;
+        for (std::string_view text : m_Strings) {
+            fileSize += text.size();
+        }
+
+        std::string out;
+        out.reserve(fileSize);
+        out.append(c_DumpMagic, sizeof(c_DumpMagic));
+        _PutU32(out, c_TokenDumpVersion);
+        _PutU32(out, static_cast<u32>(m_Files.size()));
+        _PutU32(out, m_TypeCount);
+        _PutU64(out, stringTableOffset);
+        _PutU64(out, fileSize);
+        for (u32 type = 0; type < m_TypeCount; type++) {
+            _PutU32(out, type);
+        }
+        out += directory;
+        for (const File& file : m_Files) {
+            out += file.types;
+            out += file.tokens;
+        }
+
+        _PutU32(out, static_cast<u32>(m_Strings.size()));
+        u32 blobOffset = 0;
+        for (std::string_view text : m_Strings) {
+            _PutU32(out, blobOffset);
+            blobOffset += static_cast<u32>(text.size());
+        }
+        _PutU32(out, blobOffset);
+        for (std::string_view text : m_Strings) {
+            out += text;
+        }
+
+        std::ofstream file(filepath, std::ios::binary);
+        file.write(out.data(), out.size());
+        if (!file) {
+            throw std::runtime_error("Could not write token dump " + filepath);
+        }
+    }
+
+    /*
+    *   ------------------------------
+    *   Reader
+    *   ------------------------------
+    */
+
+    void TokenDumpReader::Close() {
+        m_File.Close();
+        m_Data = {};
+        m_FileCount = 0;
+        m_TypeCount = 0;
+        m_StringCount = 0;
+        m_StringOffsets = nullptr;
+        m_StringBlob = {};
+    }
+
+    void TokenDumpReader::Open(const std::string& filepath) {
+        Close();
+        m_File.Open(filepath);
+        m_Data = m_File.Data();
+
+        // Validate every offset up front so the accessors only index
+        auto invalid = [this, &filepath](const std::string& reason) {
+            Close();
+            return std::runtime_error("Invalid token dump " + filepath + ": " + reason);
+        };
+        if (m_Data.size() < c_DumpHeaderSize || !std::equal(c_DumpMagic, c_DumpMagic + 4, m_Data.data())) {
+            throw invalid("not a token dump");
+        }
+        if (_GetU32(m_Data.data() + 4) != c_TokenDumpVersion) {
+            throw invalid("unsupported version " + std::to_string(_GetU32(m_Data.data() + 4)));
+        }
+        if (_GetU64(m_Data.data() + 24) != m_Data.size()) {
+            throw invalid("truncated");
+        }
+
+        u64 fileCount = _GetU32(m_Data.data() + 8);
+        u64 typeCount = _GetU32(m_Data.data() + 12);
+        u64 stringTableOffset = _GetU64(m_Data.data() + 16);
+        if (c_DumpHeaderSize + typeCount * 4 + fileCount * c_DumpFileEntrySize > stringTableOffset ||
+            stringTableOffset > m_Data.size() - 4) {
+            throw invalid("bad layout");
+        }
+
+        u64 stringCount = _GetU32(m_Data.data() + stringTableOffset);
+        u64 blobOffset = stringTableOffset + 4 + (stringCount + 1) * 4;
+        if (blobOffset > m_Data.size()) {
+            throw invalid("bad string table");
+        }
+        const char* offsets = m_Data.data() + stringTableOffset + 4;
+        for (u64 i = 0; i < stringCount; i++) {
+            if (_GetU32(offsets + i * 4) > _GetU32(offsets + (i + 1) * 4)) {
+                throw invalid("bad string table");
+            }
+        }
+        if (blobOffset + _GetU32(offsets + stringCount * 4) != m_Data.size()) {
+            throw invalid("bad string table");
+        }
+        m_StringCount = static_cast<u32>(stringCount);
+        m_StringOffsets = reinterpret_cast<const u8*>(offsets);
+        m_StringBlob = m_Data.substr(blobOffset);
+
+        for (u64 type = 0; type < typeCount; type++) {
+            if (_GetU32(m_Data.data() + c_DumpHeaderSize + type * 4) >= m_StringCount) {
+                throw invalid("bad type name");
+            }
+        }
+        m_TypeCount = static_cast<u32>(typeCount);
+        m_FileCount = static_cast<u32>(fileCount);
+        for (u32 i = 0; i < m_FileCount; i++) {
+            FileEntry file = _File(i);
+            if (file.path >= m_StringCount || file.typesOffset > stringTableOffset || file.tokenCount > stringTableOffset - file.typesOffset ||
+                file.tokensOffset > stringTableOffset || file.tokensSize > stringTableOffset - file.tokensOffset || 
+                file.tokensOffset < file.typesOffset + file.tokenCount) {
+                throw invalid("bad file entry");
+            }
+        }
+    }
+
+    TokenDumpReader::FileEntry TokenDumpReader::_File(u32 file) const {
+        const char* entry = m_Data.data() + c_DumpHeaderSize + m_TypeCount * 4 + file * c_DumpFileEntrySize;
+        return { _GetU32(entry), _GetU32(entry + 4), _GetU64(entry + 8), _GetU64(entry + 16), _GetU64(entry + 24) };
+    }
+
+    std::string_view TokenDumpReader::String(u32 index) const {
+        const char* offsets = reinterpret_cast<const char*>(m_StringOffsets);
+        u32 begin = _GetU32(offsets + index * 4);
+        return m_StringBlob.substr(begin, _GetU32(offsets + (index + 1) * 4) - begin);
+    }
+
+    std::string_view TokenDumpReader::FilePath(u32 file) const {
+        return String(_File(file).path);
+    }
+
+    u32 TokenDumpReader::TokenCount(u32 file) const {
+        return _File(file).tokenCount;
+    }
+
+    std::string_view TokenDumpReader::TypeName(u8 type) const {
+        if (type >= m_TypeCount) {
+            return "";
+        }
+        return String(_GetU32(m_Data.data() + c_DumpHeaderSize + type * 4));
+    }
+
+    std::string_view TokenDumpReader::Types(u32 file) const {
+        FileEntry entry = _File(file);
+        return m_Data.substr(entry.typesOffset, entry.tokenCount);
+    }
+
+    TokenDumpReader::Cursor TokenDumpReader::Tokens(u32 file) const {
+        FileEntry entry = _File(file);
+        Cursor cursor;
+        cursor.m_Reader = this;
+        cursor.m_Types = m_Data.substr(entry.typesOffset, entry.tokenCount);
+        cursor.m_Data = reinterpret_cast<const u8*>(m_Data.data() + entry.tokensOffset);
+        cursor.m_End = cursor.m_Data + entry.tokensSize;
+        return cursor;
+    }
+
+    bool TokenDumpReader::Cursor::Next(DumpToken& token) {
+        if (m_Index >= m_Types.size()) {
+            return false;
+        }
+
+        u32 offsetDelta, length, lineDelta, column, content;
+        if (!_GetVarint(m_Data, m_End, offsetDelta) || !_GetVarint(m_Data, m_End, length) || !_GetVarint(m_Data, m_End, lineDelta) ||
+            !_GetVarint(m_Data, m_End, column) || !_GetVarint(m_Data, m_End, content) || content >= m_Reader->m_StringCount) {
+            m_Index = static_cast<u32>(m_Types.size());
+            return false;
+        }
+
+        token.type = static_cast<u8>(m_Types[m_Index++]);
+        token.offset = m_Previous.offset + offsetDelta;
+        token.length = length;
+        token.line = m_Previous.line + lineDelta;
+        token.column = lineDelta == 0 ? m_Previous.column + column : column;
+        token.content = m_Reader->String(content);
+        m_Previous = token;
+        return true;
+    }
+}
@@ -1,8 +1,16 @@
 #include <tokenizer.h>
+#include <tokencache.h>
+#include <words.h>
+#include <source.h>
 #include <log.h>
+#include <klib/kscan.h>
+#include <klib/kthreadpool.h>
 
-#include <fstream>
+#include <algorithm>
+#include <charconv>
+#include <limits>
 #include <regex>
+#include <string_view>
 
 namespace JR::Tokenizer {
     std::string toRegex(std::string in) {
@@ -10,25 +18,7 @@ namespace JR::Tokenizer {
         return "^(" + in + ")";
     }
 
-    // Turn the above array into a regex pattern
-    std::string keywords = R"(
-        use|exposing|as|
-        fun|let|const|
-        class|private|protected|public|open|static|
-        init|constructor|
-        for|in|if|else|while|
-        sizeof|type|
-        in|nullptr|
-        return
-    )";
-
-    std::string types = R"(
-        void|bool|string|
-        uchar|ushort|uint|ulong|
-        char|short|int|long|
-        float|double
-    )";
-
+    // Reserved words are classified through the table in words.h, the operator regex only covers symbols
     std::string operators = R"(
         (\.\.\.)|(\.)|(::)|
         (\>\>\=)|(\<\<\=)|(\+\=)|(\-\=)|(\*\=)|(\/\=)|(\%\=)|(\&\=)|(\|\=)|(\^\=)|(\~\=)|
@@ -36,178 +26,828 @@ namespace JR::Tokenizer {
         (\<\<)|(\>\>)|
         (\+)|(\-)|(\*)|(\/)|(\%)|
         (\=)|(\!)|(\<)|(\>)|(\&)|(\|)|(\^)|(\~)|
-        (\?)|(:)|(new)|(delete)
+        (\?)|(:)
     )";
 
-    typedef std::pair<std::regex, TokenType::Enum> Rule;
-    const std::vector<Rule> s_Rules = {
-        { std::regex("^(\\/\\/.*)(?:\r?\n|\r|$)"),                  TokenType::COMMENT},
-        { std::regex("^(\\/\\*[\\s\\S]*?\\*\\/)"),                  TokenType::COMMENT},
-        { std::regex("^(\r?\n)"),                                   TokenType::NEWLINE},
-        { std::regex("^([ \\t\\r\\f\\v]+)"),                        TokenType::WHITESPACE},
-        { std::regex("^\"([^\"]*)\""),                              TokenType::STRING_LITERAL},
-        { std::regex("^'([^']|\\\\')'"),                            TokenType::CHAR_LITERAL},
-        { std::regex("^(([0-9]+)\\.[0-9]+f?)"),                     TokenType::FLOAT_LITERAL},
-        { std::regex("^(0x[0-9a-fA-F]+)"),                          TokenType::INTEGER_LITERAL},
-        { std::regex("^(0b[01]+)"),                                 TokenType::INTEGER_LITERAL},
-        { std::regex("^([0-9]+)"),                                  TokenType::INTEGER_LITERAL},
-        { std::regex("^(true|false)"),                             TokenType::BOOLEAN_LITERAL},
-        { std::regex("^(^[a-zA-Z_][a-zA-Z0-9_]*)"),                TokenType::IDENTIFIER},
-        { std::regex(toRegex(operators)),                       TokenType::OPERATOR},
-        { std::regex("^(;)"),                                       TokenType::SEMICOLON},
-        { std::regex("^(,)"),                                       TokenType::SEPERATOR},
-        { std::regex("^(\\()"),                                     TokenType::OPEN_PARAM},
-        { std::regex("^(\\))"),                                     TokenType::CLOSE_PARAM},
-        { std::regex("^(\\{)"),                                     TokenType::OPEN_SCOPE},
-        { std::regex("^(\\})"),                                     TokenType::CLOSE_SCOPE},
-        { std::regex("^(\\[)"),                                     TokenType::OPEN_BRACKET},
-        { std::regex("^(\\])"),                                     TokenType::CLOSE_BRACKET},
-        { std::regex("^(\\<)"),                                     TokenType::OPEN_ANGLE},
-        { std::regex("^(\\>)"),                                     TokenType::CLOSE_ANGLE}
+    // The rule patterns are kept as text too, RulesFingerprint() hashes them
+    typedef std::pair<std::string, TokenType::Enum> RuleDefinition;
+    const std::vector<RuleDefinition> s_RuleDefinitions = {
+        { "^(\\/\\/.*)(?:\r?\n|\r|$)",                  TokenType::COMMENT},
+        { "^(\\/\\*[\\s\\S]*?\\*\\/)",                  TokenType::COMMENT},
+        { "^(\r?\n)",                                   TokenType::NEWLINE},
+        { "^([ \\t\\r\\f\\v]+)",                        TokenType::WHITESPACE},
+        { "^\"([^\"]*)\"",                              TokenType::STRING_LITERAL},
+        { "^'([^']|\\\\')'",                            TokenType::CHAR_LITERAL},
+        { "^(([0-9]+)\\.[0-9]+f?)",                     TokenType::FLOAT_LITERAL},
+        { "^(0x[0-9a-fA-F]+)",                          TokenType::INTEGER_LITERAL},
+        { "^(0b[01]+)",                                 TokenType::INTEGER_LITERAL},
+        { "^([0-9]+)",                                  TokenType::INTEGER_LITERAL},
+        { "^(true|false)",                             TokenType::BOOLEAN_LITERAL},
+        { "^(^[a-zA-Z_][a-zA-Z0-9_]*)",                TokenType::IDENTIFIER},
+        { toRegex(operators),                       TokenType::OPERATOR},
+        { "^(;)",                                       TokenType::SEMICOLON},
+        { "^(,)",                                       TokenType::SEPERATOR},
+        { "^(\\()",                                     TokenType::OPEN_PARAM},
+        { "^(\\))",                                     TokenType::CLOSE_PARAM},
+        { "^(\\{)",                                     TokenType::OPEN_SCOPE},
+        { "^(\\})",                                     TokenType::CLOSE_SCOPE},
+        { "^(\\[)",                                     TokenType::OPEN_BRACKET},
+        { "^(\\])",                                     TokenType::CLOSE_BRACKET},
+        { "^(\\<)",                                     TokenType::OPEN_ANGLE},
+        { "^(\\>)",                                     TokenType::CLOSE_ANGLE}
     };
 
+    typedef std::pair<std::regex, TokenType::Enum> Rule;
+
+    // Compiled by the first regex lex rather than at startup, most runs only use the DFA engine
+    const std::vector<Rule>& rules() {
+        static const std::vector<Rule> s_Rules = [] {
+            std::vector<Rule> rules;
+            for (const RuleDefinition& definition : s_RuleDefinitions) {
+                rules.emplace_back(std::regex(definition.first), definition.second);
+            }
+            return rules;
+        }();
+        return s_Rules;
+    }
+
     /*
     *   ------------------------------
-    *   Tokenizer constants
+    *   Tokenizer internal functions
     *   ------------------------------
     */
-    bool m_Initialized = false;
-    
-    std::string m_Filepath = "";
-    std::string m_Content = "";
 
-    size_t m_Line = 1;
-    size_t m_Col = 1;
-    size_t m_Index = 0;
+    /**
+     * @brief The result of matching a single rule at m_Index, shared by both lexer engines
+     * 
+     */
+    struct RuleMatch {
+        TokenType::Enum type;
+        size_t length;          // Number of bytes consumed from the input
+        size_t contentStart;    // Offset of the captured content relative to m_Index
+        size_t contentLength;   // Length of the captured content
+    };
 
-    Ref<Token> m_CurrentToken = nullptr;
+    bool _MatchRegex(std::string_view uneaten, RuleMatch& out) {
+        // match_continuous anchors every rule at the cursor, so a failing rule never scans ahead
+        std::cmatch match;
+        for (const auto& rule : rules()) {
+            if (std::regex_search(uneaten.data(), uneaten.data() + uneaten.size(), match, rule.first, std::regex_constants::match_continuous)) {
+                out.type = rule.second;
+                out.length = match[0].length();
+                out.contentStart = match.position(1);
+                out.contentLength = match[1].length();
+                return true;
+            }
+        }
+
+        return false;
+    }
 
     /*
-    *   ------------------------------
-    *   Tokenizer internal functions
-    *   ------------------------------
+    *   The DFA engine dispatches on the first byte of the uneaten input and walks the
+    *   rest of the token by hand. It must accept exactly what s_Rules accepts, in the
+    *   same priority order, so the two engines can be cross-checked against each other.
     */
-    Ref<Token> _ReadToken() {
-        if (m_Index >= m_Content.size()) {
-            return nullptr;
-        }
-
-        Ref<Token> token = CreateRef<Token>();
-
-        token->content = "";
-        token->line = m_Line;
-        token->column = m_Col;
-
-        std::smatch match;
-        std::string uneatenContent(m_Content.begin() + m_Index, m_Content.end());
-        for (const auto& rule : s_Rules) {
-            if (std::regex_search(uneatenContent, match, rule.first)) {
-                token->content = match[1];
-                token->type = rule.second;
-
-                m_Index += match[0].length();
-                m_Col += match[0].length();
-
-                // Update line and column for newlines in multi-line comments
-                if (token->type == TokenType::COMMENT) {
-                    std::string fullCapture = std::string(match[0]);
-                    size_t newlines = std::count(fullCapture.begin(), fullCapture.end(), '\n');
-                    if (newlines > 0) {
-                        m_Line += newlines;
-                        m_Col = fullCapture.size() - fullCapture.find_last_of('\n');
-                    }
+    inline bool _IsDigit(char c) { return c >= '0' && c <= '9'; }
+    inline bool _IsHexDigit(char c) { return _IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+    inline bool _IsIdentStart(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+    inline bool _IsIdentChar(char c) { return _IsIdentStart(c) || _IsDigit(c); }
+    inline bool _IsBlank(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v'; }
+
+    // Most runs are a few bytes long, only runs that outlast a vector width go to the SIMD scanner
+    template<typename Predicate>
+    inline size_t _ScanRun(const char* s, size_t available, Predicate predicate, size_t (*scanner)(const char*, size_t)) {
+        constexpr size_t c_ScalarPrefix = 16;
+        size_t end = 1;
+        while (end < available && end < c_ScalarPrefix && predicate(s[end])) {
+            end++;
+        }
+        if (end == c_ScalarPrefix) {
+            end += scanner(s + end, available - end);
+        }
+        return end;
+    }
 
-                    return _ReadToken();
-                }
+    size_t _MatchOperatorLength(const char* s, size_t available) {
+        char c0 = s[0];
+        char c1 = available > 1 ? s[1] : '\0';
+        char c2 = available > 2 ? s[2] : '\0';
+
+        switch (c0) {
+            case '.': return (c1 == '.' && c2 == '.') ? 3 : 1;
+            case ':': return c1 == ':' ? 2 : 1;
+            case '>': 
+            case '<':
+                if (c1 == c0) return c2 == '=' ? 3 : 2;
+                return c1 == '=' ? 2 : 1;
+            case '+':
+            case '-':
+                return (c1 == '=' || c1 == c0) ? 2 : 1;
+            case '&':
+            case '|':
+                return (c1 == '=' || c1 == c0) ? 2 : 1;
+            case '*': case '/': case '%': case '^': case '~': case '=': case '!':
+                return c1 == '=' ? 2 : 1;
+            case '?': return 1;
+        }
+        return 0;
+    }
 
-                // Ignore non-newline whitespace
-                if (token->type == TokenType::WHITESPACE) {
-                    return _ReadToken();
+    bool _MatchDFA(std::string_view uneaten, RuleMatch& out) {
+        const char* s = uneaten.data();
+        const size_t available = uneaten.size();
+        auto at = [&](size_t i) -> char { return i < available ? s[i] : '\0'; };
+
+        out.contentStart = 0;
+        char c = s[0];
+        switch (c) {
+            case '/': {
+                if (at(1) == '/') {
+                    size_t end = 2 + K::Scan::FindLineEnd(s + 2, available - 2);
+                    out.type = TokenType::COMMENT;
+                    out.contentLength = end;
+                    if (end < available) {
+                        end += (s[end] == '\r' && at(end + 1) == '\n') ? 2 : 1;
+                    }
+                    out.length = end;
+                    return true;
                 }
-
-                // Update line and column for newlines
-                if (token->type == TokenType::NEWLINE) {
-                    token->content = ""; // Content is empty for newlines, since it's just a line break
-
-                    m_Line++;
-                    m_Col = 1;
-
-                    // We only need to tokenize one newline in a row (i.e. skip multiple newlines)
-                    // This is because newline may indicate the end of a statement in the parser
-                    // but we don't care about multiple in a row. We also dont care about newlines 
-                    // following a semicolon, since they are not significant.
-                    if (m_CurrentToken == nullptr || 
-                        (m_CurrentToken->type == TokenType::NEWLINE || m_CurrentToken->type == TokenType::SEMICOLON)
-                    ) {
-                        return _ReadToken();
+                if (at(1) == '*') {
+                    size_t close = 2 + K::Scan::FindBlockCommentEnd(s + 2, available - 2);
+                    if (close < available) {
+                        out.type = TokenType::COMMENT;
+                        out.length = out.contentLength = close + 2;
+                        return true;
                     }
                 }
+                break;
+            }
+            case '\n': {
+                out.type = TokenType::NEWLINE;
+                out.length = out.contentLength = 1;
+                return true;
+            }
+            case '\r':
+            case ' ': case '\t': case '\f': case '\v': {
+                if (c == '\r' && at(1) == '\n') {
+                    out.type = TokenType::NEWLINE;
+                    out.length = out.contentLength = 2;
+                    return true;
+                }
+                size_t end = _ScanRun(s, available, _IsBlank, K::Scan::SkipBlanks);
+                out.type = TokenType::WHITESPACE;
+                out.length = out.contentLength = end;
+                return true;
+            }
+            case '"': {
+                size_t close = std::string_view(s, available).find('"', 1);
+                if (close == std::string_view::npos) {
+                    return false;
+                }
+                out.type = TokenType::STRING_LITERAL;
+                out.length = close + 1;
+                out.contentStart = 1;
+                out.contentLength = close - 1;
+                return true;
+            }
+            case '\'': {
+                if (available < 3 || s[1] == '\'' || s[2] != '\'') {
+                    return false;
+                }
+                out.type = TokenType::CHAR_LITERAL;
+                out.length = 3;
+                out.contentStart = 1;
+                out.contentLength = 1;
+                return true;
+            }
+            case '0': case '1': case '2': case '3': case '4':
+            case '5': case '6': case '7': case '8': case '9': {
+                size_t end = 1;
+                while (end < available && _IsDigit(s[end])) {
+                    end++;
+                }
 
-                // Convert hex and binary literals to base10
-                if (token->type == TokenType::INTEGER_LITERAL) {
-                    if (token->content.find("0x") != std::string::npos) {
-                        token->content = std::to_string(std::stoul(token->content.substr(2), nullptr, 16));
-                    } else if (token->content.find("0b") != std::string::npos) {
-                        token->content = std::to_string(std::stoul(token->content.substr(2), nullptr, 2));
+                if (at(end) == '.' && _IsDigit(at(end + 1))) {
+                    end += 2;
+                    while (end < available && _IsDigit(s[end])) {
+                        end++;
                     }
+                    if (at(end) == 'f') {
+                        end++;
+                    }
+                    out.type = TokenType::FLOAT_LITERAL;
+                    out.length = out.contentLength = end;
+                    return true;
                 }
 
-                // If we see an identifier, check if the entire content is present in the keywords or types regex
-                if (token->type == TokenType::IDENTIFIER) {
-                    if (std::regex_match(token->content, std::regex(toRegex(keywords)))) {
-                        token->type = TokenType::KEYWORD;
-                    } else if (std::regex_match(token->content, std::regex(toRegex(types)))) {
-                        token->type = TokenType::TYPE;
-                    } else if (std::regex_match(token->content, std::regex(toRegex(operators)))) {
-                        token->type = TokenType::OPERATOR;
+                out.type = TokenType::INTEGER_LITERAL;
+                if (c == '0' && at(1) == 'x' && _IsHexDigit(at(2))) {
+                    end = 3;
+                    while (end < available && _IsHexDigit(s[end])) {
+                        end++;
+                    }
+                } else if (c == '0' && at(1) == 'b' && (at(2) == '0' || at(2) == '1')) {
+                    end = 3;
+                    while (end < available && (s[end] == '0' || s[end] == '1')) {
+                        end++;
                     }
                 }
+                out.length = out.contentLength = end;
+                return true;
+            }
+            case ';': out.type = TokenType::SEMICOLON;      out.length = out.contentLength = 1; return true;
+            case ',': out.type = TokenType::SEPERATOR;      out.length = out.contentLength = 1; return true;
+            case '(': out.type = TokenType::OPEN_PARAM;     out.length = out.contentLength = 1; return true;
+            case ')': out.type = TokenType::CLOSE_PARAM;    out.length = out.contentLength = 1; return true;
+            case '{': out.type = TokenType::OPEN_SCOPE;     out.length = out.contentLength = 1; return true;
+            case '}': out.type = TokenType::CLOSE_SCOPE;    out.length = out.contentLength = 1; return true;
+            case '[': out.type = TokenType::OPEN_BRACKET;   out.length = out.contentLength = 1; return true;
+            case ']': out.type = TokenType::CLOSE_BRACKET;  out.length = out.contentLength = 1; return true;
+        }
+
+        if (_IsIdentStart(c)) {
+            // The boolean rule is ordered before identifiers and is not word bounded
+            std::string_view rest(s, available);
+            if (rest.compare(0, 4, "true") == 0 || rest.compare(0, 5, "false") == 0) {
+                out.type = TokenType::BOOLEAN_LITERAL;
+                out.length = out.contentLength = (c == 't') ? 4 : 5;
+                return true;
+            }
+
+            size_t end = _ScanRun(s, available, _IsIdentChar, K::Scan::SkipIdentChars);
+            out.type = TokenType::IDENTIFIER;
+            out.length = out.contentLength = end;
+            return true;
+        }
+
+        size_t operatorLength = _MatchOperatorLength(s, available);
+        if (operatorLength > 0) {
+            out.type = TokenType::OPERATOR;
+            out.length = out.contentLength = operatorLength;
+            return true;
+        }
+
+        return false;
+    }
+
+    /*
+    *   Numeric literals are decoded in place with std::from_chars, no copies and no exceptions. 
+    *   The lexer has already checked the syntax, so only the range can fail.
+    */
+    inline int _IntegerBase(std::string_view digits) {
+        if (digits.size() > 2 && digits[0] == '0') {
+            if (digits[1] == 'x') return 16;
+            if (digits[1] == 'b') return 2;
+        }
+        return 10;
+    }
+
+    bool _DecodeInteger(std::string_view digits, int base, u64& value) {
+        if (base != 10) {
+            digits.remove_prefix(2);
+        }
+        return std::from_chars(digits.data(), digits.data() + digits.size(), value, base).ec == std::errc();
+    }
+
+    bool _DecodeFloat(std::string_view digits, double& value) {
+        return std::from_chars(digits.data(), digits.data() + digits.size(), value, std::chars_format::fixed).ec == std::errc();
+    }
+
+    /*
+    *   A match at the end of a streamed window may change once more input is in: a run can 
+    *   continue, an operator or float needs a few bytes of lookahead, and an unterminated 
+    *   literal or block comment may be closed by the next chunk. Such a match is retried with 
+    *   the next chunk appended, a match this far from the end has seen every byte it depends on.
+    */
+    constexpr size_t c_StreamLookahead = 8;
+
+    // Streamed tokens are dropped in batches of this many, one TokenStream block
+    constexpr u32 c_StreamedTokens = 4096;
+
+    bool _NeedsMoreInput(std::string_view uneaten, bool matched, const RuleMatch& match) {
+        if (!matched) {
+            return uneaten[0] == '\"' || (uneaten[0] == '\'' && uneaten.size() < 3);
+        }
+        // An unterminated block comment falls back to the `/` operator
+        if (match.type == TokenType::OPERATOR && uneaten[0] == '/' && uneaten.size() > 1 && uneaten[1] == '*') {
+            return true;
+        }
+        return match.length + c_StreamLookahead >= uneaten.size();
+    }
+
+    TokenRef Lexer::_ReadToken() {
+        // Comments, whitespace and collapsed newlines are skipped in this loop without 
+        // touching the token stream, only a real token is pushed
+        while (m_Index < m_End || (m_Streaming && _Refill())) {
+            Token token = {};
+            token.offset = m_OffsetBase + static_cast<u32>(m_Index);
+
+            // A non-owning view of the input that has not been tokenized yet
+            std::string_view uneaten = m_Content.substr(m_Index);
+            RuleMatch match;
+            bool matched = (m_Engine == LexerEngine::REGEX) ? _MatchRegex(uneaten, match) : _MatchDFA(uneaten, match);
+            if (m_Streaming && !m_Stream.AtEnd() && _NeedsMoreInput(uneaten, matched, match)) {
+                // Match again even if the input ended, the window may have moved
+                _Refill();
+                continue;
+            }
+            if (!matched) {
+                if (uneaten[0] == '\"') {
+                    throw _Error("Unterminated string literal", m_Index);
+                } else if (uneaten[0] == '\'') {
+                    throw _Error("Invalid or unterminated char literal", m_Index);
+                }
+                throw _Error("Unknown symbol", m_Index);
+            }
 
-                return token;
+            std::string_view content = uneaten.substr(match.contentStart, match.contentLength);
+            token.type = match.type;
+            token.length = static_cast<u32>(match.length);
+
+            size_t start = m_Index;
+            m_Index += match.length;
+
+            // Ignore comments and non-newline whitespace
+            if (token.type == TokenType::COMMENT || token.type == TokenType::WHITESPACE) {
+                _SkipTrivia(token);
+                continue;
             }
+
+            if (token.type == TokenType::NEWLINE) {
+                // We only need to tokenize one newline in a row (i.e. skip multiple newlines)
+                // This is because newline may indicate the end of a statement in the parser
+                // but we don't care about multiple in a row. We also dont care about newlines 
+                // following a semicolon, since they are not significant.
+                if (m_CollapseNewlines && (!m_CurrentToken || 
+                    (m_CurrentToken->type == TokenType::NEWLINE || m_CurrentToken->type == TokenType::SEMICOLON))
+                ) {
+                    _SkipTrivia(token);
+                    continue;
+                }
+            }
+
+            // Numeric literals are decoded once here, hex and binary ones are also rewritten in base 10.
+            // A literal that does not decode leaves the lexer on it, like any other lex error, so a 
+            // parallel chunk stops there and stitching lexes into the same error again.
+            if (token.type == TokenType::INTEGER_LITERAL) {
+                int base = _IntegerBase(content);
+                if (!_DecodeInteger(content, base, token.value.integer)) {
+                    m_Index = start;
+                    throw _Error("Integer literal does not fit in 64 bits", start);
+                }
+
+                if (base != 10) {
+                    char digits[std::numeric_limits<u64>::digits10 + 1];
+                    char* end = std::to_chars(std::begin(digits), std::end(digits), token.value.integer).ptr;
+                    return m_Tokens.At(m_Tokens.Push(token, std::string_view(digits, end - digits)));
+                }
+            } else if (token.type == TokenType::FLOAT_LITERAL) {
+                if (content.back() == 'f') {
+                    token.flags |= TokenFlags::SUFFIX_F;
+                    content.remove_suffix(1);
+                }
+                if (!_DecodeFloat(content, token.value.real)) {
+                    m_Index = start;
+                    throw _Error("Float literal is out of range", start);
+                }
+            }
+
+            // If we see an identifier, check if the entire content is a keyword, type or word operator
+            if (token.type == TokenType::IDENTIFIER) {
+                token.type = ClassifyWord(content);
+                if (token.type != TokenType::OPERATOR) {
+                    token.symbol = _InternSymbol(content);
+                }
+            }
+
+            return m_Tokens.At(m_Tokens.Push(token));
+        }
+
+        return TokenRef();
+    }
+
+    TokenizerException Lexer::_Error(const char* description, size_t index) const {
+        // Positions are only looked up for diagnostics, through the stream's line index
+        SourcePosition position = m_Tokens.PositionOf(m_OffsetBase + static_cast<u32>(index));
+        return TokenizerException(m_Filepath, description, position.line, position.column);
+    }
+
+    bool Lexer::_Refill() {
+        // The kept tokens view the window, their bytes stay along with the uneaten input
+        u64 windowBegin = m_Stream.Begin();
+        u64 index = windowBegin + m_Index;
+        u64 keep = index;
+        if (!m_Tokens.Empty()) {
+            keep = std::min<u64>(keep, windowBegin + static_cast<u32>(m_Tokens[0].offset - m_OffsetBase));
         }
+        m_Stream.Release(keep);
+
+        // Positions in the new window continue from the bytes dropped ahead of it
+        std::string_view dropped = m_Content.substr(0, static_cast<size_t>(keep - windowBegin));
+        size_t newlines = K::Scan::CountNewlines(dropped.data(), dropped.size());
+        if (newlines > 0) {
+            m_Origin.line += static_cast<u32>(newlines);
+            m_Origin.column = static_cast<u32>(dropped.size() - dropped.rfind('\n'));
+        } else {
+            m_Origin.column += static_cast<u32>(dropped.size());
+        }
+        bool appended = m_Stream.ReadChunk();
+
+        m_Content = m_Stream.Data();
+        m_Index = static_cast<size_t>(index - m_Stream.Begin());
+        m_End = m_Content.size();
+        m_OffsetBase = static_cast<u32>(m_Stream.Begin());
+        m_Tokens.SetSource(m_Content, m_OffsetBase, m_Origin);
+
+        // Cached names viewed the old window
+        std::fill(m_SymbolCache.begin(), m_SymbolCache.end(), SymbolCacheEntry());
+        return appended;
+    }
+
+    TokenRef Lexer::_DropStreamedTokens(TokenRef keep) {
+        Token token = *keep;
+        std::string rewritten = (token.flags & TokenFlags::REWRITTEN) ? std::string(keep.Content()) : std::string();
+
+        m_Tokens.Clear();
+        u32 index = (token.flags & TokenFlags::REWRITTEN) ? m_Tokens.Push(token, rewritten) : m_Tokens.Push(token);
+        return m_Tokens.At(index);
+    }
 
-        if (uneatenContent[0] == '\"') {
-            throw TokenizerException(m_Filepath, "Unterminated string literal", m_Line, m_Col);
-        } else if (uneatenContent[0] == '\'') {
-            throw TokenizerException(m_Filepath, "Invalid or unterminated char literal", m_Line, m_Col);
+    u32 Lexer::_InternSymbol(std::string_view name) {
+        // Names repeat a lot within a file, the cache answers most of them without touching the shared table
+        if (m_SymbolCache.empty()) {
+            m_SymbolCache.resize(c_SymbolCacheSize);
+        }
+
+        u64 hash = K::Interner::Hash(name);
+        SymbolCacheEntry& entry = m_SymbolCache[hash & (c_SymbolCacheSize - 1)];
+        if (entry.symbol == K::Interner::c_NoSymbol || entry.name != name) {
+            entry = { name, GetSymbols().Intern(name, hash) };
+        }
+        return entry.symbol;
+    }
+
+    void Lexer::_SkipTrivia(const Token& token) {
+        if (m_KeepTrivia) {
+            m_Trivia.push_back({ token.type, token.offset, token.length });
         }
-        throw TokenizerException(m_Filepath, "Unknown symbol", m_Line, m_Col);
     }
 
     /*
     *   ------------------------------
-    *   Tokenizer API functions
+    *   Lexer API functions
     *   ------------------------------
     */
 
-    void Init(std::string filepath) {
-        auto file = std::ifstream(filepath);
-        if (!file.is_open()) {
-            throw std::runtime_error("Could not open input file " + filepath);
-        }
+    void Lexer::Init(std::string filepath, LexerEngine::Enum engine) {
+        m_Source.Open(filepath);
+        m_Content = m_Source.Data();
+        m_End = m_Content.size();
+        m_Filepath = filepath;
+        m_Engine = engine;
+        m_Tokens.SetSource(m_Content);
 
-        m_Content = std::string(
-            (std::istreambuf_iterator<char>(file)), 
-            std::istreambuf_iterator<char>()
-        );
+        m_CurrentToken = _ReadToken();
+        m_Initialized = true;
+    }
+
+    void Lexer::InitBuffer(std::string filepath, std::string_view text, LexerEngine::Enum engine) {
+        m_Source.Assign(text);
+        m_Content = m_Source.Data();
+        m_End = m_Content.size();
         m_Filepath = filepath;
+        m_Engine = engine;
+        m_Tokens.SetSource(m_Content);
 
         m_CurrentToken = _ReadToken();
         m_Initialized = true;
     }
 
-    void Reset() {
+    void Lexer::InitStream(std::string filepath, LexerEngine::Enum engine, size_t chunkSize) {
+        m_Stream.Open(filepath, chunkSize);
+        m_Streaming = true;
+        m_KeepTrivia = false;
+        m_Content = {};
+        m_Index = m_End = 0;
+        m_OffsetBase = 0;
+        m_Origin = {};
+        m_Filepath = filepath;
+        m_Engine = engine;
+        m_Tokens.SetSource(m_Content);
+
+        // _ReadToken reads the first chunk
+        m_CurrentToken = _ReadToken();
+        m_Initialized = true;
+    }
+
+    void Lexer::InitParallel(std::string filepath, K::ThreadPool& pool, LexerEngine::Enum engine, size_t chunkSize) {
+        m_Source.Open(filepath);
+        m_Content = m_Source.Data();
+        m_End = m_Content.size();
+        m_Filepath = filepath;
+        m_Engine = engine;
+        m_Tokens.SetSource(m_Content);
+
+        // Files unchanged since they were last lexed are loaded instead
+        bool cached = m_TokenCache && !m_KeepTrivia;
+        u64 sourceHash = cached ? TokenCache::Hash(m_Content) : 0;
+        if (cached && m_TokenCache->Load(sourceHash, m_Content, m_Tokens)) {
+            m_Index = m_End;
+            m_CurrentToken = m_Tokens.Empty() ? TokenRef() : m_Tokens.At(0);
+            m_Initialized = true;
+            return;
+        }
+
+        // Split after the first newline at or past every multiple of the chunk size
+        std::vector<size_t> boundaries = { 0 };
+        for (size_t target = chunkSize; target < m_Content.size(); target = boundaries.back() + chunkSize) {
+            size_t newline = m_Content.find('\n', target);
+            if (newline == std::string_view::npos || newline + 1 >= m_Content.size()) {
+                break;
+            }
+            boundaries.push_back(newline + 1);
+        }
+        boundaries.push_back(m_Content.size());
+
+        // Every chunk is lexed speculatively as if it started on a fresh line. A chunk that 
+        // really starts inside a comment or literal, or fails to lex, is repaired by _Stitch.
+        std::vector<std::unique_ptr<Lexer>> chunks;
+        std::vector<K::ThreadPool::Task> tasks;
+        for (size_t i = 0; i + 1 < boundaries.size(); i++) {
+            chunks.push_back(std::make_unique<Lexer>());
+            Lexer& chunk = *chunks.back();
+            chunk.m_Content = m_Content;
+            chunk.m_Filepath = m_Filepath;
+            chunk.m_Engine = engine;
+            chunk.m_Index = boundaries[i];
+            chunk.m_End = boundaries[i + 1];
+            chunk.m_CollapseNewlines = false;
+            chunk.m_KeepTrivia = m_KeepTrivia;
+            chunk.m_Tokens.SetSource(m_Content);
+
+            tasks.push_back([&chunk]() {
+                try {
+                    while (chunk._ReadToken()) {}
+                } catch (std::exception& e) {
+                    // The chunk stops at the failure, _Stitch relexes from there with the real state
+                }
+            });
+        }
+        pool.RunBatch(std::move(tasks));
+
+        _Stitch(chunks, boundaries);
+        if (cached) {
+            m_TokenCache->Store(sourceHash, m_Content, m_Tokens);
+        }
+        m_CurrentToken = m_Tokens.Empty() ? TokenRef() : m_Tokens.At(0);
+        m_Initialized = true;
+    }
+
+    void Lexer::Edit(size_t offset, size_t removedLength, std::string_view insertedText) {
+        if (!m_Initialized) {
+            throw std::runtime_error("Tokenizer not initialized");
+        }
+        if (m_Streaming) {
+            throw std::runtime_error("Streamed input cannot be edited");
+        }
+        if (offset > m_Content.size() || removedLength > m_Content.size() - offset) {
+            throw std::out_of_range("Edit range is outside of the source buffer");
+        }
+
+        // Lex the rest of the old buffer so there is a complete stream to resync against. 
+        // A lex error stops it early, the lexing after the edit runs into it again.
+        try {
+            while (TokenRef token = _ReadToken()) {
+                m_CurrentToken = token;
+            }
+        } catch (TokenizerException& e) {}
+        size_t oldIndex = m_Index;
+
+        // Restart from the token before the first one reaching the edit, since a token 
+        // looks up to two bytes past its end (e.g. "1." only becomes a float before a digit)
+        u32 size = m_Tokens.Size();
+        u32 low = 0, high = size;
+        while (low < high) {
+            u32 middle = low + (high - low) / 2;
+            if (m_Tokens[middle].offset + m_Tokens[middle].length < offset) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        u32 restart = low > 0 ? low - 1 : 0;
+
+        // Closing an unterminated "/*" turns everything from the opener on into a comment. 
+        // The opener was lexed as the operators "/" and "*" and may be anywhere before the edit, 
+        // including at the restart token itself.
+        std::string junction = std::string(offset > 0 ? m_Content.substr(offset - 1, 1) : "") + std::string(insertedText) + 
+            std::string(m_Content.substr(offset + removedLength, 1));
+        if (junction.find("*/") != std::string::npos) {
+            for (u32 i = 0; i <= restart && i + 1 < size; i++) {
+                const Token& slash = m_Tokens[i];
+                const Token& star = m_Tokens[i + 1];
+                if (slash.type == TokenType::OPERATOR && slash.length == 1 && m_Content[slash.offset] == '/' &&
+                    star.type == TokenType::OPERATOR && star.offset == slash.offset + 1 && m_Content[star.offset] == '*'
+                ) {
+                    restart = i;
+                    break;
+                }
+            }
+        }
+        bool fromStart = low == 0;
+        size_t restartOffset = fromStart ? 0 : m_Tokens[restart].offset;
+
+        m_Source.Replace(offset, removedLength, insertedText);
+        m_Content = m_Source.Data();
+        m_End = m_Content.size();
+        m_Tokens.SetSource(m_Content);
+
+        // Relex from the restart point with the state sequential lexing had there, seeding 
+        // the token before it so newline collapsing sees the same previous token
+        Lexer relexer;
+        relexer.m_Content = m_Content;
+        relexer.m_Filepath = m_Filepath;
+        relexer.m_Engine = m_Engine;
+        relexer.m_KeepTrivia = m_KeepTrivia;
+        relexer.m_Tokens.SetSource(m_Content);
+        relexer.m_Index = restartOffset;
+        relexer.m_End = m_End;
+        if (restart > 0) {
+            Token previous = m_Tokens[restart - 1];
+            previous.flags = TokenFlags::NONE;
+            relexer.m_CurrentToken = relexer.m_Tokens.At(relexer.m_Tokens.Push(previous));
+        }
+        u32 from = relexer.m_Tokens.Size();
+
+        // Once a new token starts where an old one did past the edit, both lexers are in the 
+        // same state and the old tokens from there on only need moving
+        i64 delta = static_cast<i64>(insertedText.size()) - static_cast<i64>(removedLength);
+        size_t editEnd = offset + insertedText.size();
+        u32 resync = size;
+        try {
+            while (TokenRef token = relexer._ReadToken()) {
+                relexer.m_CurrentToken = token;
+                if (token->offset < editEnd) {
+                    continue;
+                }
+
+                u32 oldOffset = static_cast<u32>(token->offset - delta);
+                u32 low = restart, high = size;
+                while (low < high) {
+                    u32 middle = low + (high - low) / 2;
+                    if (m_Tokens[middle].offset < oldOffset) {
+                        low = middle + 1;
+                    } else {
+                        high = middle;
+                    }
+                }
+                if (low < size && m_Tokens[low].offset == oldOffset) {
+                    resync = low;
+                    break;
+                }
+            }
+        } catch (TokenizerException& e) {
+            // Spliced in below, the error is raised again when lexing reaches it
+        }
+
+        const TokenStream& relexed = relexer.m_Tokens;
+        u32 relexedCount = relexed.Size() - from - (resync < size ? 1 : 0);
+        Token synced = resync < size ? m_Tokens[resync] : Token{};
+
+        if (m_KeepTrivia) {
+            auto removedBegin = std::lower_bound(m_Trivia.begin(), m_Trivia.end(), restartOffset, 
+                [](const Trivia& trivia, size_t offset) { return trivia.offset < offset; }
+            );
+            auto removedEnd = resync < size ? std::lower_bound(removedBegin, m_Trivia.end(), synced.offset, 
+                [](const Trivia& trivia, size_t offset) { return trivia.offset < offset; }
+            ) : m_Trivia.end();
+            for (auto it = removedEnd; it != m_Trivia.end(); ++it) {
+                it->offset = static_cast<u32>(it->offset + delta);
+            }
+            auto insertAt = m_Trivia.erase(removedBegin, removedEnd);
+            m_Trivia.insert(insertAt, relexer.m_Trivia.begin(), relexer.m_Trivia.end());
+        }
+
+        m_CurrentToken = TokenRef();
+        m_Tokens.Splice(restart, (resync < size ? resync : size) - restart, relexed, from, relexedCount);
+        if (resync < size) {
+            m_Tokens.Shift(restart + relexedCount, delta);
+            m_Index = oldIndex + delta;
+        } else {
+            m_Index = relexer.m_Index;
+        }
+
+        try {
+            m_CurrentToken = m_Tokens.Empty() ? TokenRef() : m_Tokens.At(m_Tokens.Size() - 1);
+            while (TokenRef token = _ReadToken()) {
+                m_CurrentToken = token;
+            }
+        } catch (TokenizerException& e) {
+            m_CurrentToken = m_Tokens.Empty() ? TokenRef() : m_Tokens.At(0);
+            throw;
+        }
+        m_CurrentToken = m_Tokens.Empty() ? TokenRef() : m_Tokens.At(0);
+    }
+
+    void Lexer::_AppendToken(const TokenStream& source, u32 index) {
+        const Token& token = source[index];
+        if (m_CollapseNewlines && token.type == TokenType::NEWLINE && (!m_CurrentToken || 
+            m_CurrentToken->type == TokenType::NEWLINE || m_CurrentToken->type == TokenType::SEMICOLON)
+        ) {
+            _SkipTrivia(token);
+            return;
+        }
+
+        u32 pushed = (token.flags & TokenFlags::REWRITTEN)
+            ? m_Tokens.Push(token, source.Content(index))
+            : m_Tokens.Push(token);
+        m_CurrentToken = m_Tokens.At(pushed);
+    }
+
+    void Lexer::_Stitch(std::vector<std::unique_ptr<Lexer>>& chunks, const std::vector<size_t>& boundaries) {
+        // m_Index carries the true sequential state from chunk to chunk, and 
+        // m_CurrentToken is the last token kept, which drives the newline collapsing
+        for (size_t i = 0; i < chunks.size(); i++) {
+            Lexer& chunk = *chunks[i];
+            const TokenStream& tokens = chunk.m_Tokens;
+            u32 first = 0;
+
+            // A chunk that starts exactly where the previous one stopped was lexed with the right state
+            bool synced = m_Index == boundaries[i];
+
+            // Otherwise relex with the real state until a token lines up with one of the chunk's. 
+            // From the same offset both lexers produce the same tokens from there on.
+            while (!synced && m_Index < chunk.m_Index) {
+                TokenRef token = _ReadToken();
+                if (!token) {
+                    break;
+                }
+                m_CurrentToken = token;
+
+                u32 low = 0, high = tokens.Size();
+                while (low < high) {
+                    u32 middle = low + (high - low) / 2;
+                    if (tokens[middle].offset < token->offset) {
+                        low = middle + 1;
+                    } else {
+                        high = middle;
+                    }
+                }
+
+                if (low < tokens.Size() && tokens[low].offset == token->offset) {
+                    first = low + 1;
+                    synced = true;
+                }
+            }
+
+            if (!synced) {
+                continue;
+            }
+
+            for (u32 index = first; index < tokens.Size(); index++) {
+                _AppendToken(tokens, index);
+            }
+            for (const Trivia& trivia : chunk.m_Trivia) {
+                if (first == 0 || trivia.offset > tokens[first - 1].offset) {
+                    m_Trivia.push_back(trivia);
+                }
+            }
+            m_Index = chunk.m_Index;
+        }
+
+        // A chunk that failed to lex stopped early, relex the rest to raise the real error
+        while (TokenRef token = _ReadToken()) {
+            m_CurrentToken = token;
+        }
+
+        // Collapsed newlines were recorded while appending, after the chunk's other trivia
+        std::stable_sort(m_Trivia.begin(), m_Trivia.end(), [](const Trivia& a, const Trivia& b) { return a.offset < b.offset; });
+    }
+
+    void Lexer::Reset() {
         m_Initialized = false;
+        m_Engine = LexerEngine::DFA;
         m_Filepath = "";
-        m_Content = "";
-        m_Line = 1;
-        m_Col = 1;
+        m_Source.Close();
+        m_Streaming = false;
+        m_Stream.Close();
+        m_OffsetBase = 0;
+        m_Origin = {};
+        m_Content = {};
         m_Index = 0;
-        m_CurrentToken = nullptr;
+        m_End = 0;
+        m_CollapseNewlines = true;
+        m_KeepTrivia = false;
+        m_Trivia.clear();
+        m_TokenCache = nullptr;
+        m_SymbolCache.clear();
+        m_Tokens.Clear();
+        m_Tokens.SetSource({});
+        m_CurrentToken = TokenRef();
     }
 
-    Ref<Token> PeekToken() {
+    TokenRef Lexer::PeekToken() const {
         if (!m_Initialized) {
             throw std::runtime_error("Tokenizer not initialized");
         }
@@ -215,21 +855,82 @@ namespace JR::Tokenizer {
         return m_CurrentToken;
     }
 
-    Ref<Token> NextToken() {
+    TokenRef Lexer::NextToken() {
         if (!m_Initialized) {
             throw std::runtime_error("Tokenizer not initialized");
         }
 
-        if (m_CurrentToken == nullptr) {
-            return nullptr;
+        if (!m_CurrentToken) {
+            return TokenRef();
         }
-        Ref<Token> token = m_CurrentToken;
-        m_CurrentToken = _ReadToken();
+        // Tokens lexed up front by InitParallel are walked in place, otherwise lex the next one
+        TokenRef token = m_CurrentToken;
+        if (m_Streaming && token.Index() >= c_StreamedTokens) {
+            // Nothing before the returned token can be referenced anymore
+            token = m_CurrentToken = _DropStreamedTokens(token);
+        }
+        u32 next = token.Index() + 1;
+        m_CurrentToken = (next < m_Tokens.Size()) ? m_Tokens.At(next) : _ReadToken();
 
-        LOG_TRACE("Tokenized: " + token->ToString());
+        LOG_TRACE("Tokenized: " + token.ToString());
         return token;
     }
 
+    /*
+    *   ------------------------------
+    *   Tokenizer API functions
+    *   ------------------------------
+    */
+
+    // The free functions lex through one Lexer per thread
+    thread_local Lexer s_Lexer;
+
+    void Init(std::string filepath, LexerEngine::Enum engine) {
+        s_Lexer.Init(filepath, engine);
+    }
+
+    void Reset() {
+        s_Lexer.Reset();
+    }
+
+    TokenRef PeekToken() {
+        return s_Lexer.PeekToken();
+    }
+
+    TokenRef NextToken() {
+        return s_Lexer.NextToken();
+    }
+
+    const TokenStream& GetTokenStream() {
+        return s_Lexer.GetTokenStream();
+    }
+
+    K::Interner& GetSymbols() {
+        static K::Interner s_Symbols;
+        return s_Symbols;
+    }
+
+    // Bump when the DFA changes what it produces without a change to the rules or reserved words
+    constexpr u64 c_LexerRevision = 3;
+
+    u64 RulesFingerprint() {
+        static const u64 s_Fingerprint = [] {
+            std::string description = std::to_string(c_LexerRevision) + "/" + std::to_string(sizeof(Token)) + "\n";
+            for (const std::string& name : TokenType::Strings) {
+                description += name + ",";
+            }
+            description += "\n";
+            for (const RuleDefinition& definition : s_RuleDefinitions) {
+                description += definition.first + "=" + std::to_string(definition.second) + "\n";
+            }
+            for (const Word& word : s_Words) {
+                description += std::string(word.text) + "=" + std::to_string(word.type) + "\n";
+            }
+            return K::Interner::Hash(description);
+        }();
+        return s_Fingerprint;
+    }
+
     std::string TokenTypeToString(TokenType::Enum type) {
         switch (type) {
             case TokenType::NONE                : return "NONE";
@@ -0,0 +1,118 @@
+#include <tokenizer.h>
+
+#include <algorithm>
+
+namespace JR::Tokenizer {
+    u32 TokenStream::Push(const Token& token) {
+        if ((m_Size & (c_BlockSize - 1)) == 0 && (m_Size >> c_BlockShift) == m_Blocks.size()) {
+            m_Blocks.push_back(m_Arena.AllocateArray<Token>(c_BlockSize));
+        }
+
+        m_Blocks[m_Size >> c_BlockShift][m_Size & (c_BlockSize - 1)] = token;
+        return m_Size++;
+    }
+
+    u32 TokenStream::Push(const Token& token, std::string_view content) {
+        Token rewritten = token;
+        rewritten.flags |= TokenFlags::REWRITTEN;
+
+        char* text = m_Arena.AllocateArray<char>(content.size());
+        std::copy(content.begin(), content.end(), text);
+
+        u32 index = Push(rewritten);
+        m_Rewritten.emplace_back(index, std::string_view(text, content.size()));
+        return index;
+    }
+
+    std::string_view TokenStream::Content(u32 index) const {
+        const Token& token = (*this)[index];
+        if (token.flags & TokenFlags::REWRITTEN) {
+            auto it = std::lower_bound(m_Rewritten.begin(), m_Rewritten.end(), index, 
+                [](const std::pair<u32, std::string_view>& entry, u32 index) { return entry.first < index; }
+            );
+            return it->second;
+        }
+
+        switch (token.type) {
+            case TokenType::NEWLINE:
+                return "";
+            case TokenType::STRING_LITERAL:
+            case TokenType::CHAR_LITERAL:
+                return m_Source.substr(static_cast<u32>(token.offset - m_Base) + 1, token.length - 2);
+            default:
+                return m_Source.substr(static_cast<u32>(token.offset - m_Base), token.length);
+        }
+    }
+
+    void TokenStream::Splice(u32 first, u32 count, const TokenStream& replacement, u32 from, u32 inserted) {
+        u32 tail = m_Size - first - count;
+
+        // Rewritten entries of the removed tokens go, later entries follow their tokens
+        auto removedBegin = std::lower_bound(m_Rewritten.begin(), m_Rewritten.end(), first, 
+            [](const std::pair<u32, std::string_view>& entry, u32 index) { return entry.first < index; }
+        );
+        auto removedEnd = std::lower_bound(removedBegin, m_Rewritten.end(), first + count, 
+            [](const std::pair<u32, std::string_view>& entry, u32 index) { return entry.first < index; }
+        );
+        for (auto it = removedEnd; it != m_Rewritten.end(); ++it) {
+            it->first = it->first - count + inserted;
+        }
+        auto insertAt = m_Rewritten.erase(removedBegin, removedEnd);
+
+        // Open or close the gap, moving the tail from the end that doesn't overwrite itself
+        if (inserted > count) {
+            for (u32 i = count; i < inserted; i++) {
+                Push(Token{});
+            }
+            for (u32 i = tail; i-- > 0;) {
+                _At(first + inserted + i) = _At(first + count + i);
+            }
+        } else if (inserted < count) {
+            for (u32 i = 0; i < tail; i++) {
+                _At(first + inserted + i) = _At(first + count + i);
+            }
+            m_Size -= count - inserted;
+        }
+
+        std::vector<std::pair<u32, std::string_view>> rewritten;
+        for (u32 i = 0; i < inserted; i++) {
+            const Token& token = replacement[from + i];
+            _At(first + i) = token;
+            if (token.flags & TokenFlags::REWRITTEN) {
+                std::string_view content = replacement.Content(from + i);
+                char* text = m_Arena.AllocateArray<char>(content.size());
+                std::copy(content.begin(), content.end(), text);
+                rewritten.emplace_back(first + i, std::string_view(text, content.size()));
+            }
+        }
+        m_Rewritten.insert(insertAt, rewritten.begin(), rewritten.end());
+    }
+
+    void TokenStream::Shift(u32 first, i64 offsetDelta) {
+        for (u32 i = first; i < m_Size; i++) {
+            Token& token = _At(i);
+            token.offset = static_cast<u32>(token.offset + offsetDelta);
+        }
+    }
+
+    SourcePosition TokenStream::PositionOf(u32 offset) const {
+        if (!m_Lines.IsBuilt()) {
+            m_Lines.Build(m_Source, m_Origin);
+        }
+        return m_Lines.Lookup(static_cast<u32>(offset - m_Base));
+    }
+
+    SourcePosition TokenStream::Position(u32 index, size_t& lineHint) const {
+        if (!m_Lines.IsBuilt()) {
+            m_Lines.Build(m_Source, m_Origin);
+        }
+        return m_Lines.Lookup(static_cast<u32>((*this)[index].offset - m_Base), lineHint);
+    }
+
+    void TokenStream::Clear() {
+        m_Arena.Reset();
+        m_Blocks.clear();
+        m_Rewritten.clear();
+        m_Size = 0;
+    }
+}
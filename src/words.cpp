@@ -0,0 +1,70 @@
+#include <words.h>
+
+#include <array>
+
+namespace JR::Tokenizer {
+    constexpr size_t c_WordCount = sizeof(s_Words) / sizeof(s_Words[0]);
+    constexpr size_t c_WordTableSize = 128;
+    static_assert(c_WordCount < c_WordTableSize, "s_Words no longer fits in the perfect hash table, grow c_WordTableSize");
+
+    /*
+    *   The hash only looks at the length and three characters of the word, so a
+    *   lookup costs a handful of instructions and a single compare against the
+    *   candidate in the slot. The seed is searched for at compile time until every
+    *   word in s_Words lands in its own slot.
+    */
+    constexpr u32 _HashWord(std::string_view word, u32 seed) {
+        u32 hash = seed ^ static_cast<u32>(word.size());
+        hash = (hash ^ static_cast<u8>(word[0])) * 16777619u;
+        hash = (hash ^ static_cast<u8>(word[word.size() / 2])) * 16777619u;
+        hash = (hash ^ static_cast<u8>(word[word.size() - 1])) * 16777619u;
+        return (hash ^ (hash >> 16)) & (c_WordTableSize - 1);
+    }
+
+    struct WordTable {
+        u32 seed;
+        std::array<u8, c_WordTableSize> slots; // Index into s_Words plus one, zero is an empty slot
+    };
+
+    constexpr bool _HasDuplicateWords() {
+        for (size_t i = 0; i < c_WordCount; i++) {
+            for (size_t j = i + 1; j < c_WordCount; j++) {
+                if (s_Words[i].text == s_Words[j].text) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+    static_assert(!_HasDuplicateWords(), "s_Words contains the same word twice");
+
+    constexpr WordTable _BuildWordTable() {
+        for (u32 seed = 1; ; seed++) {
+            WordTable table = { seed, {} };
+            bool collision = false;
+            for (size_t i = 0; i < c_WordCount && !collision; i++) {
+                u8& slot = table.slots[_HashWord(s_Words[i].text, seed)];
+                collision = slot != 0;
+                slot = static_cast<u8>(i + 1);
+            }
+
+            if (!collision) {
+                return table;
+            }
+        }
+    }
+
+    constexpr WordTable s_WordTable = _BuildWordTable();
+
+    TokenType::Enum ClassifyWord(std::string_view word) {
+        if (word.empty()) {
+            return TokenType::IDENTIFIER;
+        }
+
+        u8 slot = s_WordTable.slots[_HashWord(word, s_WordTable.seed)];
+        if (slot != 0 && s_Words[slot - 1].text == word) {
+            return s_Words[slot - 1].type;
+        }
+        return TokenType::IDENTIFIER;
+    }
+}
@@ -2,6 +2,7 @@
 #define __COMMON_TEST_H__
 
 #include <string>
+#include <vector>
 
 /**
  * @brief Create a new file randomizing all lines in the input file
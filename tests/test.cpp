@@ -1,11 +1,31 @@
 #include "common.test.h"
 
 #include <tokenizer.h>
+#include <tokencache.h>
+#include <tokendump.h>
+#include <parser.h>
+#include <modules.h>
+#include <daemon.h>
+#include <words.h>
+#include <source.h>
+#include <klib/kinterner.h>
+#include <klib/kscan.h>
+#include <klib/kthreadpool.h>
+#include <klib/kwriter.h>
 
 // #define DEBUG_LEVEL DEBUG_LEVEL_TRACE
 #include <log.h>
 
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
 #include <fstream>
+#include <iostream>
+#include <sstream>
+#include <random>
+#include <set>
+#include <thread>
+#include <tuple>
 
 #define STR(X) #X
 #define XSTR(X) STR(X)
@@ -35,11 +55,11 @@ int test_TokenizerSingleTokenType(std::string typeName, JR::Tokenizer::TokenType
         return 1;
     }
 
-    std::vector <Ref<JR::Tokenizer::Token>> tokens;
+    std::vector<JR::Tokenizer::TokenRef> tokens;
     try {
         LOG_TRACE("Tokenizing file...");
         while (JR::Tokenizer::PeekToken() ) {
-            Ref<JR::Tokenizer::Token> token = JR::Tokenizer::NextToken();
+            JR::Tokenizer::TokenRef token = JR::Tokenizer::NextToken();
             tokens.push_back(token);
         }
         LOG_TRACE("File tokenized successfully");
@@ -52,16 +72,16 @@ int test_TokenizerSingleTokenType(std::string typeName, JR::Tokenizer::TokenType
     }
 
     for (auto &token : tokens) {
-        LOG_TRACE("Found tokens: " + token->ToString());
+        LOG_TRACE("Found tokens: " + token.ToString());
     }
 
     // Output a csv of the output for validation
     std::ofstream ofs = std::ofstream(csvFilepath);
     ofs << "Type,Value,Line,Column";
     for (auto &token : tokens) {
-        ofs << JR::Tokenizer::TokenType::Strings[token->type] << ",";
-        ofs << ((token->type == JR::Tokenizer::TokenType::SEPERATOR) ? std::string("\",\"") : token->content);
-        ofs << "," << token->line << "," << token->column << "";
+        ofs << JR::Tokenizer::TokenTypeName(token->type) << ",";
+        ofs << ((token->type == JR::Tokenizer::TokenType::SEPERATOR) ? std::string_view("\",\"") : token.Content());
+        ofs << "," << token.Position().line << "," << token.Position().column << "";
     }
     ofs.close();
 
@@ -75,14 +95,14 @@ int test_TokenizerSingleTokenType(std::string typeName, JR::Tokenizer::TokenType
     size_t lineNo = 0;
     for (size_t i = 0; i < tokens.size(); i++) {
         if (tokens[i]->type != type) {
-            LOG_TRACE("Skipping token of type " + JR::Tokenizer::TokenType::Strings[tokens[i]->type] + " with value " + tokens[i]->content);
+            LOG_TRACE("Skipping token of type " + std::string(JR::Tokenizer::TokenTypeName(tokens[i]->type)) + " with value " + std::string(tokens[i].Content()));
             continue;
         }
 
         if (lineNo >= lines.size()) {
             LOG_ERROR("Tokenization error => Expected more tokens but reached end of validation file. Remaining tokens");
             for (size_t j = i; j < tokens.size(); j++) {
-                LOG_ERROR(tokens[j]->ToString());
+                LOG_ERROR(tokens[j].ToString());
             }
 
             break;
@@ -90,16 +110,17 @@ int test_TokenizerSingleTokenType(std::string typeName, JR::Tokenizer::TokenType
 
         // Remove all whitespace from the line[lineNo]
         lines[lineNo].erase(std::remove_if(lines[lineNo].begin(), lines[lineNo].end(), isspace), lines[lineNo].end());
-        if (tokens[i]->content != lines[lineNo]) {
+        if (tokens[i].Content() != lines[lineNo]) {
             // Print an error with the token line information using filepath as filepath
             // It should be in file:line:col format
-            std::string err = randomizedFilepath + ":" + std::to_string(tokens[i]->line) + ":" + std::to_string(tokens[i]->column);
-            err += ": Expected \"" + lines[lineNo] + "\" but got \"" + tokens[i]->content + "\" ";
-            err += "is " + lines[lineNo] + " a valid " + JR::Tokenizer::TokenType::Strings[type] + " token?";
+            JR::SourcePosition position = tokens[i].Position();
+            std::string err = randomizedFilepath + ":" + std::to_string(position.line) + ":" + std::to_string(position.column);
+            err += ": Expected \"" + lines[lineNo] + "\" but got \"" + std::string(tokens[i].Content()) + "\" ";
+            err += "is " + lines[lineNo] + " a valid " + std::string(JR::Tokenizer::TokenTypeName(type)) + " token?";
             LOG_ERROR(err.c_str());
             return 1;
         }
-        LOG_TRACE("Tokenization validated: " + tokens[i]->ToString());
+        LOG_TRACE("Tokenization validated: " + tokens[i].ToString());
         lineNo++;
     }
 
@@ -119,6 +140,1597 @@ int test_TokenizerSingleTokenType(std::string typeName, JR::Tokenizer::TokenType
     return 0;
 }
 
+int collectTokens(std::string filepath, JR::Tokenizer::LexerEngine::Enum engine, std::vector<JR::Tokenizer::TokenRef>& out) {
+    JR::Tokenizer::Reset();
+    try {
+        JR::Tokenizer::Init(filepath, engine);
+        while (JR::Tokenizer::PeekToken()) {
+            out.push_back(JR::Tokenizer::NextToken());
+        }
+    } catch (JR::Tokenizer::TokenizerException& e) {
+        LOG_ERROR(e.what());
+        return 1;
+    } catch (std::exception& e) {
+        LOG_ERROR(e.what());
+        return 1;
+    }
+    return 0;
+}
+
+int test_TokenizerEnginesAgree(std::string relativePath) {
+    std::string filepath = std::string(XSTR(TESTS_ROOT_DIR)) + "/" + relativePath;
+
+    // Token handles are invalidated by the next Reset(), so compare the rendered tokens
+    std::vector<std::string> regexTokens;
+    std::vector<std::string> dfaTokens;
+    for (auto [engine, rendered] : { 
+        std::make_pair(JR::Tokenizer::LexerEngine::REGEX, &regexTokens), 
+        std::make_pair(JR::Tokenizer::LexerEngine::DFA, &dfaTokens) 
+    }) {
+        std::vector<JR::Tokenizer::TokenRef> tokens;
+        if (collectTokens(filepath, engine, tokens)) {
+            return 1;
+        }
+        for (auto& token : tokens) {
+            rendered->push_back(token.ToString());
+        }
+    }
+
+    for (size_t i = 0; i < std::min(regexTokens.size(), dfaTokens.size()); i++) {
+        if (regexTokens[i] != dfaTokens[i]) {
+            LOG_ERROR(filepath + ": Engines disagree at token " + std::to_string(i) + ", regex " + regexTokens[i] + " vs dfa " + dfaTokens[i]);
+            return 1;
+        }
+    }
+
+    if (regexTokens.size() != dfaTokens.size()) {
+        LOG_ERROR(filepath + ": Engines produced " + std::to_string(regexTokens.size()) + " vs " + std::to_string(dfaTokens.size()) + " tokens");
+        return 1;
+    }
+
+    LOG_TRACE("Engines agree on " + std::to_string(dfaTokens.size()) + " tokens in " + filepath);
+    return 0;
+}
+
+int test_TokenizerWords() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::string wordsFilepath = (std::filesystem::temp_directory_path() / "jr_words_test.jr").string();
+
+    // Every word in the table must lex as a single token of its table type
+    std::ofstream ofs(wordsFilepath);
+    for (const auto& word : JR::Tokenizer::s_Words) {
+        ofs << word.text << std::endl;
+    }
+    ofs.close();
+
+    // The file is only needed to lex, so it is gone whether or not that worked
+    std::vector<JR::Tokenizer::TokenRef> tokens;
+    int failed = collectTokens(wordsFilepath, JR::Tokenizer::LexerEngine::DFA, tokens);
+    std::filesystem::remove(wordsFilepath);
+    if (failed) {
+        return 1;
+    }
+
+    size_t wordIndex = 0;
+    for (auto& token : tokens) {
+        if (token->type == JR::Tokenizer::TokenType::NEWLINE) {
+            continue;
+        }
+
+        const auto& word = JR::Tokenizer::s_Words[wordIndex++];
+        if (token.Content() != word.text || token->type != word.type) {
+            LOG_ERROR("Expected \"" + std::string(word.text) + "\" to be classified from s_Words, got " + token.ToString());
+            return 1;
+        }
+    }
+
+    // The per type artifacts must list exactly the words of that type in the table
+    std::pair<std::string, JR::Tokenizer::TokenType::Enum> artifacts[] = {
+        { "keywords", JR::Tokenizer::TokenType::KEYWORD },
+        { "types", JR::Tokenizer::TokenType::TYPE },
+    };
+    for (auto& [name, type] : artifacts) {
+        std::vector<std::string> lines;
+        if (getFileLinesWithoutCommentsOrWhitespace(directory + "/artifacts/" + name + ".jr", lines)) {
+            return 1;
+        }
+
+        std::set<std::string> expected;
+        for (const auto& word : JR::Tokenizer::s_Words) {
+            if (word.type == type) {
+                expected.insert(std::string(word.text));
+            }
+        }
+
+        std::set<std::string> actual;
+        for (auto& line : lines) {
+            line.erase(std::remove_if(line.begin(), line.end(), isspace), line.end());
+            actual.insert(line);
+        }
+
+        if (expected != actual) {
+            LOG_ERROR("artifacts/" + name + ".jr is out of sync with s_Words");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_TokenizerParallelLexers() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::vector<std::string> filepaths = {
+        directory + "/artifacts/operators.jr", directory + "/artifacts/types.jr", 
+        directory + "/artifacts/keywords.jr", directory + "/artifacts/identifiers.jr",
+        directory + "/artifacts/lexer_edge_cases.jr", directory + "/../samples/full_sample.jr"
+    };
+
+    // Lex every file sequentially through the free functions first
+    std::vector<std::vector<std::string>> expected(filepaths.size());
+    for (size_t i = 0; i < filepaths.size(); i++) {
+        std::vector<JR::Tokenizer::TokenRef> tokens;
+        if (collectTokens(filepaths[i], JR::Tokenizer::LexerEngine::DFA, tokens)) {
+            return 1;
+        }
+        for (auto& token : tokens) {
+            expected[i].push_back(token.ToString());
+        }
+    }
+
+    // Then lex each file several times over on separate threads with their own lexers
+    constexpr size_t c_Rounds = 4;
+    std::vector<std::vector<std::string>> actual(filepaths.size() * c_Rounds);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < actual.size(); i++) {
+        threads.emplace_back([&, i]() {
+            JR::Tokenizer::Lexer lexer;
+            try {
+                lexer.Init(filepaths[i % filepaths.size()]);
+                while (lexer.PeekToken()) {
+                    actual[i].push_back(lexer.NextToken().ToString());
+                }
+            } catch (...) {
+                actual[i].clear();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < actual.size(); i++) {
+        if (actual[i] != expected[i % filepaths.size()]) {
+            LOG_ERROR("Parallel lexer output differs for " + filepaths[i % filepaths.size()]);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_ThreadPool() {
+    K::ThreadPool pool(4);
+
+    // Tasks that fan out into more tasks must all finish before Wait() returns
+    std::atomic<size_t> count = 0;
+    for (size_t i = 0; i < 64; i++) {
+        pool.Submit([&]() {
+            for (size_t j = 0; j < 16; j++) {
+                pool.Submit([&]() { count++; });
+            }
+            count++;
+        });
+    }
+    pool.Wait();
+    if (count != 64 * 17) {
+        LOG_ERROR("Thread pool ran " + std::to_string(count) + " of " + std::to_string(64 * 17) + " tasks");
+        return 1;
+    }
+
+    // The first exception thrown by a task is rethrown from Wait()
+    pool.Submit([]() { throw std::runtime_error("task failed"); });
+    try {
+        pool.Wait();
+        LOG_ERROR("Thread pool swallowed a task exception");
+        return 1;
+    } catch (std::runtime_error& e) {
+        if (std::string(e.what()) != "task failed") {
+            LOG_ERROR("Thread pool rethrew the wrong exception");
+            return 1;
+        }
+    }
+
+    // Batches inside batches finish even with every worker waiting on one, and a waiter that
+    // slept through a slow task is woken when its batch is done
+    count = 0;
+    std::vector<K::ThreadPool::Task> outer;
+    for (size_t i = 0; i < 8; i++) {
+        outer.push_back([&]() {
+            std::vector<K::ThreadPool::Task> inner;
+            for (size_t j = 0; j < 8; j++) {
+                inner.push_back([&]() { count++; });
+            }
+            inner.push_back([&]() {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                count++;
+            });
+            pool.RunBatch(std::move(inner));
+        });
+    }
+    pool.RunBatch(std::move(outer));
+    if (count != 8 * 9) {
+        LOG_ERROR("Thread pool batches ran " + std::to_string(count) + " of " + std::to_string(8 * 9) + " tasks");
+        return 1;
+    }
+
+    return 0;
+}
+
+// Lex a file sequentially or in parallel chunks, rendering either all tokens or only the error message, 
+// since InitParallel raises errors up front where sequential lexing raises them when reaching them
+std::vector<std::string> renderTokens(std::string filepath, K::ThreadPool* pool, size_t chunkSize) {
+    std::vector<std::string> rendered;
+    JR::Tokenizer::Lexer lexer;
+    try {
+        if (pool) {
+            lexer.InitParallel(filepath, *pool, JR::Tokenizer::LexerEngine::DFA, chunkSize);
+        } else {
+            lexer.Init(filepath);
+        }
+        while (lexer.PeekToken()) {
+            rendered.push_back(lexer.NextToken().ToString());
+        }
+    } catch (JR::Tokenizer::TokenizerException& e) {
+        rendered = { e.what() };
+    }
+    return rendered;
+}
+
+int test_TokenizerParallelChunks() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::string stressFilepath = directory + "/artifacts/chunks_generated.jr";
+    std::string failingFilepath = directory + "/artifacts/chunks_failing_generated.jr";
+
+    // Fragments that straddle lines, so chunk boundaries land inside comments and literals
+    const char* fragments[] = {
+        "/* block\ncomment with \"quotes\" and 'ticks'\n*/", "\"multi\nline\nstring\"", "'\n'", "// line \"comment\"\n",
+        "\r\n", "\n", "\n\n\n", ";", "let", "x1", "0xFF", "0b101", "1.5f", "42", "true", ">>=", "::", "...", "(", "}", " ", "\t"
+    };
+    std::mt19937 random(1234);
+    std::ofstream stress(stressFilepath, std::ios::binary);
+    for (size_t i = 0; i < 4000; i++) {
+        stress << fragments[random() % (sizeof(fragments) / sizeof(fragments[0]))] << " ";
+    }
+    stress.close();
+
+    // A real error after text that looks like an error when a chunk starts inside the comment
+    std::ofstream failing(failingFilepath, std::ios::binary);
+    for (size_t i = 0; i < 200; i++) {
+        failing << "let a = 1\n/*\n\"\n@\n*/\n";
+    }
+    failing << "let b = @\n";
+    failing.close();
+
+    K::ThreadPool pool(4);
+    for (std::string filepath : { 
+        directory + "/artifacts/lexer_edge_cases.jr", directory + "/../samples/full_sample.jr", stressFilepath, failingFilepath 
+    }) {
+        std::vector<std::string> expected = renderTokens(filepath, nullptr, 0);
+        for (size_t chunkSize : { 1, 7, 64, 1000, 1024 * 1024 }) {
+            if (renderTokens(filepath, &pool, chunkSize) != expected) {
+                LOG_ERROR("Parallel chunked lexing of " + filepath + " with chunk size " + std::to_string(chunkSize) + " differs from sequential lexing");
+                return 1;
+            }
+        }
+    }
+
+    remove(stressFilepath.c_str());
+    remove(failingFilepath.c_str());
+    return 0;
+}
+
+int test_SourceBuffer() {
+    std::string filepath = std::string(XSTR(TESTS_ROOT_DIR)) + "/../samples/full_sample.jr";
+
+    std::ifstream file(filepath);
+    std::stringstream expected;
+    expected << file.rdbuf();
+
+    JR::SourceBuffer source;
+    try {
+        source.Open(filepath);
+    } catch (std::exception& e) {
+        LOG_ERROR(e.what());
+        return 1;
+    }
+
+    if (!source.IsMapped() || source.Data() != expected.str()) {
+        LOG_ERROR("Mapped source does not match the file contents of " + filepath);
+        return 1;
+    }
+
+    // Moving the buffer must keep the mapping alive
+    JR::SourceBuffer moved = std::move(source);
+    if (moved.Data() != expected.str() || source.Size() != 0) {
+        LOG_ERROR("Moved source does not match the file contents of " + filepath);
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_LineIndex() {
+    // Every offset against a position counted byte by byte, including a window that starts mid line
+    std::string text = "let a = 1\n\n  b /* two\nlines */ \"multi\nline\" c\r\nd\n";
+    for (JR::SourcePosition origin : { JR::SourcePosition{ 1, 1 }, JR::SourcePosition{ 40, 7 } }) {
+        JR::LineIndex index;
+        index.Build(text, origin);
+        JR::SourcePosition expected = origin;
+        size_t hint = 0;
+        for (size_t offset = 0; offset <= text.size(); offset++) {
+            JR::SourcePosition position = index.Lookup(offset);
+            JR::SourcePosition walked = index.Lookup(offset, hint);
+            if (position.line != expected.line || position.column != expected.column || 
+                walked.line != expected.line || walked.column != expected.column) {
+                LOG_ERROR("Offset " + std::to_string(offset) + " was found at " + std::to_string(position.line) + ":" + 
+                    std::to_string(position.column) + " instead of " + std::to_string(expected.line) + ":" + std::to_string(expected.column));
+                return 1;
+            }
+            if (offset < text.size() && text[offset] == '\n') {
+                expected = { expected.line + 1, 1 };
+            } else {
+                expected.column++;
+            }
+        }
+    }
+
+    // Tokens after a literal spanning lines are placed on the line they are on
+    JR::Tokenizer::Lexer lexer;
+    lexer.InitBuffer("lines.jr", text);
+    std::vector<std::string> positions;
+    while (JR::Tokenizer::TokenRef token = lexer.NextToken()) {
+        positions.push_back(token.ToString());
+    }
+    std::vector<std::string> expected = {
+        "Token(\"let\", KEYWORD, 1, 1)", "Token(\"a\", IDENTIFIER, 1, 5)", "Token(\"=\", OPERATOR, 1, 7)", 
+        "Token(\"1\", INTEGER_LITERAL, 1, 9)", "Token(\"\", NEWLINE, 1, 10)", "Token(\"b\", IDENTIFIER, 3, 3)", 
+        "Token(\"multi\nline\", STRING_LITERAL, 4, 10)", "Token(\"c\", IDENTIFIER, 5, 7)", "Token(\"\", NEWLINE, 5, 8)", 
+        "Token(\"d\", IDENTIFIER, 6, 1)", "Token(\"\", NEWLINE, 6, 2)"
+    };
+    if (positions != expected) {
+        LOG_ERROR("Token positions differ from the expected positions");
+        for (const std::string& position : positions) {
+            LOG_ERROR(position);
+        }
+        return 1;
+    }
+
+    return 0;
+}
+
+// Lex with trivia kept, rendering each token and trivia range as offset:length:type:line:column in source order
+std::vector<std::string> renderWithTrivia(std::string filepath, K::ThreadPool* pool, size_t chunkSize) {
+    std::vector<std::pair<u32, std::string>> ranges;
+    JR::Tokenizer::Lexer lexer;
+    lexer.SetKeepTrivia(true);
+    if (pool) {
+        lexer.InitParallel(filepath, *pool, JR::Tokenizer::LexerEngine::DFA, chunkSize);
+    } else {
+        lexer.Init(filepath);
+    }
+    while (lexer.PeekToken()) {
+        JR::Tokenizer::TokenRef token = lexer.NextToken();
+        JR::SourcePosition position = token.Position();
+        ranges.push_back({ token->offset, std::to_string(token->offset) + ":" + std::to_string(token->length) + ":" + 
+            std::to_string(token->type) + ":" + std::to_string(position.line) + ":" + std::to_string(position.column) });
+    }
+    for (const JR::Tokenizer::Trivia& trivia : lexer.GetTrivia()) {
+        JR::SourcePosition position = lexer.GetTokenStream().PositionOf(trivia.offset);
+        ranges.push_back({ trivia.offset, std::to_string(trivia.offset) + ":" + std::to_string(trivia.length) + ":" + 
+            std::to_string(trivia.type) + ":" + std::to_string(position.line) + ":" + std::to_string(position.column) });
+    }
+    std::stable_sort(ranges.begin(), ranges.end(), [](auto& a, auto& b) { return a.first < b.first; });
+
+    std::vector<std::string> rendered;
+    for (auto& range : ranges) {
+        rendered.push_back(range.second);
+    }
+    return rendered;
+}
+
+int test_TokenizerTrivia() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::string headerFilepath = directory + "/artifacts/trivia_generated.jr";
+
+    // A huge license header style run of comments and blank lines before the first token, 
+    // which used to take one stack frame per skipped comment
+    std::ofstream header(headerFilepath, std::ios::binary);
+    for (size_t i = 0; i < 500000; i++) {
+        header << "// Licensed under the terms in LICENSE\n\n    \n/* block */\n";
+    }
+    header << "let x = 1\n";
+    header.close();
+
+    std::vector<std::string> tokens = renderTokens(headerFilepath, nullptr, 0);
+    if (tokens.size() != 5 || tokens[0].find("let") == std::string::npos) {
+        LOG_ERROR("Expected 5 tokens after the comment header, got " + std::to_string(tokens.size()));
+        return 1;
+    }
+
+    K::ThreadPool pool(4);
+    for (std::string filepath : { directory + "/artifacts/lexer_edge_cases.jr", directory + "/../samples/full_sample.jr" }) {
+        std::ifstream file(filepath, std::ios::binary);
+        std::stringstream contents;
+        contents << file.rdbuf();
+
+        // Tokens and trivia together cover every byte of the file exactly once
+        std::vector<std::string> expected = renderWithTrivia(filepath, nullptr, 0);
+        size_t covered = 0;
+        for (std::string& range : expected) {
+            size_t offset = std::stoul(range);
+            if (offset != covered) {
+                LOG_ERROR("Tokens and trivia of " + filepath + " leave a gap or overlap at offset " + std::to_string(covered));
+                return 1;
+            }
+            covered += std::stoul(range.substr(range.find(':') + 1));
+        }
+        if (covered != contents.str().size()) {
+            LOG_ERROR("Tokens and trivia of " + filepath + " stop at offset " + std::to_string(covered));
+            return 1;
+        }
+
+        for (size_t chunkSize : { 1, 7, 64, 1000 }) {
+            if (renderWithTrivia(filepath, &pool, chunkSize) != expected) {
+                LOG_ERROR("Parallel trivia of " + filepath + " with chunk size " + std::to_string(chunkSize) + " differs from sequential lexing");
+                return 1;
+            }
+        }
+    }
+
+    remove(headerFilepath.c_str());
+    return 0;
+}
+
+// Every token and trivia range of a lexer with its position, text and symbol, plus the error if lexing stopped at one
+std::vector<std::string> renderStream(JR::Tokenizer::Lexer& lexer, const std::string& error) {
+    std::vector<std::string> rendered;
+    const JR::Tokenizer::TokenStream& tokens = lexer.GetTokenStream();
+    for (JR::Tokenizer::TokenRef token : tokens) {
+        rendered.push_back(token.ToString() + "@" + std::to_string(token->offset) + "+" + std::to_string(token->length) + 
+            "#" + std::to_string(token->symbol));
+    }
+    for (const JR::Tokenizer::Trivia& trivia : lexer.GetTrivia()) {
+        JR::SourcePosition position = tokens.PositionOf(trivia.offset);
+        rendered.push_back("Trivia(" + std::to_string(trivia.type) + ", " + std::to_string(trivia.offset) + "+" + 
+            std::to_string(trivia.length) + ", " + std::to_string(position.line) + ", " + std::to_string(position.column) + ")");
+    }
+    rendered.push_back(error);
+    return rendered;
+}
+
+int test_TokenizerIncremental() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::stringstream contents;
+    contents << std::ifstream(directory + "/../samples/full_sample.jr", std::ios::binary).rdbuf();
+    contents << std::ifstream(directory + "/artifacts/lexer_edge_cases.jr", std::ios::binary).rdbuf();
+    std::string text = contents.str();
+
+    // Edits that split and join tokens, open and close comments and literals, and add or remove lines
+    const char* fragments[] = {
+        "", "", "a", "1", "5", ".", "/", "*", "*/", "/*", "//", "\"", "\"str\"", "'c'", "'", "\n", "\n\n", "\r\n", " ", "\t",
+        ";", "x = 0x1F;", "0b", "true", "let y = 2.5f\n", "{", "}", ">>", "="
+    };
+    std::mt19937 random(2024);
+
+    JR::Tokenizer::Lexer incremental;
+    incremental.SetKeepTrivia(true);
+    std::string incrementalError;
+    try {
+        incremental.InitBuffer("edited.jr", text);
+    } catch (JR::Tokenizer::TokenizerException& e) {
+        incrementalError = e.what();
+    }
+
+    // Edits applied so far as (offset, removed text, inserted text), so broken text can be repaired
+    std::vector<std::tuple<size_t, std::string, std::string>> history;
+    size_t errors = 0;
+    for (size_t edit = 0; edit < 1500; edit++) {
+        size_t offset, removed;
+        std::string inserted;
+        if (!incrementalError.empty() && !history.empty() && random() % 4 != 0) {
+            // Undo edits while the text does not lex, like a user fixing a typo
+            auto [undoOffset, undoRemoved, undoInserted] = history.back();
+            history.pop_back();
+            offset = undoOffset;
+            removed = undoInserted.size();
+            inserted = undoRemoved;
+        } else {
+            offset = random() % (text.size() + 1);
+            removed = std::min<size_t>(random() % 6 == 0 ? random() % 12 : 0, text.size() - offset);
+            inserted = fragments[random() % (sizeof(fragments) / sizeof(fragments[0]))];
+            history.emplace_back(offset, text.substr(offset, removed), inserted);
+        }
+        text.replace(offset, removed, inserted);
+
+        incrementalError = "";
+        try {
+            incremental.Edit(offset, removed, inserted);
+        } catch (JR::Tokenizer::TokenizerException& e) {
+            incrementalError = e.what();
+        }
+
+        JR::Tokenizer::Lexer fresh;
+        fresh.SetKeepTrivia(true);
+        std::string freshError;
+        try {
+            fresh.InitBuffer("edited.jr", text);
+            while (fresh.PeekToken()) {
+                fresh.NextToken();
+            }
+        } catch (JR::Tokenizer::TokenizerException& e) {
+            freshError = e.what();
+        }
+
+        errors += !freshError.empty();
+        if (renderStream(incremental, incrementalError) != renderStream(fresh, freshError)) {
+            LOG_ERROR("Incremental relex differs from a full relex after edit " + std::to_string(edit) + 
+                " at offset " + std::to_string(offset) + " removing " + std::to_string(removed) + " bytes");
+            return 1;
+        }
+    }
+    LOG_INFO(std::to_string(errors) + " of 1500 edits left text that does not lex");
+
+    // Comment openers right before the edit, which the edits above rarely land next to
+    std::tuple<std::string, size_t, size_t, std::string> junctions[] = {
+        { "x /* y", 6, 0, " */" },
+        { "x /* y", 5, 1, "*/" },
+        { "/* y", 4, 0, "*/" },
+        { "a / * b", 7, 0, "*/" },
+    };
+    for (auto& [original, offset, removed, inserted] : junctions) {
+        std::string edited = original;
+        edited.replace(offset, removed, inserted);
+
+        JR::Tokenizer::Lexer lexer, fresh;
+        lexer.InitBuffer("edited.jr", original);
+        lexer.Edit(offset, removed, inserted);
+        fresh.InitBuffer("edited.jr", edited);
+        while (fresh.PeekToken()) {
+            fresh.NextToken();
+        }
+        if (renderStream(lexer, "") != renderStream(fresh, "")) {
+            LOG_ERROR("Incremental relex of `" + edited + "` differs from a full relex");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_Interner() {
+    K::Interner interner;
+
+    // Threads interning overlapping names must all agree on every symbol
+    constexpr size_t c_Threads = 8, c_Names = 20000;
+    std::vector<std::vector<u32>> symbols(c_Threads, std::vector<u32>(c_Names));
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < c_Threads; t++) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < c_Names; i++) {
+                size_t name = (i * (t + 1)) % c_Names;
+                symbols[t][name] = interner.Intern("name_" + std::to_string(name));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::set<u32> distinct;
+    for (size_t name = 0; name < c_Names; name++) {
+        u32 symbol = symbols[0][name];
+        for (size_t t = 1; t < c_Threads; t++) {
+            if (symbols[t][name] != symbol && symbols[t][name] != K::Interner::c_NoSymbol) {
+                LOG_ERROR("Threads got different symbols for name_" + std::to_string(name));
+                return 1;
+            }
+        }
+        if (symbol == K::Interner::c_NoSymbol || interner.Lookup(symbol) != "name_" + std::to_string(name)) {
+            LOG_ERROR("Symbol for name_" + std::to_string(name) + " does not look up to its text");
+            return 1;
+        }
+        distinct.insert(symbol);
+    }
+    if (distinct.size() != c_Names || interner.Size() != c_Names) {
+        LOG_ERROR("Expected " + std::to_string(c_Names) + " distinct symbols, got " + std::to_string(interner.Size()));
+        return 1;
+    }
+
+    // Lexed names map to symbols one to one with their text, the same in sequential and parallel lexing
+    std::string filepath = std::string(XSTR(TESTS_ROOT_DIR)) + "/../samples/full_sample.jr";
+    JR::Tokenizer::Lexer sequential, parallel;
+    K::ThreadPool pool(4);
+    sequential.Init(filepath);
+    while (sequential.PeekToken()) {
+        sequential.NextToken();
+    }
+    parallel.InitParallel(filepath, pool, JR::Tokenizer::LexerEngine::DFA, 64);
+
+    const JR::Tokenizer::TokenStream& tokens = sequential.GetTokenStream();
+    if (tokens.Size() != parallel.GetTokenStream().Size()) {
+        LOG_ERROR("Sequential and parallel lexing produced different token counts");
+        return 1;
+    }
+    for (u32 i = 0; i < tokens.Size(); i++) {
+        const JR::Tokenizer::Token& token = tokens[i];
+        bool named = token.type == JR::Tokenizer::TokenType::IDENTIFIER || token.type == JR::Tokenizer::TokenType::KEYWORD || 
+            token.type == JR::Tokenizer::TokenType::TYPE;
+        if (named != (token.symbol != K::Interner::c_NoSymbol)) {
+            LOG_ERROR("Token " + tokens.At(i).ToString() + " has an unexpected symbol");
+            return 1;
+        }
+        if (named && JR::Tokenizer::GetSymbols().Lookup(token.symbol) != tokens.Content(i)) {
+            LOG_ERROR("Token " + tokens.At(i).ToString() + " has the symbol of " + std::string(JR::Tokenizer::GetSymbols().Lookup(token.symbol)));
+            return 1;
+        }
+        if (parallel.GetTokenStream()[i].symbol != token.symbol) {
+            LOG_ERROR("Token " + tokens.At(i).ToString() + " got a different symbol in parallel lexing");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_TokenCache() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::filesystem::path cacheDirectory = std::filesystem::temp_directory_path() / "justrightc-token-cache-test";
+    std::filesystem::remove_all(cacheDirectory);
+    auto entryCount = [&cacheDirectory]() {
+        return std::distance(std::filesystem::directory_iterator(cacheDirectory), std::filesystem::directory_iterator());
+    };
+    // Entries are named after the hash and size of their source
+    auto entryPathOf = [&cacheDirectory](const std::string& text) {
+        char name[64];
+        snprintf(name, sizeof(name), "%016llx-%zx.jrtc", (unsigned long long)JR::Tokenizer::TokenCache::Hash(text), text.size());
+        return cacheDirectory / name;
+    };
+
+    // A miss lexes and stores, a hit loads, both give exactly the tokens of an uncached lex
+    K::ThreadPool pool(4);
+    JR::Tokenizer::TokenCache cache(cacheDirectory.string());
+    for (std::string filepath : { directory + "/artifacts/lexer_edge_cases.jr", directory + "/../samples/full_sample.jr" }) {
+        JR::Tokenizer::Lexer uncached;
+        uncached.InitParallel(filepath, pool);
+        std::vector<std::string> expected = renderStream(uncached, "");
+
+        for (const char* pass : { "missed", "hit" }) {
+            JR::Tokenizer::Lexer lexer;
+            lexer.SetTokenCache(&cache);
+            lexer.InitParallel(filepath, pool);
+            if (renderStream(lexer, "") != expected) {
+                LOG_ERROR("Tokens of " + filepath + " differ when the token cache " + pass);
+                return 1;
+            }
+        }
+    }
+    if (entryCount() != 2) {
+        LOG_ERROR("Expected one token cache entry per file, found " + std::to_string(entryCount()));
+        return 1;
+    }
+
+    // Damaged entries and entries of other lexer rules are misses
+    std::string text = "let x = 0x1F\nfun main() { return x; }\n";
+    u64 hash = JR::Tokenizer::TokenCache::Hash(text);
+    JR::Tokenizer::Lexer lexer;
+    lexer.InitBuffer("buffer", text);
+    while (lexer.NextToken()) {}
+    cache.Store(hash, text, lexer.GetTokenStream());
+
+    std::filesystem::path entryPath = entryPathOf(text);
+    std::string entryBytes;
+    {
+        std::ifstream file(entryPath, std::ios::binary);
+        entryBytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    // Whether an entry produces tokens, a failed load must leave the stream empty
+    auto loads = [&](const std::string& bytes) {
+        std::ofstream(entryPath, std::ios::binary) << bytes;
+        JR::Tokenizer::TokenStream tokens;
+        tokens.SetSource(text);
+        return cache.Load(hash, text, tokens) || !tokens.Empty();
+    };
+    std::string otherRules = entryBytes;
+    otherRules[8] ^= 1;                 // The header's rules fingerprint
+    std::string outsideSource = entryBytes;
+    outsideSource[48 + 4] = char(0xFF); // The first token's offset, right after the header
+    if (!loads(entryBytes) || loads(entryBytes.substr(0, entryBytes.size() - 1)) || loads(otherRules) || loads(outsideSource)) {
+        LOG_ERROR("The token cache loaded a damaged entry or missed a valid one");
+        return 1;
+    }
+    JR::Tokenizer::TokenStream unrelated;
+    unrelated.SetSource(text);
+    if (cache.Load(hash ^ 1, text, unrelated) || !unrelated.Empty()) {
+        LOG_ERROR("The token cache loaded an entry for the wrong hash");
+        return 1;
+    }
+
+    // Once over the limit the least recently used entries go, a load counts as a use
+    std::filesystem::remove_all(cacheDirectory);
+    std::string texts[] = { "let a = 1\n", "let b = 2\n", "let c = 3\n" };
+    std::vector<JR::Tokenizer::Lexer> lexers(3);
+    std::vector<std::filesystem::path> entryPaths;
+    for (size_t i = 0; i < 3; i++) {
+        lexers[i].InitBuffer("buffer", texts[i]);
+        while (lexers[i].NextToken()) {}
+        entryPaths.push_back(entryPathOf(texts[i]));
+    }
+    auto store = [&](JR::Tokenizer::TokenCache& into, size_t i) {
+        into.Store(JR::Tokenizer::TokenCache::Hash(texts[i]), texts[i], lexers[i].GetTokenStream());
+    };
+
+    JR::Tokenizer::TokenCache unbounded(cacheDirectory.string());
+    store(unbounded, 0);
+    store(unbounded, 1);
+    u64 entrySize = std::filesystem::file_size(entryPaths[0]);
+    auto now = std::filesystem::file_time_type::clock::now();
+    std::filesystem::last_write_time(entryPaths[0], now - std::chrono::hours(2));
+    std::filesystem::last_write_time(entryPaths[1], now - std::chrono::hours(1));
+
+    JR::Tokenizer::TokenCache bounded(cacheDirectory.string(), entrySize * 2 + entrySize / 2);
+    JR::Tokenizer::TokenStream used;
+    used.SetSource(texts[0]);
+    if (!bounded.Load(JR::Tokenizer::TokenCache::Hash(texts[0]), texts[0], used)) {
+        LOG_ERROR("The token cache missed a stored entry");
+        return 1;
+    }
+    store(bounded, 2);
+    if (!std::filesystem::exists(entryPaths[0]) || std::filesystem::exists(entryPaths[1]) || !std::filesystem::exists(entryPaths[2])) {
+        LOG_ERROR("The token cache did not evict its least recently used entry");
+        return 1;
+    }
+
+    // Stores only list the directory once over the limit, so a directory already over it is evicted on open
+    std::filesystem::last_write_time(entryPaths[0], now - std::chrono::hours(1));
+    JR::Tokenizer::TokenCache smaller(cacheDirectory.string(), entrySize + entrySize / 2);
+    if (std::filesystem::exists(entryPaths[0]) || !std::filesystem::exists(entryPaths[2])) {
+        LOG_ERROR("The token cache was not evicted down to its limit when opened");
+        return 1;
+    }
+
+    std::filesystem::remove_all(cacheDirectory);
+    return 0;
+}
+
+int test_TokenDump() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::string dumpFilepath = directory + "/artifacts/token_dump_generated.jrtd";
+    std::vector<std::string> filepaths = { directory + "/artifacts/lexer_edge_cases.jr", directory + "/../samples/full_sample.jr" };
+
+    std::vector<std::unique_ptr<JR::Tokenizer::Lexer>> lexers;
+    JR::Tokenizer::TokenDumpWriter writer;
+    K::ThreadPool pool(2);
+    for (const std::string& filepath : filepaths) {
+        lexers.push_back(std::make_unique<JR::Tokenizer::Lexer>());
+        lexers.back()->InitParallel(filepath, pool);
+        writer.Add(filepath, lexers.back()->GetTokenStream());
+    }
+    writer.Save(dumpFilepath);
+
+    // Every token reads back with its type name, position and content
+    JR::Tokenizer::TokenDumpReader reader;
+    reader.Open(dumpFilepath);
+    if (reader.FileCount() != filepaths.size()) {
+        LOG_ERROR("Token dump has " + std::to_string(reader.FileCount()) + " files");
+        return 1;
+    }
+    for (u32 file = 0; file < reader.FileCount(); file++) {
+        const JR::Tokenizer::TokenStream& tokens = lexers[file]->GetTokenStream();
+        if (reader.FilePath(file) != filepaths[file] || reader.TokenCount(file) != tokens.Size()) {
+            LOG_ERROR("Token dump entry for " + filepaths[file] + " has the wrong path or token count");
+            return 1;
+        }
+
+        JR::Tokenizer::TokenDumpReader::Cursor cursor = reader.Tokens(file);
+        JR::Tokenizer::DumpToken token;
+        u32 index = 0;
+        for (; cursor.Next(token); index++) {
+            const JR::Tokenizer::Token& expected = tokens[index];
+            JR::SourcePosition position = tokens.Position(index);
+            std::string_view expectedType = JR::Tokenizer::TokenTypeName(expected.type);
+            if (token.type != expected.type || reader.TypeName(token.type) != expectedType || token.offset != expected.offset || 
+                token.length != expected.length || token.line != position.line || token.column != position.column || 
+                token.content != tokens.Content(index)) {
+                LOG_ERROR("Token dump of " + filepaths[file] + " decoded " + tokens.At(index).ToString() + " as (\"" + 
+                    std::string(token.content) + "\", " + std::string(reader.TypeName(token.type)) + ", " + 
+                    std::to_string(token.line) + ", " + std::to_string(token.column) + ")");
+                return 1;
+            }
+        }
+        if (index != tokens.Size()) {
+            LOG_ERROR("Token dump of " + filepaths[file] + " stopped after " + std::to_string(index) + " tokens");
+            return 1;
+        }
+    }
+
+    // Damaged dumps are rejected when opened
+    std::string bytes;
+    {
+        std::ifstream file(dumpFilepath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+    std::string truncated = bytes.substr(0, bytes.size() - 1);
+    std::string otherVersion = bytes;
+    otherVersion[4] = 99;
+    for (const std::string& damaged : { truncated, otherVersion }) {
+        std::ofstream(dumpFilepath, std::ios::binary) << damaged;
+        try {
+            reader.Open(dumpFilepath);
+            LOG_ERROR("A damaged token dump was opened");
+            return 1;
+        } catch (std::runtime_error& e) {}
+    }
+
+    remove(dumpFilepath.c_str());
+    return 0;
+}
+
+int test_Writer() {
+    std::string filepath = std::string(XSTR(TESTS_ROOT_DIR)) + "/artifacts/writer_generated.txt";
+
+    // Small buffers so the output crosses buffer boundaries, including text larger than a buffer
+    std::string large(5000, 'x');
+    for (bool background : { false, true }) {
+        std::string expected;
+        {
+            K::Writer writer(64);
+            if (!writer.Open(filepath, background)) {
+                LOG_ERROR("Could not open " + filepath);
+                return 1;
+            }
+            for (u64 i = 0; i < 2000; i++) {
+                u64 number = i * 0x9E3779B97F4A7C15ull;
+                writer.WriteNumber(number);
+                writer.Write(',');
+                writer.WriteCsvField(i % 3 ? "plain" : "\"quoted\" \"\"");
+                writer.Write(i % 500 ? std::string_view("\n") : std::string_view(large));
+                expected += std::to_string(number) + "," + (i % 3 ? "\"plain\"" : "\"\"\"quoted\"\" \"\"\"\"\"") + (i % 500 ? "\n" : large);
+            }
+            if (!writer.Close()) {
+                LOG_ERROR("Writer reported a failed write");
+                return 1;
+            }
+        }
+
+        std::ifstream file(filepath, std::ios::binary);
+        std::string written((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (written != expected) {
+            LOG_ERROR("Writer output differs from the expected text with background writing " + std::string(background ? "on" : "off"));
+            return 1;
+        }
+    }
+
+    remove(filepath.c_str());
+    return 0;
+}
+
+int test_Log() {
+    int level = -1;
+    if (!K::Log::ParseLevel("trace", level) || level != DEBUG_LEVEL_TRACE || K::Log::ParseLevel("loud", level)) {
+        LOG_ERROR("Log level names parse incorrectly");
+        return 1;
+    }
+
+    // Arguments of levels disabled at runtime or compiled out are never evaluated
+    int previousLevel = K::Log::GetLevel();
+    int evaluated = 0;
+    auto sideEffect = [&evaluated]() { evaluated++; return "evaluated"; };
+    K::Log::SetLevel(DEBUG_LEVEL_WARN);
+    LOG_INFO(sideEffect());
+    K::Log::SetLevel(DEBUG_LEVEL_TRACE);
+    LOG_TRACE(sideEffect());    // Above this file's DEBUG_LEVEL
+    K::Log::SetLevel(previousLevel);
+    if (evaluated != 0) {
+        LOG_ERROR("Disabled log levels evaluated their arguments");
+        return 1;
+    }
+
+    // Messages from many threads all arrive once, each thread's in order
+    K::Log::Flush();
+    std::ostringstream captured;
+    std::streambuf* console = std::cout.rdbuf(captured.rdbuf());
+    constexpr size_t c_Threads = 8, c_Messages = 2000;
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < c_Threads; t++) {
+        threads.emplace_back([t]() {
+            for (size_t i = 0; i < c_Messages; i++) {
+                LOG_WARN("log-test ", t, " ", i);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    K::Log::Flush();
+    std::cout.rdbuf(console);
+
+    std::vector<size_t> next(c_Threads, 0);
+    std::istringstream lines(captured.str());
+    for (std::string line; std::getline(lines, line);) {
+        size_t start = line.find("log-test ");
+        if (start == std::string::npos) {
+            continue;
+        }
+        size_t thread = 0, index = 0;
+        std::istringstream(line.substr(start + 9)) >> thread >> index;
+        if (thread >= c_Threads || index != next[thread]) {
+            LOG_ERROR("Log message " + line.substr(start) + " arrived out of order");
+            return 1;
+        }
+        next[thread]++;
+    }
+    for (size_t t = 0; t < c_Threads; t++) {
+        if (next[t] != c_Messages) {
+            LOG_ERROR("Only " + std::to_string(next[t]) + " log messages of thread " + std::to_string(t) + " arrived");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// Lex a file one token at a time, rendering each token as offset:length:type:line:column:content, or the error that stopped it
+std::vector<std::string> renderTokens(std::string filepath, JR::Tokenizer::LexerEngine::Enum engine, size_t streamChunkSize, size_t* maxWindow = nullptr) {
+    std::vector<std::string> rendered;
+    JR::Tokenizer::Lexer lexer;
+    try {
+        if (streamChunkSize) {
+            lexer.InitStream(filepath, engine, streamChunkSize);
+        } else {
+            lexer.Init(filepath, engine);
+        }
+        while (lexer.PeekToken()) {
+            JR::Tokenizer::TokenRef token = lexer.NextToken();
+            JR::SourcePosition position = token.Position();
+            rendered.push_back(std::to_string(token->offset) + ":" + std::to_string(token->length) + ":" + std::to_string(token->type) + ":" + 
+                std::to_string(position.line) + ":" + std::to_string(position.column) + ":" + std::string(token.Content()));
+            if (maxWindow) {
+                *maxWindow = std::max<size_t>(*maxWindow, lexer.GetTokenStream().Size());
+            }
+        }
+    } catch (JR::Tokenizer::TokenizerException& e) {
+        rendered.push_back(e.what());
+    }
+    return rendered;
+}
+
+int test_TokenizerStreaming() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::stringstream contents;
+    contents << std::ifstream(directory + "/../samples/full_sample.jr", std::ios::binary).rdbuf();
+    contents << std::ifstream(directory + "/artifacts/lexer_edge_cases.jr", std::ios::binary).rdbuf();
+    std::string sample = contents.str();
+
+    // Tokens that straddle chunks, literals and comments longer than a chunk, and inputs ending mid token
+    std::vector<std::string> inputs = {
+        sample,
+        "let x = 1.5f; /* a block comment " + std::string(300, '*') + " that spans chunks */ y >>= 0x1F\n",
+        "let s = \"" + std::string(500, 's') + "\"\n// a line comment at the end",
+        "a /* unterminated comment falls back to an operator",
+        "let s = \"unterminated string",
+        "x = 'c'; y = '",
+        "truest false1 1.x 1..2 ...",
+        "",
+    };
+
+    std::string filepath = (std::filesystem::temp_directory_path() / "jr_stream_test.jr").string();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        std::ofstream(filepath, std::ios::binary | std::ios::trunc) << inputs[i];
+        std::vector<std::string> expected = renderTokens(filepath, JR::Tokenizer::LexerEngine::DFA, 0);
+        for (size_t chunkSize : { 1, 2, 3, 7, 64, 4096 }) {
+            for (auto engine : { JR::Tokenizer::LexerEngine::DFA, JR::Tokenizer::LexerEngine::REGEX }) {
+                if (engine == JR::Tokenizer::LexerEngine::REGEX && (i == 0 && chunkSize < 64)) {
+                    continue;
+                }
+                if (renderTokens(filepath, engine, chunkSize) != expected) {
+                    LOG_ERROR("Streamed tokens of input " + std::to_string(i) + " with chunks of " + std::to_string(chunkSize) + 
+                        " bytes and engine " + std::to_string(engine) + " differ from a full lex");
+                    return 1;
+                }
+            }
+        }
+    }
+
+    // A long input keeps only a bounded window of bytes and tokens
+    std::string repeated;
+    while (repeated.size() < 2 * 1024 * 1024) {
+        repeated += sample;
+    }
+    std::ofstream(filepath, std::ios::binary | std::ios::trunc) << repeated;
+    size_t maxTokens = 0;
+    if (renderTokens(filepath, JR::Tokenizer::LexerEngine::DFA, 4096, &maxTokens) != renderTokens(filepath, JR::Tokenizer::LexerEngine::DFA, 0)) {
+        LOG_ERROR("Streamed tokens of a long input differ from a full lex");
+        return 1;
+    }
+    if (maxTokens > 4096 + 1) {
+        LOG_ERROR("Streaming kept " + std::to_string(maxTokens) + " tokens");
+        return 1;
+    }
+
+    JR::StreamBuffer stream;
+    stream.Open(filepath, 4096);
+    size_t maxCapacity = 0;
+    while (stream.ReadChunk()) {
+        stream.Release(stream.Begin() + stream.Data().size() - 100);
+        maxCapacity = std::max(maxCapacity, stream.Capacity());
+    }
+    if (stream.Begin() + stream.Data().size() != repeated.size() || maxCapacity > 2 * 4096) {
+        LOG_ERROR("Stream buffer read " + std::to_string(stream.Begin() + stream.Data().size()) + " bytes with a window of up to " + std::to_string(maxCapacity));
+        return 1;
+    }
+
+    // Streamed input is never held in full, so it cannot be edited
+    JR::Tokenizer::Lexer lexer;
+    lexer.InitStream(filepath);
+    try {
+        lexer.Edit(0, 0, " ");
+        LOG_ERROR("Editing streamed input did not throw");
+        return 1;
+    } catch (std::runtime_error&) {}
+
+    std::filesystem::remove(filepath);
+    return 0;
+}
+
+int test_TokenizerNumericLiterals() {
+    // Every engine decodes the value and suffix, hex and binary content is still rewritten in base 10
+    struct Expected {
+        JR::Tokenizer::TokenType::Enum type;
+        std::string content;
+        u64 integer;
+        double real;
+        bool suffixF;
+    };
+    std::string text = "0 42 0x1F 0b101 18446744073709551615 0xFFFFFFFFFFFFFFFF 1.5 2.25f 0.1 123456789.000000001f";
+    std::vector<Expected> expected = {
+        { JR::Tokenizer::TokenType::INTEGER_LITERAL, "0", 0, 0, false },
+        { JR::Tokenizer::TokenType::INTEGER_LITERAL, "42", 42, 0, false },
+        { JR::Tokenizer::TokenType::INTEGER_LITERAL, "31", 31, 0, false },
+        { JR::Tokenizer::TokenType::INTEGER_LITERAL, "5", 5, 0, false },
+        { JR::Tokenizer::TokenType::INTEGER_LITERAL, "18446744073709551615", 18446744073709551615ull, 0, false },
+        { JR::Tokenizer::TokenType::INTEGER_LITERAL, "18446744073709551615", 18446744073709551615ull, 0, false },
+        { JR::Tokenizer::TokenType::FLOAT_LITERAL, "1.5", 0, 1.5, false },
+        { JR::Tokenizer::TokenType::FLOAT_LITERAL, "2.25f", 0, 2.25, true },
+        { JR::Tokenizer::TokenType::FLOAT_LITERAL, "0.1", 0, 0.1, false },
+        { JR::Tokenizer::TokenType::FLOAT_LITERAL, "123456789.000000001f", 0, 123456789.000000001, true },
+    };
+
+    for (auto engine : { JR::Tokenizer::LexerEngine::DFA, JR::Tokenizer::LexerEngine::REGEX }) {
+        JR::Tokenizer::Lexer lexer;
+        lexer.InitBuffer("numbers.jr", text, engine);
+        for (const Expected& literal : expected) {
+            JR::Tokenizer::TokenRef token = lexer.NextToken();
+            if (!token) {
+                LOG_ERROR("Literal " + literal.content + " was not lexed");
+                return 1;
+            }
+            bool suffixF = (token->flags & JR::Tokenizer::TokenFlags::SUFFIX_F) != 0;
+            bool valueMatches = literal.type == JR::Tokenizer::TokenType::INTEGER_LITERAL 
+                ? token->value.integer == literal.integer 
+                : token->value.real == literal.real;
+            if (token->type != literal.type || token.Content() != literal.content || !valueMatches || suffixF != literal.suffixF) {
+                LOG_ERROR("Literal " + literal.content + " was decoded as " + token.ToString());
+                return 1;
+            }
+        }
+    }
+
+    // Values that do not fit are reported at the literal instead of wrapping
+    for (std::string overflow : { std::string("18446744073709551616"), std::string("0x10000000000000000"), "0b" + std::string(65, '1') }) {
+        JR::Tokenizer::Lexer lexer;
+        try {
+            lexer.InitBuffer("numbers.jr", "let x = " + overflow + "\n");
+            while (lexer.NextToken()) {}
+            LOG_ERROR("Out of range literal " + overflow + " was not reported");
+            return 1;
+        } catch (JR::Tokenizer::TokenizerException& e) {
+            if (e.what() != "numbers.jr:1:9: Tokenizer error => Integer literal does not fit in 64 bits") {
+                LOG_ERROR("Unexpected error for " + overflow + ": " + e.what());
+                return 1;
+            }
+        }
+    }
+
+    // Parallel chunks and the driver's module loader stop at the literal too instead of dropping it
+    std::filesystem::path overflowPath = std::filesystem::temp_directory_path() / "justrightc-overflow-test.jr";
+    K::ThreadPool pool(4);
+    int failures = 0;
+    for (std::string overflow : { std::string("99999999999999999999999"), std::string("0x1FFFFFFFFFFFFFFFF"), std::string(400, '9') + ".5" }) {
+        std::string filepath = overflowPath.string();
+        std::ofstream(overflowPath, std::ios::binary) << "fun main() {\n print(" + overflow + ")\n}\n";
+        std::string kind = overflow.back() == '5' ? "Float literal is out of range" : "Integer literal does not fit in 64 bits";
+        std::string expected = filepath + ":2:8: Tokenizer error => " + kind;
+
+        for (size_t chunkSize : { 1, 7, 1024 * 1024 }) {
+            JR::Tokenizer::Lexer lexer;
+            try {
+                lexer.InitParallel(filepath, pool, JR::Tokenizer::LexerEngine::DFA, chunkSize);
+                LOG_ERROR("Parallel lexing dropped the out of range literal " + overflow.substr(0, 32));
+                failures++;
+            } catch (JR::Tokenizer::TokenizerException& e) {
+                if (e.what() != expected) {
+                    LOG_ERROR("Unexpected parallel error: " + e.what());
+                    failures++;
+                }
+            }
+        }
+
+        JR::Modules::ModuleLoader loader(pool, {});
+        JR::Modules::Module& module = loader.Add(filepath);
+        loader.Wait();
+        if (module.errors != std::vector<std::string>{ expected }) {
+            LOG_ERROR("The module loader did not report the out of range literal " + overflow.substr(0, 32));
+            failures++;
+        }
+    }
+    std::filesystem::remove(overflowPath);
+
+    return failures;
+}
+
+// Lexes all of `text` and parses it, the lexer has to outlive the tree
+void parseText(JR::Tokenizer::Lexer& lexer, JR::Parser::Parser& parser, std::string_view text) {
+    lexer.InitBuffer("parser.jr", text);
+    while (lexer.NextToken()) {}
+    parser.Parse("parser.jr", lexer.GetTokenStream());
+}
+
+int test_Parser() {
+    namespace NodeKind = JR::Parser::NodeKind;
+
+    // Every construct of the full sample parses, the top level keeps its items in order
+    {
+        std::string filepath = std::string(XSTR(TESTS_ROOT_DIR)) + "/../samples/full_sample.jr";
+        JR::Tokenizer::Lexer lexer;
+        JR::Parser::Parser parser;
+        try {
+            lexer.Init(filepath);
+            while (lexer.NextToken()) {}
+            parser.Parse(filepath, lexer.GetTokenStream());
+        } catch (JR::Parser::ParserException& e) {
+            LOG_ERROR(e.what());
+            return 1;
+        }
+
+        const JR::Parser::Ast& ast = parser.GetAst();
+        std::vector<u32> kinds;
+        for (u32 item : ast.ChildrenOf(ast.Root())) {
+            kinds.push_back(ast[item].kind);
+        }
+        std::vector<u32> expectedKinds = {
+            NodeKind::USE, NodeKind::USE, NodeKind::USE, NodeKind::USE, NodeKind::USE, 
+            NodeKind::CLASS, NodeKind::CLASS, NodeKind::FUNCTION
+        };
+        if (kinds != expectedKinds || ast.Root() != ast.Size() - 1) {
+            LOG_ERROR("Unexpected top level items in full_sample.jr");
+            return 1;
+        }
+
+        u32 son = ast.Child(ast.Root(), 6);
+        if (ast.Text(son) != "Son" || ast.ToString(ast.Child(son, 1)) != "(TYPE_NAME \"Example\")" || ast.ChildCount(son) != 4) {
+            LOG_ERROR("Unexpected class Son: " + ast.ToString(son));
+            return 1;
+        }
+    }
+
+    // The shape of single items, written as ToString
+    std::vector<std::pair<std::string, std::string>> cases = {
+        { "a = b + c * d", "(BINARY \"=\" (NAME \"a\") (BINARY \"+\" (NAME \"b\") (BINARY \"*\" (NAME \"c\") (NAME \"d\"))))" },
+        { "a - b - c", "(BINARY \"-\" (BINARY \"-\" (NAME \"a\") (NAME \"b\")) (NAME \"c\"))" },
+        { "a = b = 1", "(BINARY \"=\" (NAME \"a\") (BINARY \"=\" (NAME \"b\") (LITERAL \"1\")))" },
+        { "a < b", "(BINARY \"<\" (NAME \"a\") (NAME \"b\"))" },
+        { "(a) - b", "(BINARY \"-\" (NAME \"a\") (NAME \"b\"))" },
+        { "(int)-b", "(CAST \"(\" (TYPE_NAME \"int\") (UNARY \"-\" (NAME \"b\")))" },
+        { "x is list<int>", "(IS \"is\" (NAME \"x\") (TYPE_NAME \"list\" (TYPE_NAME \"int\")))" },
+        { "list<list<int>> xs = list<list<int>>(3)", 
+            "(VARIABLE \"xs\" (TYPE_NAME \"list\" (TYPE_NAME \"list\" (TYPE_NAME \"int\"))) "
+            "(CALL \"(\" (TYPE_NAME \"list\" (TYPE_NAME \"list\" (TYPE_NAME \"int\"))) (ARGUMENTS \"(\" (LITERAL \"3\"))))" },
+        { "f(a) { x -> x }", 
+            "(CALL \"(\" trailing (NAME \"f\") (ARGUMENTS \"(\" (NAME \"a\") "
+            "(CLOSURE \"{\" (PARAMETERS \"{\" (PARAMETER \"x\" _)) (BLOCK \"{\" (NAME \"x\")))))" },
+        { "a[i]++", "(POSTFIX \"++\" (INDEX \"[\" (NAME \"a\") (NAME \"i\")))" },
+        { "if (a) { } else if (b) { } else { }", 
+            "(IF \"if\" (NAME \"a\") (BLOCK \"{\") (IF \"if\" (NAME \"b\") (BLOCK \"{\") (BLOCK \"{\")))" },
+        { "open class A: B { static fun f(a: int*): void { return } }", 
+            "(CLASS \"A\" open _ (TYPE_NAME \"B\") (FUNCTION \"f\" static (PARAMETERS \"(\" "
+            "(PARAMETER \"a\" (POINTER_TYPE \"*\" (TYPE_NAME \"int\")))) (TYPE_NAME \"void\") (BLOCK \"{\" (RETURN \"return\" _))))" },
+        { "f(a,\n  b)", "(CALL \"(\" (NAME \"f\") (ARGUMENTS \"(\" (NAME \"a\") (NAME \"b\")))" },
+    };
+    for (auto& [text, expected] : cases) {
+        JR::Tokenizer::Lexer lexer;
+        JR::Parser::Parser parser;
+        try {
+            parseText(lexer, parser, text);
+        } catch (JR::Parser::ParserException& e) {
+            LOG_ERROR(e.what());
+            return 1;
+        }
+        const JR::Parser::Ast& ast = parser.GetAst();
+        std::string actual = ast.ToString(ast.Child(ast.Root(), 0));
+        if (ast.ChildCount(ast.Root()) != 1 || actual != expected) {
+            LOG_ERROR("Parsed `" + text + "` as " + actual);
+            return 1;
+        }
+    }
+
+    // A line ending inside a comment still ends the statement, an operator at the end of a line does not
+    for (auto& [text, items] : { std::pair<std::string, u32>("f() // call\ng()", 2), std::pair<std::string, u32>("a = b +\n c", 1) }) {
+        JR::Tokenizer::Lexer lexer;
+        JR::Parser::Parser parser;
+        parseText(lexer, parser, text);
+        if (parser.GetAst().ChildCount(parser.GetAst().Root()) != items) {
+            LOG_ERROR("Wrong number of statements in `" + text + "`");
+            return 1;
+        }
+    }
+
+    // Deep nesting below the limit still parses
+    {
+        JR::Tokenizer::Lexer lexer;
+        JR::Parser::Parser parser;
+        parseText(lexer, parser, "let x = " + std::string(500, '(') + "1" + std::string(500, ')'));
+    }
+
+    // Syntax errors are reported at the offending token
+    std::vector<std::pair<std::string, std::string>> errors = {
+        { "fun f( {", "parser.jr:1:8: Parser error => Expected a parameter name, found `{`" },
+        { "let x = (1 + 2", "parser.jr:1:15: Parser error => Expected `)`, found the end of the file" },
+        { "a b c", "parser.jr:1:3: Parser error => Expected a new line or `;` after the statement, found `b`" },
+        // Nesting is limited instead of overflowing the stack, the function body is the first level
+        { "fun f() { let x = " + std::string(30000, '(') + "1" + std::string(30000, ')') + " }", "parser.jr:1:1018: Parser error => Expression nested too deeply" },
+        { "fun f() {" + std::string(30000, '!') + "1 }", "parser.jr:1:1009: Parser error => Expression nested too deeply" },
+    };
+    for (auto& [text, expected] : errors) {
+        JR::Tokenizer::Lexer lexer;
+        JR::Parser::Parser parser;
+        try {
+            parseText(lexer, parser, text);
+            LOG_ERROR("`" + text + "` parsed without an error");
+            return 1;
+        } catch (JR::Parser::ParserException& e) {
+            if (e.what() != expected) {
+                LOG_ERROR("Unexpected error for `" + text + "`: " + e.what());
+                return 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+int test_ParserParallel() {
+    std::string directory = XSTR(TESTS_ROOT_DIR);
+    std::stringstream contents;
+    contents << std::ifstream(directory + "/../samples/full_sample.jr", std::ios::binary).rdbuf();
+    std::string sample = contents.str();
+
+    // Items split by a line comment have no NEWLINE token between them and stay in one group
+    std::string text;
+    for (int i = 0; i < 20; i++) {
+        text += sample + "\nfun f" + std::to_string(i) + "(): int { return " + std::to_string(i) + " } // no NEWLINE token\n";
+    }
+
+    JR::Tokenizer::Lexer lexer;
+    lexer.InitBuffer("parallel.jr", text);
+    while (lexer.NextToken()) {}
+    const JR::Tokenizer::TokenStream& tokens = lexer.GetTokenStream();
+
+    K::ThreadPool pool(4);
+    JR::Parser::Parser sequential;
+    sequential.Parse("parallel.jr", tokens);
+    for (size_t chunkTokens : { size_t(1), size_t(64), size_t(1000), JR::Parser::Parser::c_DefaultChunkTokens }) {
+        JR::Parser::Parser parallel;
+        parallel.ParseParallel("parallel.jr", tokens, pool, chunkTokens);
+
+        // Node for node the same tree, so every later stage sees the same indices
+        const JR::Parser::Ast& expected = sequential.GetAst();
+        const JR::Parser::Ast& actual = parallel.GetAst();
+        bool same = expected.Size() == actual.Size() && expected.Root() == actual.Root();
+        for (u32 i = 0; same && i < expected.Size(); i++) {
+            same = std::memcmp(&expected[i], &actual[i], sizeof(JR::Parser::Node)) == 0;
+        }
+        if (!same) {
+            LOG_ERROR("Parallel parse with " + std::to_string(chunkTokens) + " tokens per group differs from the sequential parse");
+            return 1;
+        }
+    }
+
+    // A syntax error is the one the sequential parse reports, even where it cuts an item short
+    for (std::string broken : { text + "fun g() {\n", text + "let x = 1 +\nfun g() {}\n", "fun a() {}\n" + text + "fun g() { ) }\n" + text }) {
+        JR::Tokenizer::Lexer brokenLexer;
+        brokenLexer.InitBuffer("parallel.jr", broken);
+        while (brokenLexer.NextToken()) {}
+
+        std::string expected, actual;
+        try {
+            JR::Parser::Parser parser;
+            parser.Parse("parallel.jr", brokenLexer.GetTokenStream());
+        } catch (JR::Parser::ParserException& e) {
+            expected = e.what();
+        }
+        try {
+            JR::Parser::Parser parser;
+            parser.ParseParallel("parallel.jr", brokenLexer.GetTokenStream(), pool, 64);
+        } catch (JR::Parser::ParserException& e) {
+            actual = e.what();
+        }
+        if (expected.empty() || actual != expected) {
+            LOG_ERROR("Parallel parse reported `" + actual + "` instead of `" + expected + "`");
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int test_Scanners() {
+    // Runs of every class at every offset and length, so both the vector loops and the scalar tails are hit
+    const char alphabet[] = " \t\r\f\v\n\n_azAZ09*/*/@`[{\x80\xff";
+    std::mt19937 random(99);
+    std::string buffer;
+    for (size_t i = 0; i < 4096; i++) {
+        buffer += alphabet[random() % (sizeof(alphabet) - 1)];
+        if (random() % 8 == 0) {
+            buffer += std::string(random() % 80, " _a\n*"[random() % 5]);
+        }
+    }
+
+    K::Scan::Level::Enum previousLevel = K::Scan::GetLevel();
+    std::vector<size_t> expected;
+    K::Scan::SetLevel(K::Scan::Level::SCALAR);
+    for (size_t start = 0; start < 512; start++) {
+        const char* s = buffer.data() + start;
+        size_t size = buffer.size() - start * 7;
+        expected.insert(expected.end(), {
+            K::Scan::SkipBlanks(s, size), K::Scan::SkipIdentChars(s, size), K::Scan::FindLineEnd(s, size),
+            K::Scan::FindBlockCommentEnd(s, size), K::Scan::CountNewlines(s, size)
+        });
+        std::vector<u32> newlines(K::Scan::CountNewlines(s, size));
+        newlines.resize(K::Scan::FindNewlines(s, size, newlines.data()));
+        expected.insert(expected.end(), newlines.begin(), newlines.end());
+    }
+    std::vector<std::string> expectedTokens = renderTokens(std::string(XSTR(TESTS_ROOT_DIR)) + "/../samples/full_sample.jr", nullptr, 0);
+
+    int result = 0;
+    for (K::Scan::Level::Enum level : K::Scan::Level::Values) {
+        if (!K::Scan::SetLevel(level)) {
+            continue;
+        }
+
+        std::vector<size_t> actual;
+        for (size_t start = 0; start < 512; start++) {
+            const char* s = buffer.data() + start;
+            size_t size = buffer.size() - start * 7;
+            actual.insert(actual.end(), {
+                K::Scan::SkipBlanks(s, size), K::Scan::SkipIdentChars(s, size), K::Scan::FindLineEnd(s, size),
+                K::Scan::FindBlockCommentEnd(s, size), K::Scan::CountNewlines(s, size)
+            });
+            std::vector<u32> newlines(K::Scan::CountNewlines(s, size));
+            newlines.resize(K::Scan::FindNewlines(s, size, newlines.data()));
+            actual.insert(actual.end(), newlines.begin(), newlines.end());
+        }
+        if (actual != expected) {
+            LOG_ERROR("Scanners disagree with the scalar scanners at level " + K::Scan::Level::Strings[level - 1]);
+            result = 1;
+        }
+        if (renderTokens(std::string(XSTR(TESTS_ROOT_DIR)) + "/../samples/full_sample.jr", nullptr, 0) != expectedTokens) {
+            LOG_ERROR("Tokens differ from the scalar scanners at level " + K::Scan::Level::Strings[level - 1]);
+            result = 1;
+        }
+    }
+
+    K::Scan::SetLevel(previousLevel);
+    return result;
+}
+
+int test_ModuleLoader() {
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "justrightc-module-test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "lib");
+    std::filesystem::create_directories(root / "cyc");
+    auto write = [&root](const char* name, const char* text) {
+        std::ofstream(root / name, std::ios::binary) << text;
+    };
+    write("main.jr", "use lib.a\nuse lib.b as B\nfun main() {\n    return 0\n}\n");
+    write("lib/a.jr", "use lib.c\nfun a() {}\n");
+    write("lib/b.jr", "use lib.c exposing { c }\nuse lib.a\nfun b() {}\n");
+    write("lib/c.jr", "fun c() {}\n");
+    write("cyc/y.jr", "use cyc.z\n");
+    write("cyc/z.jr", "use lib.c\nuse cyc.y\n");
+    write("cycle.jr", "use cyc.y\n");
+    write("missing.jr", "use lib.c\nuse lib.nothing\n");
+
+    auto namesOf = [](const std::vector<JR::Modules::Module*>& modules) {
+        std::string names;
+        for (JR::Modules::Module* module : modules) {
+            names += (names.empty() ? "" : " ") + module->name;
+        }
+        return names;
+    };
+
+    K::ThreadPool pool(4);
+    {
+        // Modules imported from several files are loaded once, and listed in depth first import order
+        JR::Modules::ModuleLoader loader(pool, { root.string() });
+        std::string input = (root / "main.jr").string();
+        loader.Add(input);
+        loader.Add(input);
+        loader.Wait();
+        std::string expected = input + " lib.a lib.c lib.b";
+        if (namesOf(loader.GetModules()) != expected || loader.GetInputs().size() != 1) {
+            LOG_ERROR("Expected the modules `" + expected + "`, found `" + namesOf(loader.GetModules()) + "`");
+            return 1;
+        }
+        for (JR::Modules::Module* module : loader.GetModules()) {
+            if (!module->errors.empty() || module->parser.GetAst().Empty()) {
+                LOG_ERROR("Module " + module->name + " did not load");
+                return 1;
+            }
+        }
+        JR::Modules::Module* b = loader.GetModules()[3];
+        if (b->imports.size() != 2 || b->imports[0].module != loader.GetModules()[2] || b->imports[1].module != loader.GetModules()[1]) {
+            LOG_ERROR("The imports of lib.b are not lib.c and lib.a");
+            return 1;
+        }
+        if (loader.Resolve("lib.c") != (root / "lib" / "c.jr").string() || !loader.Resolve("lib").empty()) {
+            LOG_ERROR("Module paths resolved to the wrong files");
+            return 1;
+        }
+    }
+
+    {
+        // The import closing a cycle is reported, the modules around it still load
+        JR::Modules::ModuleLoader loader(pool, { (root / "nowhere").string(), root.string() });
+        loader.Add((root / "cycle.jr").string());
+        loader.Wait();
+        std::vector<std::string> errors;
+        for (JR::Modules::Module* module : loader.GetModules()) {
+            errors.insert(errors.end(), module->errors.begin(), module->errors.end());
+        }
+        std::string expected = (root / "cyc" / "z.jr").string() + ":2:5: Module error => Import cycle: cyc.y -> cyc.z -> cyc.y";
+        if (errors.size() != 1 || errors[0] != expected || loader.GetModules().size() != 4) {
+            LOG_ERROR("Expected the cycle error `" + expected + "`, found " + std::to_string(errors.size()) + " error(s)");
+            return 1;
+        }
+    }
+
+    {
+        JR::Modules::ModuleLoader loader(pool, { root.string() });
+        std::string input = (root / "missing.jr").string();
+        JR::Modules::Module& module = loader.Add(input);
+        loader.Wait();
+        std::string expected = input + ":2:5: Module error => Module `lib.nothing` not found in the module path";
+        if (module.errors.size() != 1 || module.errors[0] != expected || module.imports.size() != 1) {
+            LOG_ERROR("Expected the error `" + expected + "`");
+            return 1;
+        }
+    }
+
+    {
+        // Without search roots only the inputs are loaded
+        JR::Modules::ModuleLoader loader(pool, {});
+        loader.Add((root / "missing.jr").string());
+        loader.Wait();
+        if (loader.GetModules().size() != 1 || !loader.GetModules()[0]->errors.empty()) {
+            LOG_ERROR("Imports were followed without a module path");
+            return 1;
+        }
+    }
+
+    std::vector<std::string> roots = JR::Modules::ModuleLoader::SplitSearchPath("a::b/c:");
+    if (roots != std::vector<std::string>{ "a", "b/c" }) {
+        LOG_ERROR("Search paths were split incorrectly");
+        return 1;
+    }
+
+    std::filesystem::remove_all(root);
+    return 0;
+}
+
+int test_Daemon() {
+#ifdef __linux__
+    std::filesystem::path root = std::filesystem::temp_directory_path() / "justrightc-daemon-test";
+    std::filesystem::remove_all(root);
+    std::filesystem::create_directories(root / "lib");
+    std::ofstream(root / "main.jr") << "use lib.b\nfun main() {}\n";
+    std::ofstream(root / "lib" / "b.jr") << "fun b() {}\n";
+    std::string socketPath = (root / "daemon.sock").string();
+
+    // Each request reports how its modules were loaded through the exit code and these
+    std::vector<std::string> arguments;
+    std::string directory;
+    u32 bGeneration = 0;
+    std::string bTree;
+    std::string editWhileLoading = "fun b(y: int) {}\n";
+    JR::Daemon::Server server(socketPath, 2);
+    std::thread serving([&]() {
+        server.Serve([&](int argc, char* argv[], JR::Daemon::Server& server) {
+            arguments.assign(argv, argv + argc);
+            directory = std::filesystem::current_path().string();
+            JR::Modules::ModuleLoader& loader = server.GetLoader({ "." }, JR::Tokenizer::LexerEngine::DFA, nullptr);
+            loader.Add(argv[1]);
+            loader.Wait();
+            JR::Modules::Module* b = loader.GetModules().back();
+            bGeneration = b->resolvedIn;
+            bTree = b->parser.GetAst().ToString(b->parser.GetAst().Root());
+            if (!editWhileLoading.empty()) {
+                // An edit landing after the file was read, but before the request is over
+                std::ofstream(root / "lib" / "b.jr") << editWhileLoading;
+                editWhileLoading.clear();
+            }
+            return static_cast<int>(40 + loader.GetModules().size());
+        });
+    });
+
+    std::filesystem::path previousDirectory = std::filesystem::current_path();
+    std::filesystem::current_path(root);
+    auto request = [&socketPath]() {
+        // The server may still be starting
+        for (int attempt = 0; ; attempt++) {
+            try {
+                return JR::Daemon::Forward(socketPath, { "justrightc", "main.jr" });
+            } catch (std::runtime_error& e) {
+                if (attempt == 200) {
+                    LOG_ERROR(e.what());
+                    return -1;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        }
+    };
+
+    int failures = 0;
+    int code = request();
+    if (code != 42 || arguments != std::vector<std::string>{ "justrightc", "main.jr" } || directory != std::filesystem::current_path().string()) {
+        LOG_ERROR("The first request did not run with its arguments and directory, exit code " + std::to_string(code));
+        failures++;
+    }
+
+    // The first request edited b.jr after reading it, the file was watched before it was read so it loads again
+    code = request();
+    if (code != 42 || bTree.find("PARAMETER \"y\"") == std::string::npos) {
+        LOG_ERROR("A module edited while the first request loaded it was reused, its tree is " + bTree);
+        failures++;
+    }
+    u32 loadedIn = bGeneration;
+
+    // Unchanged modules are reused, a changed one is loaded again
+    code = request();
+    if (code != 42 || bGeneration != loadedIn) {
+        LOG_ERROR("An unchanged module was loaded again");
+        failures++;
+    }
+    std::ofstream(root / "lib" / "b.jr") << "fun b(x: int) {}\n";
+    code = request();
+    if (code != 42 || bGeneration == loadedIn || bTree.find("PARAMETER \"x\"") == std::string::npos) {
+        LOG_ERROR("A changed module was not loaded again, its tree is " + bTree);
+        failures++;
+    }
+
+    std::filesystem::current_path(previousDirectory);
+    server.Stop();
+    serving.join();
+    if (std::filesystem::exists(socketPath)) {
+        LOG_ERROR("The daemon socket was left behind");
+        failures++;
+    }
+    std::filesystem::remove_all(root);
+    return failures;
+#else
+    return 0;
+#endif
+}
+
 int main() {
     std::vector<std::string> failedTests = {};
 
@@ -160,6 +1772,221 @@ int main() {
         failedTests.push_back("Tokenizer Identifiers");
     }
     LOG_INFO("Test Passed: TokenizerIdentifiers");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Engines Agree test...");
+    LOG_INFO("------------------------------");
+    for (std::string corpus : {
+        "artifacts/operators.jr", "artifacts/types.jr", "artifacts/keywords.jr", "artifacts/identifiers.jr",
+        "artifacts/lexer_edge_cases.jr", "../samples/full_sample.jr"
+    }) {
+        if(test_TokenizerEnginesAgree(corpus)) {
+            LOG_ERROR("Test Failed: TokenizerEnginesAgree " + corpus);
+            failedTests.push_back("Tokenizer Engines Agree " + corpus);
+        }
+    }
+    LOG_INFO("Test Passed: TokenizerEnginesAgree");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Words test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerWords()) {
+        LOG_ERROR("Test Failed: TokenizerWords");
+        failedTests.push_back("Tokenizer Words");
+    }
+    LOG_INFO("Test Passed: TokenizerWords");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Source Buffer test...");
+    LOG_INFO("------------------------------");
+    if(test_SourceBuffer()) {
+        LOG_ERROR("Test Failed: SourceBuffer");
+        failedTests.push_back("Source Buffer");
+    }
+    LOG_INFO("Test Passed: SourceBuffer");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Parallel Lexers test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerParallelLexers()) {
+        LOG_ERROR("Test Failed: TokenizerParallelLexers");
+        failedTests.push_back("Tokenizer Parallel Lexers");
+    }
+    LOG_INFO("Test Passed: TokenizerParallelLexers");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Thread Pool test...");
+    LOG_INFO("------------------------------");
+    if(test_ThreadPool()) {
+        LOG_ERROR("Test Failed: ThreadPool");
+        failedTests.push_back("Thread Pool");
+    }
+    LOG_INFO("Test Passed: ThreadPool");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Parallel Chunks test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerParallelChunks()) {
+        LOG_ERROR("Test Failed: TokenizerParallelChunks");
+        failedTests.push_back("Tokenizer Parallel Chunks");
+    }
+    LOG_INFO("Test Passed: TokenizerParallelChunks");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Trivia test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerTrivia()) {
+        LOG_ERROR("Test Failed: TokenizerTrivia");
+        failedTests.push_back("Tokenizer Trivia");
+    }
+    LOG_INFO("Test Passed: TokenizerTrivia");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Interner test...");
+    LOG_INFO("------------------------------");
+    if(test_Interner()) {
+        LOG_ERROR("Test Failed: Interner");
+        failedTests.push_back("Interner");
+    }
+    LOG_INFO("Test Passed: Interner");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Incremental test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerIncremental()) {
+        LOG_ERROR("Test Failed: TokenizerIncremental");
+        failedTests.push_back("Tokenizer Incremental");
+    }
+    LOG_INFO("Test Passed: TokenizerIncremental");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Token Cache test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenCache()) {
+        LOG_ERROR("Test Failed: TokenCache");
+        failedTests.push_back("Token Cache");
+    }
+    LOG_INFO("Test Passed: TokenCache");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Token Dump test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenDump()) {
+        LOG_ERROR("Test Failed: TokenDump");
+        failedTests.push_back("Token Dump");
+    }
+    LOG_INFO("Test Passed: TokenDump");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Writer test...");
+    LOG_INFO("------------------------------");
+    if(test_Writer()) {
+        LOG_ERROR("Test Failed: Writer");
+        failedTests.push_back("Writer");
+    }
+    LOG_INFO("Test Passed: Writer");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Log test...");
+    LOG_INFO("------------------------------");
+    if(test_Log()) {
+        LOG_ERROR("Test Failed: Log");
+        failedTests.push_back("Log");
+    }
+    LOG_INFO("Test Passed: Log");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Streaming test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerStreaming()) {
+        LOG_ERROR("Test Failed: TokenizerStreaming");
+        failedTests.push_back("TokenizerStreaming");
+    }
+    LOG_INFO("Test Passed: TokenizerStreaming");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Tokenizer Numeric Literals test...");
+    LOG_INFO("------------------------------");
+    if(test_TokenizerNumericLiterals()) {
+        LOG_ERROR("Test Failed: TokenizerNumericLiterals");
+        failedTests.push_back("TokenizerNumericLiterals");
+    }
+    LOG_INFO("Test Passed: TokenizerNumericLiterals");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Line Index test...");
+    LOG_INFO("------------------------------");
+    if(test_LineIndex()) {
+        LOG_ERROR("Test Failed: LineIndex");
+        failedTests.push_back("LineIndex");
+    }
+    LOG_INFO("Test Passed: LineIndex");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Parser test...");
+    LOG_INFO("------------------------------");
+    if(test_Parser()) {
+        LOG_ERROR("Test Failed: Parser");
+        failedTests.push_back("Parser");
+    }
+    LOG_INFO("Test Passed: Parser");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Parser Parallel test...");
+    LOG_INFO("------------------------------");
+    if(test_ParserParallel()) {
+        LOG_ERROR("Test Failed: ParserParallel");
+        failedTests.push_back("ParserParallel");
+    }
+    LOG_INFO("Test Passed: ParserParallel");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Module Loader test...");
+    LOG_INFO("------------------------------");
+    if(test_ModuleLoader()) {
+        LOG_ERROR("Test Failed: ModuleLoader");
+        failedTests.push_back("ModuleLoader");
+    }
+    LOG_INFO("Test Passed: ModuleLoader");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Daemon test...");
+    LOG_INFO("------------------------------");
+    if(test_Daemon()) {
+        LOG_ERROR("Test Failed: Daemon");
+        failedTests.push_back("Daemon");
+    }
+    LOG_INFO("Test Passed: Daemon");
+    LOG_INFO("");
+
+    LOG_INFO("------------------------------");
+    LOG_INFO("Running Scanners test...");
+    LOG_INFO("------------------------------");
+    if(test_Scanners()) {
+        LOG_ERROR("Test Failed: Scanners");
+        failedTests.push_back("Scanners");
+    }
+    LOG_INFO("Test Passed: Scanners");
 
     for (auto &test : failedTests) {
         LOG_ERROR("Failed test: " + test);